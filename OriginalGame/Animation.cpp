@@ -0,0 +1,196 @@
+#include "Animation.hpp"
+#include "Model.hpp"
+#include <algorithm>
+#include <cmath>
+
+/*
+*	Returns the index of the last key at or before time, keys are sorted by time.
+*	
+*/
+template <typename Key>
+static unsigned int findKey(const std::vector<Key> &keys, float time) {
+	unsigned int first = 0, last = static_cast<unsigned int>(keys.size()) - 1;
+	while (first + 1 < last) {
+		unsigned int middle = (first + last) / 2;
+		if (keys[middle].time <= time) {
+			first = middle;
+		}
+		else {
+			last = middle;
+		}
+	}
+	return keys[last].time <= time ? last : first;
+}
+
+/*
+*	Interpolation factor of time between two keys.
+*	
+*/
+static float keyFactor(float from, float to, float time) {
+	return to > from ? glm::clamp((time - from) / (to - from), 0.0f, 1.0f) : 0.0f;
+}
+
+/*
+*	Constructor, plays the first clip.
+*	
+*/
+Animator::Animator() 
+	: clip(0), previousClip(0), time(0.0f), previousTime(0.0f), fadeElapsed(0.0f), fadeDuration(0.0f), speed(1.0f) {
+
+}
+
+/*
+*	Switches to another clip, blending out of the current one over fadeDuration seconds.
+*	
+*/
+void Animator::play(unsigned int clip, float fadeDuration) {
+	if (clip == this->clip) {
+		return;
+	}
+	previousClip = this->clip;
+	previousTime = time;
+	this->clip = clip;
+	time = 0.0f;
+	fadeElapsed = 0.0f;
+	this->fadeDuration = fadeDuration;
+}
+
+/*
+*	Sets the playback rate, 1 is the clip's own speed.
+*	
+*/
+void Animator::setSpeed(float speed) {
+	this->speed = speed;
+}
+
+/*
+*	Returns the clip currently playing.
+*	
+*/
+unsigned int Animator::getClip() const {
+	return clip;
+}
+
+/*
+*	Advances playback of the current and the fading clip.
+*	
+*/
+void Animator::update(const Model &model, float deltaTime) {
+	const std::vector<AnimationClip> &clips = model.animations;
+	if (clip < clips.size()) {
+		time = advance(time, deltaTime * speed, clips[clip].duration);
+	}
+	if (fadeElapsed < fadeDuration) {
+		if (previousClip < clips.size()) {
+			previousTime = advance(previousTime, deltaTime * speed, clips[previousClip].duration);
+		}
+		fadeElapsed += deltaTime;
+	}
+}
+
+/*
+*	Samples the clips into node transforms and writes one skinning matrix per bone of the model 
+*	into palette. Nodes without keyframes keep their bind transform.
+*/
+void Animator::evaluate(const Model &model, glm::mat4 *palette) const {
+	static thread_local std::vector<glm::mat4> world;
+	const std::vector<SceneNode> &nodes = model.hierarchy.nodes;
+	const std::vector<AnimationClip> &clips = model.animations;
+	const AnimationClip *current = clip < clips.size() ? &clips[clip] : nullptr;
+	const AnimationClip *previous = fadeElapsed < fadeDuration && previousClip < clips.size() ? &clips[previousClip] : nullptr;
+	float weight = previous != nullptr ? fadeElapsed / fadeDuration : 1.0f;
+	world.resize(nodes.size());
+	for (unsigned int i = 0; i < nodes.size(); i++) {
+		int channel = current != nullptr ? current->nodeChannels[i] : -1;
+		int previousChannel = previous != nullptr ? previous->nodeChannels[i] : -1;
+		glm::mat4 local = nodes[i].local;
+		if (channel >= 0 || previousChannel >= 0) {
+			NodePose pose = channel >= 0 ? sample(current->channels[channel], time, local) : decompose(local);
+			if (previous != nullptr) {
+				NodePose from = previousChannel >= 0 ? sample(previous->channels[previousChannel], previousTime, local) : decompose(local);
+				pose.translation = glm::mix(from.translation, pose.translation, weight);
+				pose.rotation = glm::slerp(from.rotation, pose.rotation, weight);
+				pose.scale = glm::mix(from.scale, pose.scale, weight);
+			}
+			local = compose(pose);
+		}
+		world[i] = nodes[i].parent >= 0 ? world[nodes[i].parent] * local : local;
+	}
+	for (unsigned int i = 0; i < model.bones.size(); i++) {
+		const Bone &bone = model.bones[i];
+		palette[i] = bone.node >= 0 ? world[bone.node] * bone.offset : bone.offset;
+	}
+}
+
+/*
+*	Advances a looping playback time.
+*	
+*/
+float Animator::advance(float time, float deltaTime, float duration) {
+	if (duration <= 0.0f) {
+		return 0.0f;
+	}
+	time = std::fmod(time + deltaTime, duration);
+	return time < 0.0f ? time + duration : time;
+}
+
+/*
+*	Interpolates a channel's keys at time. Components without keys come from the bind transform.
+*	
+*/
+NodePose Animator::sample(const AnimationChannel &channel, float time, const glm::mat4 &bind) {
+	NodePose pose;
+	if (channel.positions.empty() || channel.rotations.empty() || channel.scales.empty()) {
+		pose = decompose(bind);
+	}
+	if (!channel.positions.empty()) {
+		unsigned int k = findKey(channel.positions, time);
+		unsigned int next = std::min(k + 1, static_cast<unsigned int>(channel.positions.size()) - 1);
+		float t = keyFactor(channel.positions[k].time, channel.positions[next].time, time);
+		pose.translation = glm::mix(channel.positions[k].value, channel.positions[next].value, t);
+	}
+	if (!channel.rotations.empty()) {
+		unsigned int k = findKey(channel.rotations, time);
+		unsigned int next = std::min(k + 1, static_cast<unsigned int>(channel.rotations.size()) - 1);
+		float t = keyFactor(channel.rotations[k].time, channel.rotations[next].time, time);
+		pose.rotation = glm::normalize(glm::slerp(channel.rotations[k].value, channel.rotations[next].value, t));
+	}
+	if (!channel.scales.empty()) {
+		unsigned int k = findKey(channel.scales, time);
+		unsigned int next = std::min(k + 1, static_cast<unsigned int>(channel.scales.size()) - 1);
+		float t = keyFactor(channel.scales[k].time, channel.scales[next].time, time);
+		pose.scale = glm::mix(channel.scales[k].value, channel.scales[next].value, t);
+	}
+	return pose;
+}
+
+/*
+*	Splits an affine transform without shear into translation, rotation and scale.
+*	
+*/
+NodePose Animator::decompose(const glm::mat4 &matrix) {
+	NodePose pose;
+	pose.translation = glm::vec3(matrix[3]);
+	pose.scale = glm::vec3(glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2])));
+	glm::mat3 rotation(matrix);
+	for (int i = 0; i < 3; i++) {
+		if (pose.scale[i] > 0.0f) {
+			rotation[i] /= pose.scale[i];
+		}
+	}
+	pose.rotation = glm::quat_cast(rotation);
+	return pose;
+}
+
+/*
+*	Builds the matrix translation * rotation * scale.
+*	
+*/
+glm::mat4 Animator::compose(const NodePose &pose) {
+	glm::mat4 matrix = glm::mat4_cast(pose.rotation);
+	matrix[0] *= pose.scale.x;
+	matrix[1] *= pose.scale.y;
+	matrix[2] *= pose.scale.z;
+	matrix[3] = glm::vec4(pose.translation, 1.0f);
+	return matrix;
+}
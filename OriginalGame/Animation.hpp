@@ -0,0 +1,90 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <string>
+#include <vector>
+
+class Model;
+
+static const unsigned int MAX_BONES = 256;	// bone indices are stored in a byte per influence
+
+/*
+*	A bone of a skinned model. offset takes mesh space vertices into the bone's space in the bind pose, 
+*	the bone's node then places them in model space.
+*/
+struct Bone {
+	std::string name;
+	int node;
+	glm::mat4 offset;
+};
+
+struct VectorKey {
+	float time;
+	glm::vec3 value;
+};
+
+struct RotationKey {
+	float time;
+	glm::quat value;
+};
+
+/*
+*	Keyframes of one node of an animation clip, times in seconds.
+*	
+*/
+struct AnimationChannel {
+	std::vector<VectorKey> positions;
+	std::vector<RotationKey> rotations;
+	std::vector<VectorKey> scales;
+};
+
+/*
+*	An imported animation. nodeChannels maps every node of the model's hierarchy to its channel, 
+*	-1 for nodes the clip doesn't move, so sampling needs no name lookups.
+*/
+struct AnimationClip {
+	std::string name;
+	float duration;
+	std::vector<AnimationChannel> channels;
+	std::vector<int> nodeChannels;
+};
+
+/*
+*	Local transform of a node split into translation, rotation and scale, so poses can be blended.
+*	
+*/
+struct NodePose {
+	glm::vec3 translation;
+	glm::quat rotation;
+	glm::vec3 scale;
+};
+
+/*
+*	Playback state of one animated model instance. Clips loop, switching clips cross-fades from the 
+*	previous one. Instances only read the shared model, so many of them can be updated and evaluated 
+*	in parallel.
+*/
+class Animator
+{
+public:
+	Animator();
+	void play(unsigned int clip, float fadeDuration = 0.2f);
+	void setSpeed(float speed);
+	unsigned int getClip(void) const;
+	void update(const Model &model, float deltaTime);
+	void evaluate(const Model &model, glm::mat4 *palette) const;
+private:
+	unsigned int clip;
+	unsigned int previousClip;
+	float time;
+	float previousTime;
+	float fadeElapsed;
+	float fadeDuration;
+	float speed;
+	static float advance(float time, float deltaTime, float duration);
+	static NodePose sample(const AnimationChannel &channel, float time, const glm::mat4 &bind);
+	static NodePose decompose(const glm::mat4 &matrix);
+	static glm::mat4 compose(const NodePose &pose);
+};
+
@@ -0,0 +1,328 @@
+#include "Ballistics.hpp"
+#include "JobSystem.hpp"
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+
+const float Ballistics::TICK				= 1.0f / 120.0f;
+static const unsigned int CHUNK_SIZE		= 256;		// projectiles per job, a multiple of four
+static const float GRAVITY					= -9.81f;
+
+/*
+*	Constructor, drag is the quadratic drag coefficient per meter, projectiles that hit nothing 
+*	within lifetime seconds disappear.
+*/
+Ballistics::Ballistics(float radius, float drag, float lifetime) 
+	: radius(radius), drag(drag), lifetime(lifetime), ground(-1e30f), targets(nullptr), targetShape(nullptr), shapeRadius(radius), 
+	count(0), hits(0) {
+	x.resize(MAX_PROJECTILES);
+	y.resize(MAX_PROJECTILES);
+	z.resize(MAX_PROJECTILES);
+	previousX.resize(MAX_PROJECTILES);
+	previousY.resize(MAX_PROJECTILES);
+	previousZ.resize(MAX_PROJECTILES);
+	velocityX.resize(MAX_PROJECTILES);
+	velocityY.resize(MAX_PROJECTILES);
+	velocityZ.resize(MAX_PROJECTILES);
+	age.resize(MAX_PROJECTILES);
+	state.resize(MAX_PROJECTILES);
+	impacts.resize(MAX_PROJECTILES);
+	frameImpacts.reserve(MAX_PROJECTILES);
+}
+
+/*
+*	Sets the height of the ground plane.
+*	
+*/
+void Ballistics::setGround(float height) {
+	ground = height;
+}
+
+/*
+*	Adds a static box collider, the transform places the cube from -1 to 1 (the one renderCube draws) 
+*	and has to scale it uniformly.
+*/
+void Ballistics::addBox(const glm::mat4 &transform) {
+	Box box;
+	box.transform = transform;
+	box.toLocal = glm::inverse(transform);
+	box.extent = 1.0f + radius / glm::length(glm::vec3(transform[0]));
+	boxes.push_back(box);
+}
+
+/*
+*	Makes targets hit by their triangles instead of their spheres. toCenter places the shape 
+*	relative to the center of a target's sphere in the index and has to scale it uniformly.
+*/
+void Ballistics::setTargetShape(const TriangleBVH *shape, const glm::mat4 &toCenter) {
+	targetShape = shape;
+	shapeToCenter = toCenter;
+	centerToShape = glm::inverse(toCenter);
+	shapeRadius = radius / glm::length(glm::vec3(toCenter[0]));
+}
+
+/*
+*	Launches a projectile, returns false if the pool is full.
+*	
+*/
+bool Ballistics::fire(const glm::vec3 &origin, const glm::vec3 &velocity) {
+	if (count == MAX_PROJECTILES) {
+		return false;
+	}
+	x[count] = previousX[count] = origin.x;
+	y[count] = previousY[count] = origin.y;
+	z[count] = previousZ[count] = origin.z;
+	velocityX[count] = velocity.x;
+	velocityY[count] = velocity.y;
+	velocityZ[count] = velocity.z;
+	age[count] = 0.0f;
+	state[count] = PROJECTILE_FLYING;
+	count++;
+	return true;
+}
+
+/*
+*	Drops the impacts of the previous frame's ticks.
+*	
+*/
+void Ballistics::beginFrame() {
+	frameImpacts.clear();
+}
+
+/*
+*	Runs one tick against the targets as of their index's last commit, which has to hold their 
+*	positions at this tick, then removes the projectiles that hit something or expired and collects
+*	their impacts.
+*/
+void Ballistics::stepTick(const SpatialGrid &targets) {
+	if (count == 0) {
+		return;
+	}
+	this->targets = &targets;
+
+	unsigned int chunks = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	JobSystem::parallelFor(chunks, 1, [this](unsigned int chunk) {
+		unsigned int begin = chunk * CHUNK_SIZE;
+		unsigned int end = begin + CHUNK_SIZE < count ? begin + CHUNK_SIZE : count;
+		step(begin, end);
+	});
+
+	for (unsigned int i = 0; i < count; ) {
+		if (state[i] == PROJECTILE_FLYING) {
+			i++;
+			continue;
+		}
+		if (state[i] == PROJECTILE_IMPACT) {
+			frameImpacts.push_back(impacts[i]);
+			if (impacts[i].target >= 0) {
+				hits++;
+			}
+		}
+		remove(i);
+	}
+}
+
+/*
+*	Returns the number of projectiles in flight.
+*	
+*/
+unsigned int Ballistics::getCount() const {
+	return count;
+}
+
+/*
+*	Returns the number of impacts of the ticks since beginFrame().
+*	
+*/
+unsigned int Ballistics::getImpactCount() const {
+	return static_cast<unsigned int>(frameImpacts.size());
+}
+
+/*
+*	Returns an impact of the ticks since beginFrame().
+*	
+*/
+const Impact &Ballistics::getImpact(unsigned int i) const {
+	return frameImpacts[i];
+}
+
+/*
+*	Returns the number of projectiles that hit a target so far.
+*	
+*/
+unsigned int Ballistics::getHits() const {
+	return hits;
+}
+
+/*
+*	Runs a tick for projectiles [begin, end), projectiles that stop stay in place until stepTick()
+*	removes them.
+*/
+void Ballistics::step(unsigned int begin, unsigned int end) {
+	integrate(begin, end);
+	for (unsigned int i = begin; i < end; i++) {
+		if (state[i] == PROJECTILE_FLYING) {
+			collide(i);
+		}
+	}
+}
+
+/*
+*	Semi-implicit Euler tick of four projectiles at once: v += (g - drag * |v| * v) * dt, p += v * dt.
+*	Stopped projectiles are integrated as well but keep their old position.
+*/
+void Ballistics::integrate(unsigned int begin, unsigned int end) {
+	__m128 dt = _mm_set1_ps(TICK);
+	__m128 dragFactor = _mm_set1_ps(-drag);
+	__m128 gravity = _mm_set1_ps(GRAVITY);
+	// the pool's capacity is a multiple of four, lanes past the end are scratch
+	for (unsigned int i = begin; i < end; i += 4) {
+		__m128 px = _mm_loadu_ps(&x[i]), py = _mm_loadu_ps(&y[i]), pz = _mm_loadu_ps(&z[i]);
+		_mm_storeu_ps(&previousX[i], px);
+		_mm_storeu_ps(&previousY[i], py);
+		_mm_storeu_ps(&previousZ[i], pz);
+		__m128 vx = _mm_loadu_ps(&velocityX[i]), vy = _mm_loadu_ps(&velocityY[i]), vz = _mm_loadu_ps(&velocityZ[i]);
+		__m128 speed = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_add_ps(_mm_mul_ps(vy, vy), _mm_mul_ps(vz, vz))));
+		__m128 scale = _mm_mul_ps(_mm_mul_ps(dragFactor, speed), dt);
+		vx = _mm_add_ps(vx, _mm_mul_ps(vx, scale));
+		vy = _mm_add_ps(vy, _mm_add_ps(_mm_mul_ps(vy, scale), _mm_mul_ps(gravity, dt)));
+		vz = _mm_add_ps(vz, _mm_mul_ps(vz, scale));
+		_mm_storeu_ps(&velocityX[i], vx);
+		_mm_storeu_ps(&velocityY[i], vy);
+		_mm_storeu_ps(&velocityZ[i], vz);
+		_mm_storeu_ps(&x[i], _mm_add_ps(px, _mm_mul_ps(vx, dt)));
+		_mm_storeu_ps(&y[i], _mm_add_ps(py, _mm_mul_ps(vy, dt)));
+		_mm_storeu_ps(&z[i], _mm_add_ps(pz, _mm_mul_ps(vz, dt)));
+		_mm_storeu_ps(&age[i], _mm_add_ps(_mm_loadu_ps(&age[i]), dt));
+	}
+	for (unsigned int i = begin; i < end; i++) {
+		if (state[i] != PROJECTILE_FLYING) {
+			x[i] = previousX[i];
+			y[i] = previousY[i];
+			z[i] = previousZ[i];
+		}
+	}
+}
+
+/*
+*	Sweeps a projectile's sphere along this tick's segment and stops it at the earliest contact. 
+*	Boxes are tested as their local cube grown by the radius, which is slightly too large at the 
+*	edges and corners. Targets are found by a ray query of the projectile's thickness, every sphere 
+*	it passes is refined against the target's shape.
+*/
+void Ballistics::collide(unsigned int i) {
+	glm::vec3 from(previousX[i], previousY[i], previousZ[i]);
+	glm::vec3 to(x[i], y[i], z[i]);
+	glm::vec3 segment = to - from;
+	float nearest = 2.0f;
+	Impact impact;
+
+	// ground, only hit from above
+	float height = ground + radius;
+	if (from.y >= height && to.y < height) {
+		nearest = (from.y - height) / (from.y - to.y);
+		impact.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+		impact.target = -1;
+	}
+
+	// boxes, slab test in local space
+	for (unsigned int b = 0; b < boxes.size(); b++) {
+		const Box &box = boxes[b];
+		glm::vec3 start = glm::vec3(box.toLocal * glm::vec4(from, 1.0f));
+		glm::vec3 direction = glm::vec3(box.toLocal * glm::vec4(segment, 0.0f));
+		float enter = 0.0f, exit = 1.0f;
+		int axis = -1;
+		bool missed = false;
+		for (int a = 0; a < 3 && !missed; a++) {
+			if (direction[a] == 0.0f) {
+				missed = start[a] < -box.extent || start[a] > box.extent;
+				continue;
+			}
+			float t0 = (-box.extent - start[a]) / direction[a];
+			float t1 = (box.extent - start[a]) / direction[a];
+			if (t0 > t1) {
+				std::swap(t0, t1);
+			}
+			if (t0 > enter) {
+				enter = t0;
+				axis = a;
+			}
+			exit = t1 < exit ? t1 : exit;
+			missed = enter > exit;
+		}
+		// axis < 0 means the segment starts inside, which a previous tick would have caught
+		if (missed || axis < 0 || enter >= nearest) {
+			continue;
+		}
+		glm::vec3 normal(0.0f);
+		normal[axis] = direction[axis] > 0.0f ? -1.0f : 1.0f;
+		nearest = enter;
+		impact.normal = glm::normalize(glm::vec3(box.transform * glm::vec4(normal, 0.0f)));
+		impact.target = -1;
+	}
+
+	// targets
+	float length = glm::length(segment);
+	if (length > 0.0f) {
+		float distance;
+		TargetSweep sweep = { this, from, segment, length, glm::vec3(0.0f) };
+		int target = targetShape != nullptr
+			? targets->queryRay(from, segment / length, length, radius, distance, &Ballistics::sweepTarget, &sweep)
+			: targets->queryRay(from, segment / length, length, radius, distance);
+		if (target >= 0 && distance / length < nearest) {
+			nearest = distance / length;
+			glm::vec3 center = from + segment * nearest;
+			impact.normal = targetShape != nullptr ? sweep.normal : glm::normalize(center - targets->getCenter(target));
+			impact.target = target;
+			impact.targetCenter = targets->getCenter(target);
+		}
+	}
+
+	if (nearest <= 1.0f) {
+		impact.position = from + segment * nearest - impact.normal * radius;
+		impacts[i] = impact;
+		state[i] = PROJECTILE_IMPACT;
+	}
+	else if (age[i] > lifetime) {
+		state[i] = PROJECTILE_EXPIRED;
+	}
+}
+
+/*
+*	Narrow phase of the target query: sweeps the projectile against a target's shape in model 
+*	space and lowers distance if it hits before it.
+*/
+bool Ballistics::sweepTarget(void *context, unsigned int id, float &distance) {
+	TargetSweep &sweep = *static_cast<TargetSweep*>(context);
+	const Ballistics &self = *sweep.ballistics;
+	glm::vec3 start = glm::vec3(self.centerToShape * glm::vec4(sweep.from - self.targets->getCenter(id), 1.0f));
+	glm::vec3 segment = glm::vec3(self.centerToShape * glm::vec4(sweep.segment, 0.0f));
+	float fraction = distance / sweep.length;
+	glm::vec3 normal;
+	if (!self.targetShape->sweep(start, segment, self.shapeRadius, fraction, normal)) {
+		return false;
+	}
+	distance = fraction * sweep.length;
+	sweep.normal = glm::normalize(glm::vec3(self.shapeToCenter * glm::vec4(normal, 0.0f)));
+	return true;
+}
+
+/*
+*	Removes a projectile by moving the last one into its slot.
+*	
+*/
+void Ballistics::remove(unsigned int i) {
+	unsigned int last = --count;
+	x[i] = x[last];
+	y[i] = y[last];
+	z[i] = z[last];
+	previousX[i] = previousX[last];
+	previousY[i] = previousY[last];
+	previousZ[i] = previousZ[last];
+	velocityX[i] = velocityX[last];
+	velocityY[i] = velocityY[last];
+	velocityZ[i] = velocityZ[last];
+	age[i] = age[last];
+	state[i] = state[last];
+	impacts[i] = impacts[last];
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include "SpatialGrid.hpp"
+#include "TriangleBVH.hpp"
+
+/*
+*	Where a projectile struck, on the surface it hit. target is the id of the hit target in the 
+*	targets' spatial index or -1 for the static scene, targetCenter its sphere's center at that tick.
+*/
+struct Impact {
+	glm::vec3 position;
+	glm::vec3 normal;
+	int target;
+	glm::vec3 targetCenter;
+};
+
+/*
+*	Simulates projectiles under gravity and quadratic drag with fixed ticks the caller runs, in step 
+*	with the targets' ticks so every tick sees where the targets are then. Projectiles live in a 
+*	fixed pool stored as structure of arrays, four are integrated at once with SSE and the pool is 
+*	split into jobs. Every tick sweeps each projectile's sphere from its last position to the new 
+*	one against the ground, box colliders and the targets' triangles. Targets are found by their 
+*	bounding spheres in a spatial index and then swept against their shape's hierarchy.
+*/
+class Ballistics
+{
+public:
+	static const float TICK;						// same as TargetMotion::TICK
+	static const unsigned int MAX_PROJECTILES		= 4096;
+	Ballistics(float radius, float drag, float lifetime);
+	void setGround(float height);
+	void addBox(const glm::mat4 &transform);
+	void setTargetShape(const TriangleBVH *shape, const glm::mat4 &toCenter);
+	bool fire(const glm::vec3 &origin, const glm::vec3 &velocity);
+	void beginFrame(void);
+	void stepTick(const SpatialGrid &targets);
+	unsigned int getCount(void) const;
+	unsigned int getImpactCount(void) const;
+	const Impact &getImpact(unsigned int i) const;
+	unsigned int getHits(void) const;
+private:
+	enum State {
+		PROJECTILE_FLYING,
+		PROJECTILE_IMPACT,
+		PROJECTILE_EXPIRED
+	};
+	struct TargetSweep {
+		const Ballistics *ballistics;
+		glm::vec3 from;
+		glm::vec3 segment;
+		float length;
+		glm::vec3 normal;	// of the nearest hit so far
+	};
+	struct Box {
+		glm::mat4 transform;
+		glm::mat4 toLocal;
+		float extent;		// half size of the cube in local space grown by the projectile radius
+	};
+	float radius;
+	float drag;
+	float lifetime;
+	float ground;
+	std::vector<Box> boxes;
+	const SpatialGrid *targets;
+	const TriangleBVH *targetShape;		// shared by all targets, null to hit their spheres
+	glm::mat4 shapeToCenter;			// model space to the offset from a target's sphere center
+	glm::mat4 centerToShape;
+	float shapeRadius;					// projectile radius in model space
+	unsigned int count;
+	std::vector<float> x, y, z;
+	std::vector<float> previousX, previousY, previousZ;
+	std::vector<float> velocityX, velocityY, velocityZ;
+	std::vector<float> age;
+	std::vector<unsigned char> state;
+	std::vector<Impact> impacts;		// per projectile while flying, compacted into the frame's impacts
+	std::vector<Impact> frameImpacts;
+	unsigned int hits;
+	void step(unsigned int begin, unsigned int end);
+	void integrate(unsigned int begin, unsigned int end);
+	void collide(unsigned int i);
+	static bool sweepTarget(void *context, unsigned int id, float &distance);
+	void remove(unsigned int i);
+};
+
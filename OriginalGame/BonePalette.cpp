@@ -0,0 +1,88 @@
+#include "BonePalette.hpp"
+#include "StreamBuffer.hpp"
+#include <cstring>
+#include <vector>
+
+static std::vector<glm::mat4> matrices;		// only grows, so steady frames don't allocate
+static unsigned int matrixCount			= 0;
+static GLint texelBase					= 0;
+static TextureHandle texture;
+
+/*
+*	Drops last frame's palettes.
+*	
+*/
+void BonePalette::beginFrame() {
+	matrixCount = 0;
+}
+
+/*
+*	Reserves boneCount matrices and returns the index of the first. Pointers returned by getMatrices()
+*	stay valid only until the next allocate(), so reserve all ranges before filling them.
+*/
+int BonePalette::allocate(unsigned int boneCount) {
+	int first = static_cast<int>(matrixCount);
+	matrixCount += boneCount;
+	if (matrices.size() < matrixCount) {
+		matrices.resize(matrixCount);
+	}
+	return first;
+}
+
+/*
+*	Returns the matrices of a range returned by allocate().
+*	
+*/
+glm::mat4 *BonePalette::getMatrices(int first) {
+	return &matrices[first];
+}
+
+/*
+*	Streams this frame's matrices to the GPU and binds the texture buffer. Returns false if they
+*	didn't fit into the stream buffer, skinned meshes then have to be drawn in their bind pose.
+*/
+bool BonePalette::upload() {
+	if (matrixCount == 0) {
+		return true;
+	}
+	GLintptr offset;
+	void *data = StreamBuffer::get().map(matrixCount * sizeof(glm::mat4), sizeof(glm::mat4), offset);
+	if (data == nullptr) {
+		return false;
+	}
+	std::memcpy(data, &matrices[0], matrixCount * sizeof(glm::mat4));
+	StreamBuffer::get().unmap();
+	texelBase = static_cast<GLint>(offset / sizeof(glm::vec4));
+	if (texture.get() == 0) {
+		// the texture views the whole stream buffer, the shaders offset into this frame's region
+		texture = TextureHandle::create();
+		GLState::bindTexture(TEXTURE_UNIT, GL_TEXTURE_BUFFER, texture.get());
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, StreamBuffer::get().getBuffer());
+	}
+	GLState::bindTexture(TEXTURE_UNIT, GL_TEXTURE_BUFFER, texture.get());
+	return true;
+}
+
+/*
+*	Returns the paletteOffset uniform for a range, in texels from the start of the texture buffer.
+*	
+*/
+GLint BonePalette::getTexelOffset(int first) {
+	return texelBase + first * 4;
+}
+
+/*
+*	Returns the number of matrices reserved this frame.
+*	
+*/
+unsigned int BonePalette::getMatrixCount() {
+	return matrixCount;
+}
+
+/*
+*	Deletes the texture buffer, must be called while the GL context still exists.
+*	
+*/
+void BonePalette::shutdown() {
+	texture.reset();
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "GLHandle.hpp"
+
+/*
+*	Skinning matrices of all animated instances of a frame. Instances reserve their range first, 
+*	then fill it (in parallel), upload() streams everything at once and exposes it to the shaders 
+*	as a texture buffer on TEXTURE_UNIT, four RGBA32F texels per matrix.
+*/
+class BonePalette
+{
+public:
+	static const GLuint TEXTURE_UNIT = 9;
+	static void beginFrame(void);
+	static int allocate(unsigned int boneCount);
+	static glm::mat4 *getMatrices(int first);
+	static bool upload(void);
+	static GLint getTexelOffset(int first);
+	static unsigned int getMatrixCount(void);
+	static void shutdown(void);
+};
+
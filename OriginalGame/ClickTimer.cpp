@@ -0,0 +1,136 @@
+#include "ClickTimer.hpp"
+#include <GLFW/glfw3.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <Windows.h>
+
+static const char *WINDOW_CLASS				= "OriginalGameClickTimer";
+static LONGLONG stamps[ClickTimer::CAPACITY];
+static std::atomic<unsigned int> stamped(0);	// by the input thread
+static std::atomic<unsigned int> taken(0);		// by the render thread
+static std::thread thread;
+static std::mutex startMutex;
+static std::condition_variable started;
+static DWORD threadId						= 0;
+static int state							= 0;	// 0 starting, 1 running, -1 failed
+
+/*
+*	Stamps a raw left button press before anything else happens, if this process has the focus.
+*	
+*/
+static LRESULT CALLBACK windowProc(HWND window, UINT message, WPARAM wParam, LPARAM lParam) {
+	if (message == WM_INPUT) {
+		LARGE_INTEGER now;
+		QueryPerformanceCounter(&now);
+		RAWINPUT input;
+		UINT size = sizeof(input);
+		if (GetRawInputData(reinterpret_cast<HRAWINPUT>(lParam), RID_INPUT, &input, &size, sizeof(RAWINPUTHEADER)) != static_cast<UINT>(-1)
+			&& input.header.dwType == RIM_TYPEMOUSE && (input.data.mouse.usButtonFlags & RI_MOUSE_LEFT_BUTTON_DOWN)) {
+			DWORD process = 0;
+			GetWindowThreadProcessId(GetForegroundWindow(), &process);
+			unsigned int next = stamped.load(std::memory_order_relaxed);
+			if (process == GetCurrentProcessId() && next - taken.load(std::memory_order_acquire) < ClickTimer::CAPACITY) {
+				stamps[next % ClickTimer::CAPACITY] = now.QuadPart;
+				stamped.store(next + 1, std::memory_order_release);
+			}
+		}
+	}
+	return DefWindowProcA(window, message, wParam, lParam);
+}
+
+/*
+*	Starts the input thread, returns false if raw input is unavailable. Clicks are then only
+*	known to the frame that polls them.
+*/
+bool ClickTimer::start() {
+	std::unique_lock<std::mutex> lock(startMutex);
+	if (state == 1) {
+		return true;
+	}
+	state = 0;
+	thread = std::thread(&ClickTimer::threadLoop);
+	started.wait(lock, [] { return state != 0; });
+	if (state < 0) {
+		thread.join();
+		return false;
+	}
+	return true;
+}
+
+/*
+*	Ends the input thread and joins it.
+*	
+*/
+void ClickTimer::stop() {
+	if (!thread.joinable()) {
+		return;
+	}
+	PostThreadMessageA(threadId, WM_QUIT, 0, 0);
+	thread.join();
+	state = 0;
+}
+
+/*
+*	Takes the oldest press stamped at or after earliest (in glfwGetTime() seconds) and returns its
+*	time. Older stamps belong to presses the caller never saw, e.g. on the title bar, and are dropped.
+*/
+bool ClickTimer::take(double earliest, double &time) {
+	LARGE_INTEGER now, frequency;
+	QueryPerformanceCounter(&now);
+	double glfwNow = glfwGetTime();
+	QueryPerformanceFrequency(&frequency);
+	unsigned int next = taken.load(std::memory_order_relaxed);
+	unsigned int end = stamped.load(std::memory_order_acquire);
+	bool found = false;
+	while (next != end && !found) {
+		LONGLONG stamp = stamps[next % CAPACITY];
+		time = glfwNow - static_cast<double>(now.QuadPart - stamp) / static_cast<double>(frequency.QuadPart);
+		found = time >= earliest;
+		next++;
+	}
+	taken.store(next, std::memory_order_release);
+	return found;
+}
+
+/*
+*	Creates the message-only window, registers it for raw mouse input even without the focus and
+*	dispatches its messages until stop().
+*/
+void ClickTimer::threadLoop() {
+	HINSTANCE instance = GetModuleHandleA(nullptr);
+	WNDCLASSEXA windowClass = {};
+	windowClass.cbSize = sizeof(windowClass);
+	windowClass.lpfnWndProc = windowProc;
+	windowClass.hInstance = instance;
+	windowClass.lpszClassName = WINDOW_CLASS;
+	HWND window = RegisterClassExA(&windowClass) != 0
+		? CreateWindowExA(0, WINDOW_CLASS, "", 0, 0, 0, 0, 0, HWND_MESSAGE, nullptr, instance, nullptr)
+		: nullptr;
+	RAWINPUTDEVICE device;
+	device.usUsagePage = 0x01;		// generic desktop
+	device.usUsage = 0x02;			// mouse
+	device.dwFlags = RIDEV_INPUTSINK;
+	device.hwndTarget = window;
+	bool registered = window != nullptr && RegisterRawInputDevices(&device, 1, sizeof(device));
+	{
+		std::lock_guard<std::mutex> lock(startMutex);
+		threadId = GetCurrentThreadId();
+		state = registered ? 1 : -1;
+	}
+	started.notify_one();
+	if (registered) {
+		MSG message;
+		while (GetMessageA(&message, nullptr, 0, 0) > 0) {
+			DispatchMessageA(&message);
+		}
+		device.dwFlags = RIDEV_REMOVE;
+		device.hwndTarget = nullptr;
+		RegisterRawInputDevices(&device, 1, sizeof(device));
+	}
+	if (window != nullptr) {
+		DestroyWindow(window);
+	}
+	UnregisterClassA(WINDOW_CLASS, instance);
+}
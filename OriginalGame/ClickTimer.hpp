@@ -0,0 +1,20 @@
+#pragma once
+
+/*
+*	Timestamps left mouse button presses the moment Windows delivers them. A thread of its own
+*	registers a message-only window for raw mouse input and sleeps in GetMessage, so a press is
+*	stamped with QueryPerformanceCounter right away instead of when the frame polls its events.
+*	Only presses while this process has the focus are kept. Raw mouse input goes to one window per
+*	process, so GLFW's raw mouse motion has to stay off.
+*/
+class ClickTimer
+{
+public:
+	static const unsigned int CAPACITY = 64;	// stamps not taken yet, further presses are dropped
+	static bool start(void);
+	static void stop(void);
+	static bool take(double earliest, double &time);
+private:
+	static void threadLoop(void);
+};
+
@@ -0,0 +1,257 @@
+#include "Decals.hpp"
+#include "StreamBuffer.hpp"
+#include <cmath>
+#include <cstring>
+#include <cstddef>
+
+static const unsigned int MAX_VERTICES	= Decals::MAX_TRIANGLES * 3;
+static const unsigned int MAX_POLYGON	= 9;		// corners of a triangle clipped by six planes
+static const float MIN_FACING			= 0.3f;		// cosine between a surface and the decal's normal
+
+/*
+*	Clips a convex polygon to the side of a plane where position[axis] * sign <= limit and
+*	returns the number of corners written to output.
+*/
+static unsigned int clipPolygon(const glm::vec3 *input, unsigned int count, int axis, float sign, float limit, glm::vec3 *output) {
+	unsigned int result = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		const glm::vec3 &a = input[i];
+		const glm::vec3 &b = input[(i + 1) % count];
+		float insideA = limit - a[axis] * sign;
+		float insideB = limit - b[axis] * sign;
+		if (insideA >= 0.0f) {
+			output[result++] = a;
+		}
+		if ((insideA >= 0.0f) != (insideB >= 0.0f)) {
+			output[result++] = a + (b - a) * (insideA / (insideA - insideB));
+		}
+	}
+	return result;
+}
+
+/*
+*	Constructor, creates the vertex slots, the atlas and the shader. scene holds the static scene's 
+*	triangles in world space, targetShape a target's in model space and targetBase places it 
+*	relative to a target's position. Either may be null, nothing is decaled there then.
+*/
+Decals::Decals(const TriangleBVH *scene, const TriangleBVH *targetShape, const glm::mat4 &targetBase) 
+	: scene(scene), targetShape(targetShape), targetBase(targetBase), toTargetShape(glm::inverse(targetBase)), 
+	instances(CAPACITY), attachedTo(CAPACITY, -1), next(0), count(0), widest(0), random(0x9E3779B9u),
+	shader("src/shaders/decal.vert", "src/shaders/decal.frag"), VAO(VertexArrayHandle::create()), 
+	vertexBuffer(BufferHandle::create()), vertexTexture(TextureHandle::create()) {
+	clipped.reserve(MAX_VERTICES);
+	GLsizeiptr size = CAPACITY * MAX_VERTICES * sizeof(glm::vec4);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, vertexBuffer.get());
+	glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+	GPUMemory::trackBuffer(vertexBuffer.get(), size, GPU_MEMORY_GEOMETRY, "Decals");
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+	GLState::bindTexture(VERTEX_UNIT, GL_TEXTURE_BUFFER, vertexTexture.get());
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, vertexBuffer.get());
+	// only per decal attributes, the vertices are fetched from their slot
+	GLState::bindVertexArray(VAO.get());
+	for (GLuint i = 0; i <= 3; i++) {
+		glEnableVertexAttribArray(i);
+		glVertexAttribDivisor(i, 1);
+	}
+	GLState::bindVertexArray(0);
+	createAtlas();
+	shader.use();
+	shader.setInt("atlas", 0);
+	shader.setInt("vertices", VERTEX_UNIT);
+	shader.setInt("maxVertices", MAX_VERTICES);
+	shader.setFloat("tilesPerRow", static_cast<float>(ATLAS_TILES));
+}
+
+/*
+*	Adds a decal of the given half size on the static scene. Returns false if the scene has no 
+*	surface facing the normal there.
+*/
+bool Decals::add(const glm::vec3 &position, const glm::vec3 &normal, float size) {
+	if (scene == nullptr) {
+		return false;
+	}
+	return place(*scene, glm::mat4(), glm::mat4(), position, normal, size, glm::vec3(0.0f), -1);
+}
+
+/*
+*	Adds a decal of the given half size on a target, which is at targetPosition right now. It moves
+*	with the target from then on, see update().
+*/
+bool Decals::addToTarget(unsigned int target, const glm::vec3 &targetPosition, const glm::vec3 &position, const glm::vec3 &normal, float size) {
+	if (targetShape == nullptr) {
+		return false;
+	}
+	return place(*targetShape, toTargetShape, targetBase, position - targetPosition, normal, size, targetPosition, static_cast<int>(target));
+}
+
+/*
+*	Moves the decals on targets to the targets' current positions, in TargetMotion::interpolate 
+*	order like the ids passed to addToTarget().
+*/
+void Decals::update(const float *x, const float *y, const float *z, unsigned int targetCount) {
+	for (unsigned int i = 0; i < count; i++) {
+		int target = attachedTo[i];
+		if (target >= 0 && static_cast<unsigned int>(target) < targetCount) {
+			instances[i].offset = glm::vec4(x[target], y[target], z[target], 0.0f);
+		}
+	}
+}
+
+/*
+*	Streams all decals and draws them with one instanced draw, blended over the scene without 
+*	writing depth. Every decal is drawn with as many vertices as the largest one, the unused ones 
+*	collapse. Leaves depth writes disabled.
+*/
+void Decals::draw(const glm::mat4 &viewProjection) {
+	if (count == 0) {
+		return;
+	}
+	GLintptr offset;
+	void *data = StreamBuffer::get().map(count * sizeof(Instance), sizeof(glm::vec4), offset);
+	if (data == nullptr) {
+		return;
+	}
+	std::memcpy(data, &instances[0], count * sizeof(Instance));
+	StreamBuffer::get().unmap();
+
+	GLState::bindVertexArray(VAO.get());
+	GLState::bindBuffer(GL_ARRAY_BUFFER, StreamBuffer::get().getBuffer());
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offset + offsetof(Instance, positionSize)));
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offset + offsetof(Instance, normalTile)));
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offset + offsetof(Instance, tangentCount)));
+	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offset + offsetof(Instance, offset)));
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+
+	shader.use();
+	shader.setMat4("viewProjection", viewProjection);
+	GLState::bindTexture(0, GL_TEXTURE_2D, atlas.get());
+	GLState::bindTexture(VERTEX_UNIT, GL_TEXTURE_BUFFER, vertexTexture.get());
+	GLState::depthMask(GL_FALSE);
+	// the clipped triangles are coplanar with the surface, pull them towards the camera in depth only
+	GLState::enable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(-1.0f, -1.0f);
+	glDrawArraysInstanced(GL_TRIANGLES, 0, static_cast<GLsizei>(widest), static_cast<GLsizei>(count));
+	RenderStats::countDraw(GL_TRIANGLES, static_cast<GLsizei>(widest), static_cast<GLsizei>(count));
+	GLState::disable(GL_POLYGON_OFFSET_FILL);
+}
+
+/*
+*	Returns the number of live decals.
+*	
+*/
+unsigned int Decals::getCount() const {
+	return count;
+}
+
+/*
+*	Clips the receiver's triangles facing the normal to the decal's box and writes them into the next
+*	slot. center and normal are in the space the decal is kept in, toReceiver and fromReceiver map
+*	between it and the receiver's triangles. Returns false if nothing was left to draw on.
+*/
+bool Decals::place(const TriangleBVH &receiver, const glm::mat4 &toReceiver, const glm::mat4 &fromReceiver, const glm::vec3 &center, const glm::vec3 &normal, float size, const glm::vec3 &offset, int target) {
+	random ^= random << 13;
+	random ^= random >> 17;
+	random ^= random << 5;
+	float angle = static_cast<float>(random & 0xFFFF) / 65536.0f * 6.2831853f;
+	glm::vec3 helper = std::fabs(normal.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+	glm::vec3 side = glm::normalize(glm::cross(helper, normal));
+	glm::vec3 tangent = side * std::cos(angle) + glm::cross(normal, side) * std::sin(angle);
+	glm::vec3 bitangent = glm::cross(normal, tangent);
+
+	glm::vec3 minimum, maximum;
+	for (int k = 0; k < 8; k++) {
+		glm::vec3 corner = center
+			+ tangent * ((k & 1) ? size : -size)
+			+ bitangent * ((k & 2) ? size : -size)
+			+ normal * ((k & 4) ? size : -size);
+		glm::vec3 point = glm::vec3(toReceiver * glm::vec4(corner, 1.0f));
+		minimum = k == 0 ? point : glm::min(minimum, point);
+		maximum = k == 0 ? point : glm::max(maximum, point);
+	}
+	candidates.clear();
+	receiver.queryBox(minimum, maximum, candidates);
+
+	clipped.clear();
+	for (unsigned int i = 0; i < candidates.size() && clipped.size() < MAX_VERTICES; i++) {
+		const glm::vec3 *triangle = receiver.getTriangle(candidates[i]);
+		glm::vec3 polygon[MAX_POLYGON], scratch[MAX_POLYGON];
+		for (int k = 0; k < 3; k++) {
+			glm::vec3 point = glm::vec3(fromReceiver * glm::vec4(triangle[k], 1.0f)) - center;
+			polygon[k] = glm::vec3(glm::dot(point, tangent), glm::dot(point, bitangent), glm::dot(point, normal));
+		}
+		// two-sided like the hit tests, faces seen from the side are skipped
+		glm::vec3 face = glm::cross(polygon[1] - polygon[0], polygon[2] - polygon[0]);
+		float area = glm::length(face);
+		if (area == 0.0f || std::fabs(face.z) < MIN_FACING * area) {
+			continue;
+		}
+		unsigned int corners = 3;
+		for (int plane = 0; plane < 6 && corners > 0; plane++) {
+			corners = clipPolygon(polygon, corners, plane / 2, plane % 2 ? 1.0f : -1.0f, size, scratch);
+			std::memcpy(polygon, scratch, corners * sizeof(glm::vec3));
+		}
+		for (unsigned int k = 1; k + 1 < corners && clipped.size() < MAX_VERTICES; k++) {
+			clipped.push_back(glm::vec4(polygon[0], 1.0f));
+			clipped.push_back(glm::vec4(polygon[k], 1.0f));
+			clipped.push_back(glm::vec4(polygon[k + 1], 1.0f));
+		}
+	}
+	if (clipped.empty()) {
+		return false;
+	}
+
+	Instance &instance = instances[next];
+	instance.positionSize = glm::vec4(center, size);
+	instance.normalTile = glm::vec4(normal, static_cast<float>((random >> 16) % (ATLAS_TILES * ATLAS_TILES)));
+	instance.tangentCount = glm::vec4(tangent, static_cast<float>(clipped.size()));
+	instance.offset = glm::vec4(offset, 0.0f);
+	attachedTo[next] = target;
+	GLsizeiptr bytes = clipped.size() * sizeof(glm::vec4);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, vertexBuffer.get());
+	glBufferSubData(GL_ARRAY_BUFFER, next * MAX_VERTICES * sizeof(glm::vec4), bytes, &clipped[0]);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+	RenderStats::countUpload(bytes);
+	widest = clipped.size() > widest ? static_cast<unsigned int>(clipped.size()) : widest;
+	next = (next + 1) % CAPACITY;
+	count = count < CAPACITY ? count + 1 : CAPACITY;
+	return true;
+}
+
+/*
+*	Paints the atlas: bullet holes with a dark core and a ragged, fading rim, every tile with its 
+*	own rim so neighbouring decals don't look alike.
+*/
+void Decals::createAtlas() {
+	const int size = ATLAS_TILES * TILE_SIZE;
+	std::vector<unsigned char> pixels(size * size * 4);
+	for (int tile = 0; tile < static_cast<int>(ATLAS_TILES * ATLAS_TILES); tile++) {
+		int originX = (tile % ATLAS_TILES) * TILE_SIZE;
+		int originY = (tile / ATLAS_TILES) * TILE_SIZE;
+		for (int y = 0; y < static_cast<int>(TILE_SIZE); y++) {
+			for (int x = 0; x < static_cast<int>(TILE_SIZE); x++) {
+				float u = (x + 0.5f) / TILE_SIZE * 2.0f - 1.0f;
+				float v = (y + 0.5f) / TILE_SIZE * 2.0f - 1.0f;
+				float radius = std::sqrt(u * u + v * v);
+				float angle = std::atan2(v, u);
+				float rim = 0.75f + 0.12f * std::sin(angle * (5 + tile) + tile * 1.7f) + 0.06f * std::sin(angle * (11 + 2 * tile));
+				float core = radius < 0.3f ? 1.0f : (radius < 0.4f ? (0.4f - radius) * 10.0f : 0.0f);
+				float scorch = radius < rim ? 1.0f - radius / rim : 0.0f;
+				float alpha = std::fmin(1.0f, core + scorch * 0.8f);
+				float shade = 0.15f * (1.0f - core);
+				unsigned char *pixel = &pixels[((originY + y) * size + originX + x) * 4];
+				pixel[0] = pixel[1] = pixel[2] = static_cast<unsigned char>(shade * 255.0f);
+				pixel[3] = static_cast<unsigned char>(alpha * 255.0f);
+			}
+		}
+	}
+	atlas = TextureHandle::create();
+	GLState::bindTexture(0, GL_TEXTURE_2D, atlas.get());
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	RenderStats::countUpload(pixels.size());
+	GPUMemory::trackTexture(atlas.get(), GPUMemory::textureSize(GL_RGBA8, size, size, 1, true), GPU_MEMORY_TEXTURES, "Decals");
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
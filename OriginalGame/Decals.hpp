@@ -0,0 +1,58 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Shader.hpp"
+#include "GLHandle.hpp"
+#include "TriangleBVH.hpp"
+
+/*
+*	Impact decals in a fixed ring, a new decal replaces the oldest once it is full. A decal is a box
+*	along the impact normal, the triangles of the surface it hit are clipped to it on the CPU, so it
+*	lies on the surface and ends at sharp edges instead of hanging over them. The clipped triangles go
+*	into the decal's fixed slot of a texture buffer, decals on targets are kept relative to their
+*	target and follow it. All of them are drawn with one instanced draw from a procedural atlas, so
+*	impacts never allocate or add draw calls.
+*/
+class Decals
+{
+public:
+	static const unsigned int CAPACITY		= 2048;
+	static const unsigned int MAX_TRIANGLES	= 32;	// per decal, triangles past it are cut off
+	static const unsigned int ATLAS_TILES	= 2;	// per side
+	static const unsigned int TILE_SIZE		= 64;	// pixels
+	static const GLuint VERTEX_UNIT			= 1;	// texture unit of the clipped triangles while drawing
+	Decals(const TriangleBVH *scene, const TriangleBVH *targetShape, const glm::mat4 &targetBase);
+	bool add(const glm::vec3 &position, const glm::vec3 &normal, float size);
+	bool addToTarget(unsigned int target, const glm::vec3 &targetPosition, const glm::vec3 &position, const glm::vec3 &normal, float size);
+	void update(const float *x, const float *y, const float *z, unsigned int targetCount);
+	void draw(const glm::mat4 &viewProjection);
+	unsigned int getCount(void) const;
+private:
+	struct Instance {
+		glm::vec4 positionSize;		// relative to the offset
+		glm::vec4 normalTile;
+		glm::vec4 tangentCount;		// vertices in the decal's slot in w
+		glm::vec4 offset;			// position of the decal's target, 0 on the static scene
+	};
+	const TriangleBVH *scene;
+	const TriangleBVH *targetShape;
+	glm::mat4 targetBase;
+	glm::mat4 toTargetShape;
+	std::vector<Instance> instances;
+	std::vector<int> attachedTo;		// target per decal, -1 for the static scene
+	std::vector<unsigned int> candidates;
+	std::vector<glm::vec4> clipped;		// of the decal being added, in its own space
+	unsigned int next;
+	unsigned int count;
+	unsigned int widest;				// most vertices any decal had so far
+	unsigned int random;
+	Shader shader;
+	VertexArrayHandle VAO;
+	BufferHandle vertexBuffer;
+	TextureHandle vertexTexture;
+	TextureHandle atlas;
+	bool place(const TriangleBVH &receiver, const glm::mat4 &toReceiver, const glm::mat4 &fromReceiver, const glm::vec3 &center, const glm::vec3 &normal, float size, const glm::vec3 &offset, int target);
+	void createAtlas(void);
+};
+
@@ -0,0 +1,156 @@
+#include "FrameArena.hpp"
+#include <atomic>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+/*
+*	Header of an arena block, the block's memory follows it.
+*	
+*/
+struct Block {
+	Block *next;		// older block of the same frame
+	size_t capacity;
+};
+
+/*
+*	A thread's arena, head is the newest block. Arenas reset themselves on their first allocation
+*	of a new frame.
+*/
+struct Arena {
+	Block *head;
+	size_t used;		// in head
+	size_t total;		// capacity of all blocks
+	unsigned int frame;
+	Arena() : head(nullptr), used(0), total(0), frame(0) {}
+	~Arena();
+};
+
+static std::atomic<unsigned int> currentFrame(0);
+static std::atomic<unsigned int> growths(0);
+static thread_local Arena arena;
+
+/*
+*	Allocates a block with room for capacity bytes.
+*	
+*/
+static Block *createBlock(size_t capacity, Block *next) {
+	Block *block = static_cast<Block*>(std::malloc(sizeof(Block) + capacity));
+	if (block == nullptr) {
+		return nullptr;
+	}
+	block->next = next;
+	block->capacity = capacity;
+	return block;
+}
+
+/*
+*	Frees a chain of blocks.
+*	
+*/
+static void freeBlocks(Block *block) {
+	while (block != nullptr) {
+		Block *next = block->next;
+		std::free(block);
+		block = next;
+	}
+}
+
+/*
+*	Destructor, runs when the owning thread exits.
+*	
+*/
+Arena::~Arena() {
+	freeBlocks(head);
+}
+
+/*
+*	Starts a new frame on the calling thread's arena. Blocks chained last frame are merged into a
+*	single one large enough for all of them.
+*/
+static void reset(Arena &arena, unsigned int frame) {
+	arena.frame = frame;
+	arena.used = 0;
+	if (arena.head != nullptr && arena.head->next != nullptr) {
+		freeBlocks(arena.head);
+		arena.head = createBlock(arena.total, nullptr);
+		arena.total = arena.head != nullptr ? arena.total : 0;
+	}
+}
+
+/*
+*	Releases everything allocated in the last frame on every thread. Call while no job is running.
+*	
+*/
+void FrameArena::beginFrame() {
+	currentFrame.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+*	Returns size bytes aligned to alignment (a power of two) that stay valid until the next
+*	beginFrame(). Returns nullptr only if the heap is exhausted.
+*/
+void *FrameArena::allocate(size_t size, size_t alignment) {
+	Arena &local = arena;
+	unsigned int frame = currentFrame.load(std::memory_order_relaxed);
+	if (local.frame != frame) {
+		reset(local, frame);
+	}
+	if (local.head != nullptr) {
+		uintptr_t base = reinterpret_cast<uintptr_t>(local.head + 1);
+		uintptr_t address = (base + local.used + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+		if (address + size <= base + local.head->capacity) {
+			local.used = address + size - base;
+			return reinterpret_cast<void*>(address);
+		}
+		growths.fetch_add(1, std::memory_order_relaxed);
+	}
+	size_t capacity = size + alignment > BLOCK_SIZE ? size + alignment : BLOCK_SIZE;
+	Block *block = createBlock(capacity, local.head);
+	if (block == nullptr) {
+		return nullptr;
+	}
+	local.head = block;
+	local.total += capacity;
+	uintptr_t base = reinterpret_cast<uintptr_t>(block + 1);
+	uintptr_t address = (base + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+	local.used = address + size - base;
+	return reinterpret_cast<void*>(address);
+}
+
+/*
+*	printf into a string in the calling thread's arena.
+*	
+*/
+FrameString FrameArena::format(const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	va_list measure;
+	va_copy(measure, args);
+	int length = std::vsnprintf(nullptr, 0, format, measure);
+	va_end(measure);
+	FrameString result;
+	if (length > 0) {
+		result.resize(static_cast<size_t>(length));
+		std::vsnprintf(&result[0], result.size() + 1, format, args);
+	}
+	va_end(args);
+	return result;
+}
+
+/*
+*	Returns the bytes the calling thread allocated this frame in its newest block.
+*	
+*/
+size_t FrameArena::getUsed() {
+	return arena.frame == currentFrame.load(std::memory_order_relaxed) ? arena.used : 0;
+}
+
+/*
+*	Returns how often an arena ran out of room and had to chain a block, on any thread so far.
+*	
+*/
+unsigned int FrameArena::getGrowths() {
+	return growths.load(std::memory_order_relaxed);
+}
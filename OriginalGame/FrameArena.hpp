@@ -0,0 +1,94 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+template <typename T>
+class FrameAllocator;
+
+typedef std::basic_string<char, std::char_traits<char>, FrameAllocator<char>> FrameString;
+
+/*
+*	Per-thread bump allocator for data that only lives until the end of the frame. Every thread
+*	allocates from its own block without locking and beginFrame() releases all of them at once. An
+*	arena that runs out chains another block and merges them at the next reset, so once the blocks
+*	have grown to the peak frame steady frames never touch the heap.
+*/
+class FrameArena
+{
+public:
+	static const size_t BLOCK_SIZE = 64 * 1024;
+	static void beginFrame(void);
+	static void *allocate(size_t size, size_t alignment);
+	static FrameString format(const char *format, ...);
+	static size_t getUsed(void);
+	static unsigned int getGrowths(void);
+};
+
+/*
+*	Standard allocator on top of the calling thread's frame arena, deallocation is a no-op. Strings
+*	and containers using it must not outlive the frame.
+*/
+template <typename T>
+class FrameAllocator
+{
+public:
+	typedef T value_type;
+	FrameAllocator();
+	template <typename U>
+	FrameAllocator(const FrameAllocator<U> &other);
+	T *allocate(size_t count);
+	void deallocate(T *pointer, size_t count);
+};
+
+/*
+*	Constructor, the allocator is stateless.
+*	
+*/
+template <typename T>
+FrameAllocator<T>::FrameAllocator() {
+}
+
+/*
+*	Rebinding constructor.
+*	
+*/
+template <typename T>
+template <typename U>
+FrameAllocator<T>::FrameAllocator(const FrameAllocator<U>&) {
+}
+
+/*
+*	Allocates count objects from the calling thread's arena.
+*	
+*/
+template <typename T>
+T *FrameAllocator<T>::allocate(size_t count) {
+	return static_cast<T*>(FrameArena::allocate(count * sizeof(T), alignof(T)));
+}
+
+/*
+*	Frame memory is released all at once by FrameArena::beginFrame().
+*	
+*/
+template <typename T>
+void FrameAllocator<T>::deallocate(T*, size_t) {
+}
+
+/*
+*	All frame allocators share the arenas, so memory from one can be handed to any other.
+*	
+*/
+template <typename T, typename U>
+bool operator==(const FrameAllocator<T>&, const FrameAllocator<U>&) {
+	return true;
+}
+
+/*
+*	See operator==.
+*	
+*/
+template <typename T, typename U>
+bool operator!=(const FrameAllocator<T>&, const FrameAllocator<U>&) {
+	return false;
+}
+
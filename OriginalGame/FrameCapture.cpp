@@ -0,0 +1,550 @@
+#include "FrameCapture.hpp"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <Windows.h>
+
+namespace dev {
+	void eventLog(const std::string eventMsg);
+}
+
+/*
+*	Constructor, starts the worker thread. GL objects are only created once something is captured.
+*	
+*/
+FrameCapture::FrameCapture() 
+	: firstPending(0), pendingCount(0), screenshotRequested(false), recording(false), stopping(false), nextVideoTime(-1.0f),
+	videoWidth(0), videoHeight(0), droppedFrames(0), droppedTicks(0), screenshotCount(0), running(true), firstJob(0), jobCount(0), messageCount(0) {
+	for (unsigned int i = 0; i < SLOT_COUNT; i++) {
+		slots[i].pbo = 0;
+		slots[i].capacity = 0;
+		slots[i].fence = 0;
+	}
+	freeFrames.reserve(FRAME_POOL_SIZE);
+	for (unsigned int i = 0; i < FRAME_POOL_SIZE; i++) {
+		freeFrames.push_back(&frames[i]);
+	}
+	worker = std::thread(&FrameCapture::workerLoop, this);
+}
+
+/*
+*	Captures the next frame as a PNG screenshot.
+*	
+*/
+void FrameCapture::requestScreenshot() {
+	screenshotRequested = true;
+}
+
+/*
+*	Starts recording the session to a Y4M video with VIDEO_FPS frames per second.
+*	
+*/
+void FrameCapture::startRecording() {
+	if (recording || stopping) {
+		return;
+	}
+	recording = true;
+	nextVideoTime = -1.0f;
+	droppedTicks = 0;
+}
+
+/*
+*	Stops recording without waiting. Frames that are still in flight are collected by the following 
+*	capture() calls, which close the file once the last one is handed to the worker.
+*/
+void FrameCapture::stopRecording() {
+	if (!recording) {
+		return;
+	}
+	recording = false;
+	stopping = nextVideoTime >= 0.0f;
+}
+
+/*
+*	Returns true while a video is being recorded.
+*	
+*/
+bool FrameCapture::isRecording() const {
+	return recording;
+}
+
+/*
+*	Called once per frame after the image has been presented (before the HUD is drawn). Hands finished
+*	readbacks to the worker and starts new ones for a requested screenshot or the next video frame.
+*/
+void FrameCapture::capture(int width, int height, float time) {
+	collect();
+	if (stopping && pendingCount == 0) {
+		endVideo();
+	}
+	char log[MAX_MESSAGES][MESSAGE_LENGTH];
+	unsigned int logCount;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		logCount = messageCount;
+		memcpy(log, messages, logCount * MESSAGE_LENGTH);
+		messageCount = 0;
+	}
+	for (unsigned int i = 0; i < logCount; i++) {
+		dev::eventLog(log[i]);
+	}
+	if (screenshotRequested) {
+		screenshotRequested = false;
+		readback(JOB_SCREENSHOT, width, height, 1);
+	}
+	if (!recording) {
+		return;
+	}
+	if (nextVideoTime < 0.0f) {
+		// 4:2:0 chroma needs even dimensions
+		videoWidth = width & ~1;
+		videoHeight = height & ~1;
+		nextVideoTime = time;
+		Job job = makeJob(JOB_VIDEO_START, videoWidth, videoHeight, 0, nullptr);
+		char stamp[32];
+		timestamp(stamp, sizeof(stamp));
+		snprintf(job.path, PATH_LENGTH, "captures/session_%s.y4m", stamp);
+		pushJob(job);
+		dev::eventLog(std::string("Recording started: ") + job.path);
+	}
+	else if ((width & ~1) != videoWidth || (height & ~1) != videoHeight) {
+		dev::eventLog("Window resized, recording stopped");
+		stopRecording();
+		return;
+	}
+	if (time < nextVideoTime) {
+		return;
+	}
+	// below VIDEO_FPS a frame stands in for all video frames it covers, so the clip keeps real time
+	unsigned int ticks = static_cast<unsigned int>((time - nextVideoTime) * VIDEO_FPS) + 1;
+	ticks = ticks > VIDEO_FPS ? VIDEO_FPS : ticks;
+	nextVideoTime += static_cast<float>(ticks) / VIDEO_FPS;
+	if (nextVideoTime < time) {
+		nextVideoTime = time + 1.0f / VIDEO_FPS;
+	}
+	readback(JOB_VIDEO_FRAME, videoWidth, videoHeight, ticks);
+}
+
+/*
+*	Returns the number of frames that were dropped because all pixel buffers were still in flight.
+*	
+*/
+unsigned int FrameCapture::getDroppedFrames() const {
+	return droppedFrames;
+}
+
+/*
+*	Finishes a running recording, waits for the worker and releases the GL objects. 
+*	Has to be called while the context is still current.
+*/
+void FrameCapture::shutdown() {
+	if (!running) {
+		return;
+	}
+	stopRecording();
+	// the only place that waits: the last frames have to make it into their files
+	collect();
+	while (pendingCount > 0) {
+		glClientWaitSync(slots[firstPending].fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000);
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			frameReturned.wait(lock, [this]() { return !freeFrames.empty(); });
+		}
+		collect();
+	}
+	if (stopping) {
+		endVideo();
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	wake.notify_one();
+	worker.join();
+	for (unsigned int i = 0; i < SLOT_COUNT; i++) {
+		if (slots[i].fence != 0) {
+			glDeleteSync(slots[i].fence);
+		}
+		if (slots[i].pbo != 0) {
+			GLState::deleteBuffers(1, &slots[i].pbo);
+		}
+	}
+	pendingCount = 0;
+}
+
+/*
+*	Moves every readback whose fence has signaled to the worker, in the order they were issued. 
+*	Readbacks stay in their slots while the worker holds all frame buffers.
+*/
+void FrameCapture::collect() {
+	while (pendingCount > 0) {
+		Slot &slot = slots[firstPending];
+		if (glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+			break;
+		}
+		size_t size = static_cast<size_t>(slot.width) * slot.height * 4;
+		std::vector<unsigned char> *pixels = takeFrame(size);
+		if (pixels == nullptr) {
+			break;
+		}
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+		GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+		void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+		if (data != nullptr) {
+			memcpy(&(*pixels)[0], data, size);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			Job job = makeJob(slot.type, slot.width, slot.height, slot.repeat, pixels);
+			if (slot.type == JOB_SCREENSHOT) {
+				char stamp[32];
+				timestamp(stamp, sizeof(stamp));
+				snprintf(job.path, PATH_LENGTH, "screenshots/screenshot_%s_%u.png", stamp, screenshotCount++);
+			}
+			pushJob(job);
+		}
+		else {
+			returnFrame(pixels);
+			droppedTicks += slot.type == JOB_VIDEO_FRAME ? slot.repeat : 0;
+		}
+		GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		firstPending = (firstPending + 1) % SLOT_COUNT;
+		pendingCount--;
+	}
+}
+
+/*
+*	Queues closing the video file after all of its frames.
+*	
+*/
+void FrameCapture::endVideo() {
+	stopping = false;
+	pushJob(makeJob(JOB_VIDEO_END, 0, 0, 0, nullptr));
+	dev::eventLog("Recording stopped");
+}
+
+/*
+*	Starts an asynchronous readback of the default framebuffer into the next free pixel buffer. A 
+*	dropped video frame's repeats go to the next one that is read back.
+*/
+void FrameCapture::readback(JobType type, int width, int height, unsigned int repeat) {
+	if (pendingCount == SLOT_COUNT) {
+		droppedFrames++;
+		droppedTicks += type == JOB_VIDEO_FRAME ? repeat : 0;
+		return;
+	}
+	if (type == JOB_VIDEO_FRAME) {
+		repeat += droppedTicks;
+		droppedTicks = 0;
+	}
+	Slot &slot = slots[(firstPending + pendingCount) % SLOT_COUNT];
+	GLsizeiptr size = static_cast<GLsizeiptr>(width) * height * 4;
+	if (slot.pbo == 0) {
+		glGenBuffers(1, &slot.pbo);
+	}
+	GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	if (slot.capacity < size) {
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+		GPUMemory::trackBuffer(slot.pbo, size, GPU_MEMORY_STREAMING, "Frame capture");
+		slot.capacity = size;
+	}
+	GLState::bindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.type = type;
+	slot.width = width;
+	slot.height = height;
+	slot.repeat = repeat;
+	pendingCount++;
+}
+
+/*
+*	Queues a job for the worker thread. Waits if the queue is full, which only start and stop jobs 
+*	piling up behind a stalled disk can cause.
+*/
+void FrameCapture::pushJob(const Job &job) {
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		jobTaken.wait(lock, [this]() { return jobCount < JOB_CAPACITY; });
+		jobs[(firstJob + jobCount) % JOB_CAPACITY] = job;
+		jobCount++;
+	}
+	wake.notify_one();
+}
+
+/*
+*	Leaves a message for the render thread to log, from the worker thread. Dropped if too many are 
+*	waiting.
+*/
+void FrameCapture::postMessage(const char *text, const char *path) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (messageCount < MAX_MESSAGES) {
+		snprintf(messages[messageCount++], MESSAGE_LENGTH, "%s%s", text, path);
+	}
+}
+
+/*
+*	Takes a buffer of the pool and sizes it for a frame, returns nullptr if the worker holds all of 
+*	them. A buffer only reallocates when the window grows.
+*/
+std::vector<unsigned char> *FrameCapture::takeFrame(size_t size) {
+	std::vector<unsigned char> *frame = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (freeFrames.empty()) {
+			return nullptr;
+		}
+		frame = freeFrames.back();
+		freeFrames.pop_back();
+	}
+	frame->resize(size);
+	return frame;
+}
+
+/*
+*	Puts a buffer back into the pool.
+*	
+*/
+void FrameCapture::returnFrame(std::vector<unsigned char> *frame) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		freeFrames.push_back(frame);
+	}
+	frameReturned.notify_one();
+}
+
+/*
+*	Worker thread, encodes and writes queued frames until shutdown() and the queue is empty.
+*	
+*/
+void FrameCapture::workerLoop() {
+	CreateDirectoryA("screenshots", NULL);
+	CreateDirectoryA("captures", NULL);
+	while (true) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]() { return jobCount > 0 || !running; });
+			if (jobCount == 0) {
+				break;
+			}
+			job = jobs[firstJob];
+			firstJob = (firstJob + 1) % JOB_CAPACITY;
+			jobCount--;
+		}
+		jobTaken.notify_one();
+		switch (job.type) {
+		case JOB_SCREENSHOT:
+			writePNG(job);
+			break;
+		case JOB_VIDEO_START:
+			video.open(job.path, std::ios::binary);
+			video << "YUV4MPEG2 W" << job.width << " H" << job.height << " F" << VIDEO_FPS << ":1 Ip A1:1 C420jpeg\n";
+			break;
+		case JOB_VIDEO_FRAME:
+			writeVideoFrame(job);
+			break;
+		case JOB_VIDEO_END:
+			video.close();
+			break;
+		}
+		if (job.pixels != nullptr) {
+			returnFrame(job.pixels);
+		}
+	}
+}
+
+/*
+*	Encodes a frame as an RGB PNG. The image data is zlib-wrapped with stored (uncompressed) deflate 
+*	blocks, which keeps the encoder tiny and fast at the cost of file size.
+*/
+void FrameCapture::writePNG(const Job &job) {
+	const std::vector<unsigned char> &pixels = *job.pixels;
+	std::vector<unsigned char> raw;
+	raw.reserve(static_cast<size_t>(job.height) * (1 + job.width * 3));
+	for (int y = job.height - 1; y >= 0; y--) {
+		// GL rows start at the bottom
+		raw.push_back(0);
+		const unsigned char *row = &pixels[static_cast<size_t>(y) * job.width * 4];
+		for (int x = 0; x < job.width; x++) {
+			raw.push_back(row[x * 4]);
+			raw.push_back(row[x * 4 + 1]);
+			raw.push_back(row[x * 4 + 2]);
+		}
+	}
+	std::vector<unsigned char> zlib;
+	zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+	zlib.push_back(0x78);
+	zlib.push_back(0x01);
+	size_t position = 0;
+	do {
+		size_t length = raw.size() - position < 65535 ? raw.size() - position : 65535;
+		zlib.push_back(position + length == raw.size() ? 1 : 0);
+		zlib.push_back(length & 0xFF);
+		zlib.push_back((length >> 8) & 0xFF);
+		zlib.push_back(~length & 0xFF);
+		zlib.push_back((~length >> 8) & 0xFF);
+		zlib.insert(zlib.end(), raw.begin() + position, raw.begin() + position + length);
+		position += length;
+	} while (position < raw.size());
+	unsigned int a = 1, b = 0;
+	for (size_t i = 0; i < raw.size(); i++) {
+		a = (a + raw[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	unsigned int adler = (b << 16) | a;
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		zlib.push_back((adler >> shift) & 0xFF);
+	}
+
+	std::vector<unsigned char> header;
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		header.push_back((job.width >> shift) & 0xFF);
+	}
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		header.push_back((job.height >> shift) & 0xFF);
+	}
+	header.push_back(8);	// bit depth
+	header.push_back(2);	// color type RGB
+	header.push_back(0);	// compression
+	header.push_back(0);	// filter
+	header.push_back(0);	// interlace
+
+	std::ofstream file(job.path, std::ios::binary);
+	if (!file) {
+		postMessage("Failed to write screenshot ", job.path);
+		return;
+	}
+	static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+	writeChunk(file, "IHDR", header);
+	writeChunk(file, "IDAT", zlib);
+	writeChunk(file, "IEND", std::vector<unsigned char>());
+	postMessage("Screenshot saved: ", job.path);
+}
+
+/*
+*	Converts a frame to full range BT.601 YUV 4:2:0 and appends it to the video repeat times.
+*	
+*/
+void FrameCapture::writeVideoFrame(const Job &job) {
+	if (!video.is_open()) {
+		return;
+	}
+	const std::vector<unsigned char> &pixels = *job.pixels;
+	size_t lumaSize = static_cast<size_t>(job.width) * job.height;
+	size_t chromaSize = lumaSize / 4;
+	videoFrame.resize(lumaSize + 2 * chromaSize);
+	unsigned char *luma = &videoFrame[0];
+	unsigned char *cb = luma + lumaSize;
+	unsigned char *cr = cb + chromaSize;
+	for (int y = 0; y < job.height; y++) {
+		const unsigned char *row = &pixels[static_cast<size_t>(job.height - 1 - y) * job.width * 4];
+		for (int x = 0; x < job.width; x++) {
+			const unsigned char *p = row + x * 4;
+			luma[static_cast<size_t>(y) * job.width + x] = static_cast<unsigned char>(0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2] + 0.5f);
+		}
+	}
+	for (int y = 0; y < job.height / 2; y++) {
+		const unsigned char *top = &pixels[static_cast<size_t>(job.height - 1 - 2 * y) * job.width * 4];
+		const unsigned char *bottom = &pixels[static_cast<size_t>(job.height - 2 - 2 * y) * job.width * 4];
+		for (int x = 0; x < job.width / 2; x++) {
+			float r = (top[x * 8] + top[x * 8 + 4] + bottom[x * 8] + bottom[x * 8 + 4]) * 0.25f;
+			float g = (top[x * 8 + 1] + top[x * 8 + 5] + bottom[x * 8 + 1] + bottom[x * 8 + 5]) * 0.25f;
+			float b = (top[x * 8 + 2] + top[x * 8 + 6] + bottom[x * 8 + 2] + bottom[x * 8 + 6]) * 0.25f;
+			size_t index = static_cast<size_t>(y) * (job.width / 2) + x;
+			cb[index] = static_cast<unsigned char>(-0.168736f * r - 0.331264f * g + 0.5f * b + 128.5f);
+			cr[index] = static_cast<unsigned char>(0.5f * r - 0.418688f * g - 0.081312f * b + 128.5f);
+		}
+	}
+	for (unsigned int i = 0; i < job.repeat; i++) {
+		video << "FRAME\n";
+		video.write(reinterpret_cast<const char*>(&videoFrame[0]), videoFrame.size());
+	}
+}
+
+/*
+*	Returns a job without a path.
+*	
+*/
+FrameCapture::Job FrameCapture::makeJob(JobType type, int width, int height, unsigned int repeat, std::vector<unsigned char> *pixels) {
+	Job job;
+	job.type = type;
+	job.width = width;
+	job.height = height;
+	job.repeat = repeat;
+	job.pixels = pixels;
+	job.path[0] = '\0';
+	return job;
+}
+
+/*
+*	Writes the local time as YYYY-MM-DD_HH-MM-SS, used in file names.
+*	
+*/
+void FrameCapture::timestamp(char *buffer, size_t size) {
+	time_t now = time(0);
+	struct tm tstruct;
+	tstruct = *localtime(&now);
+	strftime(buffer, size, "%Y-%m-%d_%H-%M-%S", &tstruct);
+}
+
+/*
+*	Updates a CRC-32 (as used by PNG chunks) with the given data.
+*	
+*/
+unsigned int FrameCapture::crc32(const unsigned char *data, size_t length, unsigned int crc) {
+	static unsigned int table[256] = { 0 };
+	if (table[1] == 0) {
+		for (unsigned int n = 0; n < 256; n++) {
+			unsigned int c = n;
+			for (int k = 0; k < 8; k++) {
+				c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			table[n] = c;
+		}
+	}
+	crc = ~crc;
+	for (size_t i = 0; i < length; i++) {
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+/*
+*	Writes a PNG chunk: length, type, data and the CRC over type and data.
+*	
+*/
+void FrameCapture::writeChunk(std::ofstream &file, const char *type, const std::vector<unsigned char> &data) {
+	unsigned char length[4];
+	for (int i = 0; i < 4; i++) {
+		length[i] = (data.size() >> (24 - 8 * i)) & 0xFF;
+	}
+	file.write(reinterpret_cast<const char*>(length), 4);
+	file.write(type, 4);
+	unsigned int crc = crc32(reinterpret_cast<const unsigned char*>(type), 4, 0);
+	if (!data.empty()) {
+		file.write(reinterpret_cast<const char*>(&data[0]), data.size());
+		crc = crc32(&data[0], data.size(), crc);
+	}
+	unsigned char crcBytes[4];
+	for (int i = 0; i < 4; i++) {
+		crcBytes[i] = (crc >> (24 - 8 * i)) & 0xFF;
+	}
+	file.write(reinterpret_cast<const char*>(crcBytes), 4);
+}
+
+/*
+*	Destructor, stops the worker if shutdown() wasn't called. GL objects are left to the context.
+*	
+*/
+FrameCapture::~FrameCapture() {
+	if (worker.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+		}
+		wake.notify_one();
+		worker.join();
+	}
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <glad/glad.h>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "GLState.hpp"
+
+/*
+*	Screenshots (PNG) and session video (raw Y4M) without stalling the render thread. Frames are read
+*	back into a ring of pixel buffer objects, collected once their fence has signaled into one of a 
+*	fixed pool of frame buffers and handed to a worker thread, which does the encoding and the disk 
+*	writes. While the worker holds every frame buffer readbacks wait in the ring, if the ring is full 
+*	the frame is dropped and the next one stands in for it, so a slow disk costs frames instead of 
+*	memory and the video keeps real time. Jobs, paths and the worker's 
+*	messages live in fixed storage, so capturing never allocates on the render thread.
+*/
+class FrameCapture
+{
+public:
+	static const unsigned int SLOT_COUNT	= 3;
+	static const unsigned int FRAME_POOL_SIZE	= SLOT_COUNT + 2;
+	static const unsigned int VIDEO_FPS		= 60;
+	static const unsigned int JOB_CAPACITY	= FRAME_POOL_SIZE + 4;	// frame jobs are bounded by the pool
+	static const unsigned int MAX_MESSAGES	= 8;	// from the worker per frame, more are dropped
+	static const unsigned int MESSAGE_LENGTH	= 256;
+	static const unsigned int PATH_LENGTH	= 128;
+	FrameCapture();
+	void requestScreenshot(void);
+	void startRecording(void);
+	void stopRecording(void);
+	bool isRecording(void) const;
+	void capture(int width, int height, float time);
+	unsigned int getDroppedFrames(void) const;
+	void shutdown(void);
+	~FrameCapture();
+private:
+	enum JobType {
+		JOB_SCREENSHOT,
+		JOB_VIDEO_START,
+		JOB_VIDEO_FRAME,
+		JOB_VIDEO_END
+	};
+	struct Slot {
+		GLuint pbo;
+		GLsizeiptr capacity;
+		GLsync fence;
+		JobType type;
+		int width;
+		int height;
+		unsigned int repeat;
+	};
+	struct Job {
+		JobType type;
+		int width;
+		int height;
+		unsigned int repeat;
+		std::vector<unsigned char> *pixels;
+		char path[PATH_LENGTH];
+	};
+	Slot slots[SLOT_COUNT];
+	unsigned int firstPending;
+	unsigned int pendingCount;
+	bool screenshotRequested;
+	bool recording;
+	bool stopping;		// recording stopped, the last frames are still being read back
+	float nextVideoTime;
+	int videoWidth, videoHeight;
+	unsigned int droppedFrames;
+	unsigned int droppedTicks;		// video frames of dropped readbacks, added to the next one
+	unsigned int screenshotCount;
+	bool running;
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable frameReturned;
+	std::condition_variable jobTaken;
+	Job jobs[JOB_CAPACITY];				// ring, oldest at firstJob
+	unsigned int firstJob;
+	unsigned int jobCount;
+	std::vector<unsigned char> frames[FRAME_POOL_SIZE];
+	std::vector<std::vector<unsigned char>*> freeFrames;
+	char messages[MAX_MESSAGES][MESSAGE_LENGTH];
+	unsigned int messageCount;
+	std::ofstream video;
+	std::vector<unsigned char> videoFrame;
+	void collect(void);
+	void endVideo(void);
+	void returnFrame(std::vector<unsigned char> *frame);
+	void readback(JobType type, int width, int height, unsigned int repeat);
+	void pushJob(const Job &job);
+	void postMessage(const char *text, const char *path);
+	std::vector<unsigned char> *takeFrame(size_t size);
+	void workerLoop(void);
+	void writePNG(const Job &job);
+	void writeVideoFrame(const Job &job);
+	static Job makeJob(JobType type, int width, int height, unsigned int repeat, std::vector<unsigned char> *pixels);
+	static void timestamp(char *buffer, size_t size);
+	static unsigned int crc32(const unsigned char *data, size_t length, unsigned int crc);
+	static void writeChunk(std::ofstream &file, const char *type, const std::vector<unsigned char> &data);
+};
+
@@ -16,16 +16,9 @@ float quadVertices[] = { // vertex attributes for a quad that fills the entire s
 *	Constructor with arguments.
 *	
 */
-Framebuffer::Framebuffer(const int SCR_WIDTH, const int SCR_HEIGHT, const char *vertPath, const char *fragPath, const char *geomPath) {
-	glGenFramebuffers(1, &fboMSAAID);
-	bindMSAAFBO();
-	createMSAATexture(SCR_WIDTH, SCR_HEIGHT);
-	createMSAARBO(SCR_WIDTH, SCR_HEIGHT);
-	checkFBOStatus();
-	glGenFramebuffers(1, &fboID);
-	bindFBO();
-	createTexture(SCR_WIDTH, SCR_HEIGHT);
-	checkFBOStatus();
+Framebuffer::Framebuffer(const int SCR_WIDTH, const int SCR_HEIGHT, const char *vertPath, const char *fragPath, const char *geomPath) 
+	: width(SCR_WIDTH), height(SCR_HEIGHT), renderScale(1.0f) {
+	createTargets();
 	createScreenQuadVAO();
 	createScreenShader(
 		vertPath,
@@ -34,12 +27,130 @@ Framebuffer::Framebuffer(const int SCR_WIDTH, const int SCR_HEIGHT, const char *
 	);
 }
 
+/*
+*	Creates the multisampled render target and the resolve target at the current size.
+*	
+*/
+void Framebuffer::createTargets() {
+	glGenFramebuffers(1, &fboMSAAID);
+	bindMSAAFBO();
+	createMSAATexture(width, height);
+	createMSAARBO(width, height);
+	checkFBOStatus();
+	glGenFramebuffers(1, &fboID);
+	bindFBO();
+	createTexture(width, height);
+	checkFBOStatus();
+}
+
+/*
+*	Deletes the multisampled render target and the resolve target.
+*	
+*/
+void Framebuffer::deleteTargets() {
+	GLState::deleteFramebuffers(1, &fboMSAAID);
+	GLState::deleteTextures(1, &texMSAAID);
+	glDeleteRenderbuffers(1, &rboMSAAID);
+	GPUMemory::releaseRenderbuffer(rboMSAAID);
+	GLState::deleteFramebuffers(1, &fboID);
+	GLState::deleteTextures(1, &texID);
+}
+
+/*
+*	Reallocates all targets for a new window size. Pooled targets of the old size are freed, 
+*	the pool refills with the new size on demand.
+*/
+void Framebuffer::resize(const int SCR_WIDTH, const int SCR_HEIGHT) {
+	if (SCR_WIDTH <= 0 || SCR_HEIGHT <= 0 || (SCR_WIDTH == width && SCR_HEIGHT == height)) {
+		return;
+	}
+	width = SCR_WIDTH;
+	height = SCR_HEIGHT;
+	deleteTargets();
+	createTargets();
+	for (unsigned int i = 0; i < targetPool.size(); ) {
+		if (!targetPool[i].inUse && (targetPool[i].width != width || targetPool[i].height != height)) {
+			GLState::deleteFramebuffers(1, &targetPool[i].fboID);
+			GLState::deleteTextures(1, &targetPool[i].texID);
+			targetPool.erase(targetPool.begin() + i);
+		}
+		else {
+			i++;
+		}
+	}
+}
+
+/*
+*	Deletes all GL objects: the targets, the pooled targets and the screen quad. Has to be called 
+*	while the context exists, the framebuffer can't be used afterwards.
+*/
+void Framebuffer::release() {
+	deleteTargets();
+	for (unsigned int i = 0; i < targetPool.size(); i++) {
+		GLState::deleteFramebuffers(1, &targetPool[i].fboID);
+		GLState::deleteTextures(1, &targetPool[i].texID);
+	}
+	targetPool.clear();
+	GLState::deleteVertexArrays(1, &screenQuadVAO);
+	GLState::deleteBuffers(1, &screenQuadVBO);
+}
+
+/*
+*	Sets the fraction of the window resolution the scene is rendered at. The targets keep their 
+*	size, only the used region changes, so changing the scale every frame is free.
+*/
+void Framebuffer::setRenderScale(float scale) {
+	renderScale = scale < 0.1f ? 0.1f : (scale > 1.0f ? 1.0f : scale);
+}
+
+/*
+*	Returns the fraction of the window resolution the scene is rendered at.
+*	
+*/
+float Framebuffer::getRenderScale() const {
+	return renderScale;
+}
+
+/*
+*	Returns the output width.
+*	
+*/
+int Framebuffer::getWidth() const {
+	return width;
+}
+
+/*
+*	Returns the output height.
+*	
+*/
+int Framebuffer::getHeight() const {
+	return height;
+}
+
+/*
+*	Returns the width of the region the scene is rendered into, use it as the viewport.
+*	
+*/
+int Framebuffer::getRenderWidth() const {
+	int renderWidth = static_cast<int>(width * renderScale);
+	return renderWidth > 0 ? renderWidth : 1;
+}
+
+/*
+*	Returns the height of the region the scene is rendered into, use it as the viewport.
+*	
+*/
+int Framebuffer::getRenderHeight() const {
+	int renderHeight = static_cast<int>(height * renderScale);
+	return renderHeight > 0 ? renderHeight : 1;
+}
+
 /*
 *	Binds the framebuffer object.
 *	
 */
 void Framebuffer::bindFBO() {
-	glBindFramebuffer(GL_FRAMEBUFFER, fboID);
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, fboID);
 }
 
 /*
@@ -47,7 +158,7 @@ void Framebuffer::bindFBO() {
 *	
 */
 void Framebuffer::bindMSAAFBO() {
-	glBindFramebuffer(GL_FRAMEBUFFER, fboMSAAID);
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, fboMSAAID);
 }
 
 /*
@@ -60,14 +171,15 @@ void Framebuffer::createTexture(const int SCR_WIDTH, const int SCR_HEIGHT) {
 	glTexImage2D(
 			GL_TEXTURE_2D,
 			0,
-			GL_RGB, 
+			GL_RGBA8, 
 			SCR_WIDTH, 
 			SCR_HEIGHT, 
 			0, 
-			GL_RGB,
+			GL_RGBA,
 			GL_UNSIGNED_BYTE,
 			NULL
 	);
+	GPUMemory::trackTexture(texID, GPUMemory::textureSize(GL_RGBA8, SCR_WIDTH, SCR_HEIGHT), GPU_MEMORY_RENDER_TARGETS, "Framebuffer");
 	glTexParameteri(
 			GL_TEXTURE_2D,
 			GL_TEXTURE_MIN_FILTER,
@@ -78,7 +190,7 @@ void Framebuffer::createTexture(const int SCR_WIDTH, const int SCR_HEIGHT) {
 			GL_TEXTURE_MAG_FILTER,
 			GL_LINEAR
 	);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLState::bindTexture(0, GL_TEXTURE_2D, 0);
 	glFramebufferTexture2D(
 			GL_FRAMEBUFFER,	
 			GL_COLOR_ATTACHMENT0,
@@ -98,12 +210,13 @@ void Framebuffer::createMSAATexture(const int SCR_WIDTH, const int SCR_HEIGHT) {
 	glTexImage2DMultisample(
 		GL_TEXTURE_2D_MULTISAMPLE,
 		4,
-		GL_RGB,
+		GL_RGBA8,
 		SCR_WIDTH,
 		SCR_HEIGHT,
 		GL_TRUE
 	);
-	glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+	GPUMemory::trackTexture(texMSAAID, GPUMemory::textureSize(GL_RGBA8, SCR_WIDTH, SCR_HEIGHT, 4), GPU_MEMORY_RENDER_TARGETS, "Framebuffer");
+	GLState::bindTexture(0, GL_TEXTURE_2D_MULTISAMPLE, 0);
 	glFramebufferTexture2D(
 		GL_FRAMEBUFFER,
 		GL_COLOR_ATTACHMENT0,
@@ -118,7 +231,7 @@ void Framebuffer::createMSAATexture(const int SCR_WIDTH, const int SCR_HEIGHT) {
 *	
 */
 void Framebuffer::bindTexture() {
-	glBindTexture(GL_TEXTURE_2D, texID);
+	GLState::bindTexture(0, GL_TEXTURE_2D, texID);
 }
 
 /*
@@ -126,7 +239,7 @@ void Framebuffer::bindTexture() {
 *
 */
 void Framebuffer::bindMSAATexture() {
-	glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, texMSAAID);
+	GLState::bindTexture(0, GL_TEXTURE_2D_MULTISAMPLE, texMSAAID);
 }
 
 /*
@@ -142,6 +255,7 @@ void Framebuffer::createRBO(const int SCR_WIDTH, const int SCR_HEIGHT) {
 					SCR_WIDTH,
 					SCR_HEIGHT
 	);
+	GPUMemory::trackRenderbuffer(rboID, GPUMemory::textureSize(GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT), "Framebuffer");
 	glBindRenderbuffer(GL_RENDERBUFFER, 0);
 	glFramebufferRenderbuffer(
 		GL_FRAMEBUFFER,
@@ -165,6 +279,7 @@ void Framebuffer::createMSAARBO(const int SCR_WIDTH, const int SCR_HEIGHT) {
 							SCR_WIDTH,
 							SCR_HEIGHT
 	);
+	GPUMemory::trackRenderbuffer(rboMSAAID, GPUMemory::textureSize(GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT, 4), "Framebuffer");
 	glBindRenderbuffer(GL_RENDERBUFFER, 0);
 	glFramebufferRenderbuffer(
 							GL_FRAMEBUFFER,
@@ -200,7 +315,7 @@ void Framebuffer::checkFBOStatus() {
 		std::cerr << "ERROR::FRAMEBUFFER:: Framebuffer is not complete" << std::endl;
 		dev::error("ERROR::FRAMEBUFFER:: Framebuffer is not complete");
 	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 /*
@@ -218,6 +333,8 @@ void Framebuffer::createScreenQuadVAO() {
 		&quadVertices,
 		GL_STATIC_DRAW
 	);
+	RenderStats::countUpload(sizeof(quadVertices));
+	GPUMemory::trackBuffer(screenQuadVBO, sizeof(quadVertices), GPU_MEMORY_GEOMETRY, "Framebuffer");
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(
 					0,
@@ -242,7 +359,7 @@ void Framebuffer::createScreenQuadVAO() {
 *	
 */
 void Framebuffer::bindScreenQuadVAO() {
-	glBindVertexArray(screenQuadVAO);
+	GLState::bindVertexArray(screenQuadVAO);
 }
 
 /*
@@ -250,7 +367,7 @@ void Framebuffer::bindScreenQuadVAO() {
 *
 */
 void Framebuffer::bindScreenQuadVBO() {
-	glBindBuffer(GL_ARRAY_BUFFER, screenQuadVBO);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, screenQuadVBO);
 }
 
 /*
@@ -272,36 +389,234 @@ void Framebuffer::useShader() {
 }
 
 /*
-*	Draws the screen quad with the framebuffer texture.
-*	
+*	Draws the screen quad with the framebuffer texture. The quad covers the whole 
+*	screen, so the default framebuffer doesn't need to be cleared beforehand.
 */
 void Framebuffer::draw() {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glDisable(GL_DEPTH_TEST);
-	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT);
-	useShader();
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLState::disable(GL_DEPTH_TEST);
+	drawScreenQuad(screenShader, texID);
+}
+
+/*
+*	Draws a fullscreen quad into the currently bound framebuffer, sampling the given texture.
+*	
+*/
+void Framebuffer::drawScreenQuad(Shader *shader, unsigned int texture) {
+	shader->use();
 	bindScreenQuadVAO();
-	bindTexture();
+	GLState::bindTexture(0, GL_TEXTURE_2D, texture);
 	glDrawArrays(GL_TRIANGLES, 0, 6);
+	RenderStats::countDraw(GL_TRIANGLES, 6);
 }
 
 /*
-*	Blits the multisampled buffers to normal colorbuffer of fboID, image is stored in texID.
+*	Resolves the multisampled image and puts it on the screen. Without active effects 
+*	the MSAA buffer is resolved straight into the default framebuffer, otherwise the
+*	resolved image is run through the effect chain, ping-ponging between pooled targets.
+*	When rendering below window resolution the image is upscaled before the chain.
+*/
+void Framebuffer::present() {
+	bool scaled = getRenderWidth() != width || getRenderHeight() != height;
+	GLState::viewport(0, 0, width, height);
+	GLState::disable(GL_DEPTH_TEST);
+	if (!hasActiveEffects()) {
+		if (!scaled) {
+			GLState::bindFramebuffer(GL_READ_FRAMEBUFFER, fboMSAAID);
+		}
+		else {
+			blit();
+			GLState::bindFramebuffer(GL_READ_FRAMEBUFFER, fboID);
+		}
+		GLState::bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(
+			0,
+			0,
+			getRenderWidth(),
+			getRenderHeight(),
+			0,
+			0,
+			width,
+			height,
+			GL_COLOR_BUFFER_BIT,
+			scaled ? GL_LINEAR : GL_NEAREST
+		);
+		GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+		return;
+	}
+	blit();
+	unsigned int lastEffect = 0;
+	for (unsigned int i = 0; i < effects.size(); i++) {
+		if (effects[i].enabled) {
+			lastEffect = i;
+		}
+	}
+	unsigned int source = texID;
+	int sourceTarget = -1;
+	if (scaled) {
+		sourceTarget = acquireTarget(width, height);
+		GLState::bindFramebuffer(GL_READ_FRAMEBUFFER, fboID);
+		GLState::bindFramebuffer(GL_DRAW_FRAMEBUFFER, targetPool[sourceTarget].fboID);
+		glBlitFramebuffer(
+			0,
+			0,
+			getRenderWidth(),
+			getRenderHeight(),
+			0,
+			0,
+			width,
+			height,
+			GL_COLOR_BUFFER_BIT,
+			GL_LINEAR
+		);
+		source = targetPool[sourceTarget].texID;
+	}
+	for (unsigned int i = 0; i <= lastEffect; i++) {
+		if (!effects[i].enabled) {
+			continue;
+		}
+		int destTarget = -1;
+		if (i == lastEffect) {
+			GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+		}
+		else {
+			destTarget = acquireTarget(width, height);
+			GLState::bindFramebuffer(GL_FRAMEBUFFER, targetPool[destTarget].fboID);
+		}
+		drawScreenQuad(effects[i].shader, source);
+		if (sourceTarget >= 0) {
+			releaseTarget(sourceTarget);
+		}
+		if (destTarget >= 0) {
+			source = targetPool[destTarget].texID;
+		}
+		sourceTarget = destTarget;
+	}
+}
+
+/*
+*	Appends an effect to the end of the post-processing chain and returns its index.
+*	
+*/
+unsigned int Framebuffer::addEffect(const char *vertPath, const char *fragPath, bool enabled) {
+	PostEffect effect;
+	effect.shader = new Shader(vertPath, fragPath);
+	effect.enabled = enabled;
+	effect.shader->use();
+	effect.shader->setInt("screenTexture", 0);
+	effects.push_back(effect);
+	return static_cast<unsigned int>(effects.size() - 1);
+}
+
+/*
+*	Enables or disables an effect of the chain.
+*	
+*/
+void Framebuffer::setEffectEnabled(unsigned int effect, bool enabled) {
+	effects[effect].enabled = enabled;
+}
+
+/*
+*	Returns whether an effect of the chain is enabled.
+*	
+*/
+bool Framebuffer::isEffectEnabled(unsigned int effect) const {
+	return effects[effect].enabled;
+}
+
+/*
+*	Returns an effect's shader, e.g. to set its uniforms.
+*	
+*/
+Shader *Framebuffer::getEffectShader(unsigned int effect) {
+	return effects[effect].shader;
+}
+
+/*
+*	Returns true if at least one effect of the chain is enabled.
+*	
+*/
+bool Framebuffer::hasActiveEffects() const {
+	for (unsigned int i = 0; i < effects.size(); i++) {
+		if (effects[i].enabled) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+*	Returns a free pooled target of the given size, creating one if there is none.
 *	
 */
-void Framebuffer::blit(const int SCR_WIDTH, const int SCR_HEIGHT) {
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, fboMSAAID);
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fboID);
+int Framebuffer::acquireTarget(const int width, const int height) {
+	for (unsigned int i = 0; i < targetPool.size(); i++) {
+		if (!targetPool[i].inUse && targetPool[i].width == width && targetPool[i].height == height) {
+			targetPool[i].inUse = true;
+			return static_cast<int>(i);
+		}
+	}
+	RenderTarget target;
+	target.width = width;
+	target.height = height;
+	target.inUse = true;
+	glGenFramebuffers(1, &target.fboID);
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, target.fboID);
+	glGenTextures(1, &target.texID);
+	GLState::bindTexture(0, GL_TEXTURE_2D, target.texID);
+	glTexImage2D(
+		GL_TEXTURE_2D,
+		0,
+		GL_RGBA8,
+		width,
+		height,
+		0,
+		GL_RGBA,
+		GL_UNSIGNED_BYTE,
+		NULL
+	);
+	GPUMemory::trackTexture(target.texID, GPUMemory::textureSize(GL_RGBA8, width, height), GPU_MEMORY_RENDER_TARGETS, "Framebuffer target pool");
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	GLState::bindTexture(0, GL_TEXTURE_2D, 0);
+	glFramebufferTexture2D(
+		GL_FRAMEBUFFER,
+		GL_COLOR_ATTACHMENT0,
+		GL_TEXTURE_2D,
+		target.texID,
+		0
+	);
+	checkFBOStatus();
+	targetPool.push_back(target);
+	return static_cast<int>(targetPool.size() - 1);
+}
+
+/*
+*	Hands a pooled target back so the next effect can reuse it.
+*	
+*/
+void Framebuffer::releaseTarget(int target) {
+	targetPool[target].inUse = false;
+}
+
+/*
+*	Blits the multisampled buffers to normal colorbuffer of fboID, image is stored in texID.
+*	Only the rendered region is resolved.
+*/
+void Framebuffer::blit() {
+	GLState::bindFramebuffer(GL_READ_FRAMEBUFFER, fboMSAAID);
+	GLState::bindFramebuffer(GL_DRAW_FRAMEBUFFER, fboID);
 	glBlitFramebuffer(
 		0,
 		0,
-		SCR_WIDTH,
-		SCR_HEIGHT,
+		getRenderWidth(),
+		getRenderHeight(),
 		0,
 		0,
-		SCR_WIDTH,
-		SCR_HEIGHT,
+		getRenderWidth(),
+		getRenderHeight(),
 		GL_COLOR_BUFFER_BIT,
 		GL_NEAREST
 	);
@@ -313,4 +628,7 @@ void Framebuffer::blit(const int SCR_WIDTH, const int SCR_HEIGHT) {
 */
 Framebuffer::~Framebuffer() {
 	delete screenShader;
+	for (unsigned int i = 0; i < effects.size(); i++) {
+		delete effects[i].shader;
+	}
 }
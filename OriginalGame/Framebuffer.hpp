@@ -2,6 +2,7 @@
 #include <glad/glad.h>
 #include <iostream>
 #include <string>
+#include <vector>
 #include "Shader.hpp"
 
 namespace dev {
@@ -9,6 +10,27 @@ namespace dev {
 	void error(const std::string errorMsg);
 }
 
+/*
+*	A fullscreen effect of the post-processing chain, its shader samples "screenTexture".
+*	
+*/
+struct PostEffect {
+	Shader *shader;
+	bool enabled;
+};
+
+/*
+*	A pooled color target used for ping-ponging between post-processing effects.
+*	
+*/
+struct RenderTarget {
+	unsigned int fboID;
+	unsigned int texID;
+	int width;
+	int height;
+	bool inUse;
+};
+
 class Framebuffer
 {
 public:
@@ -23,16 +45,39 @@ public:
 	void bindScreenQuadVBO(void);
 	void useShader(void);
 	void draw(void);
-	void blit(const int SCR_WIDTH, const int SCR_HEIGHT);
+	void blit(void);
+	void present(void);
+	void resize(const int SCR_WIDTH, const int SCR_HEIGHT);
+	void setRenderScale(float scale);
+	float getRenderScale(void) const;
+	int getWidth(void) const;
+	int getHeight(void) const;
+	int getRenderWidth(void) const;
+	int getRenderHeight(void) const;
+	unsigned int addEffect(const char *vertPath, const char *fragPath, bool enabled = true);
+	void setEffectEnabled(unsigned int effect, bool enabled);
+	bool isEffectEnabled(unsigned int effect) const;
+	Shader *getEffectShader(unsigned int effect);
+	bool hasActiveEffects(void) const;
+	void release(void);
 	~Framebuffer();
 private:
 	unsigned int fboID, texID, rboID, screenQuadVAO, screenQuadVBO;
 	unsigned int fboMSAAID, texMSAAID, rboMSAAID;
+	int width, height;
+	float renderScale;
 	Shader *screenShader;
+	std::vector<PostEffect> effects;
+	std::vector<RenderTarget> targetPool;
+	int acquireTarget(const int width, const int height);
+	void releaseTarget(int target);
+	void drawScreenQuad(Shader *shader, unsigned int texture);
 	void createTexture(const int SCR_WIDTH, const int SCR_HEIGHT);
 	void createMSAATexture(const int SCR_WIDTH, const int SCR_HEIGHT);
 	void createRBO(const int SCR_WIDTH, const int SCR_HEIGHT);
 	void createMSAARBO(const int SCR_WIDTH, const int SCR_HEIGHT);
+	void createTargets(void);
+	void deleteTargets(void);
 	void createScreenQuadVAO(void);
 	void createScreenShader(const char *vertPath, const char *fragPath, const char *geomPath = nullptr);
 	void checkFBOStatus(void);
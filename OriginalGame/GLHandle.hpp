@@ -0,0 +1,74 @@
+#pragma once
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include "GLState.hpp"
+
+/*
+*	Move-only owner of a single GL object name, the object is deleted when the handle is destroyed
+*	or reassigned. Deletion is skipped once the context is gone (objects that outlive glfwTerminate 
+*	were freed together with the context). The Traits type supplies create() and destroy(name).
+*/
+template <typename Traits>
+class GLHandle
+{
+public:
+	GLHandle() : name(0) {}
+	explicit GLHandle(GLuint name) : name(name) {}
+	GLHandle(GLHandle &&other) : name(other.release()) {}
+	GLHandle &operator=(GLHandle &&other) {
+		if (this != &other) {
+			reset(other.release());
+		}
+		return *this;
+	}
+	GLHandle(const GLHandle&) = delete;
+	GLHandle &operator=(const GLHandle&) = delete;
+	~GLHandle() {
+		reset();
+	}
+	static GLHandle create(void) {
+		return GLHandle(Traits::create());
+	}
+	GLuint get(void) const {
+		return name;
+	}
+	GLuint release(void) {
+		GLuint old = name;
+		name = 0;
+		return old;
+	}
+	void reset(GLuint newName = 0) {
+		if (name != 0 && glfwGetCurrentContext() != NULL) {
+			Traits::destroy(name);
+		}
+		name = newName;
+	}
+private:
+	GLuint name;
+};
+
+struct VertexArrayTraits {
+	static GLuint create(void) { GLuint name; glGenVertexArrays(1, &name); return name; }
+	static void destroy(GLuint name) { GLState::deleteVertexArrays(1, &name); }
+};
+
+struct BufferTraits {
+	static GLuint create(void) { GLuint name; glGenBuffers(1, &name); return name; }
+	static void destroy(GLuint name) { GLState::deleteBuffers(1, &name); }
+};
+
+struct TextureTraits {
+	static GLuint create(void) { GLuint name; glGenTextures(1, &name); return name; }
+	static void destroy(GLuint name) { GLState::deleteTextures(1, &name); }
+};
+
+struct ProgramTraits {
+	static GLuint create(void) { return glCreateProgram(); }
+	static void destroy(GLuint name) { GLState::deleteProgram(name); }
+};
+
+typedef GLHandle<VertexArrayTraits>	VertexArrayHandle;
+typedef GLHandle<BufferTraits>		BufferHandle;
+typedef GLHandle<TextureTraits>		TextureHandle;
+typedef GLHandle<ProgramTraits>		ProgramHandle;
+
@@ -0,0 +1,348 @@
+#include "GLState.hpp"
+
+// marks a cached value as unknown, so the next call always goes through
+static const GLuint UNKNOWN					= 0xFFFFFFFF;
+static const unsigned int BUFFER_SLOTS		= 6;
+static const unsigned int TEXTURE_SLOTS		= 4;
+static const unsigned int CAP_SLOTS			= 5;
+
+static GLuint currentProgram				= UNKNOWN;
+static GLuint currentVAO					= UNKNOWN;
+static GLuint currentBuffers[BUFFER_SLOTS];
+static GLuint currentTextures[GLState::MAX_TEXTURE_UNITS][TEXTURE_SLOTS];
+static GLuint currentUnit					= UNKNOWN;
+static GLuint currentDrawFramebuffer		= UNKNOWN;
+static GLuint currentReadFramebuffer		= UNKNOWN;
+static GLuint currentCaps[CAP_SLOTS];
+static GLuint currentDepthFunc				= UNKNOWN;
+static GLuint currentDepthMask				= UNKNOWN;
+static GLuint currentColorMask				= UNKNOWN;
+static GLuint currentBlendSrc				= UNKNOWN;
+static GLuint currentBlendDst				= UNKNOWN;
+static GLint currentViewport[4]				= { -1, -1, -1, -1 };
+
+/*
+*	Binds a shader program.
+*	
+*/
+void GLState::useProgram(GLuint program) {
+	if (currentProgram != program) {
+		currentProgram = program;
+		glUseProgram(program);
+		RenderStats::countProgramBind();
+	}
+}
+
+/*
+*	Binds a vertex array object.
+*	
+*/
+void GLState::bindVertexArray(GLuint vao) {
+	if (currentVAO != vao) {
+		currentVAO = vao;
+		glBindVertexArray(vao);
+		RenderStats::countVAOBind();
+	}
+}
+
+/*
+*	Binds a buffer. GL_ELEMENT_ARRAY_BUFFER is part of the VAO state and therefore always passed through.
+*	
+*/
+void GLState::bindBuffer(GLenum target, GLuint buffer) {
+	int slot = bufferSlot(target);
+	if (slot < 0) {
+		glBindBuffer(target, buffer);
+		return;
+	}
+	if (currentBuffers[slot] != buffer) {
+		currentBuffers[slot] = buffer;
+		glBindBuffer(target, buffer);
+	}
+}
+
+/*
+*	Binds a texture to the given unit, the active unit is only switched when the binding actually changes.
+*	
+*/
+void GLState::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+	int slot = textureSlot(target);
+	if (slot >= 0 && unit < MAX_TEXTURE_UNITS && currentTextures[unit][slot] == texture) {
+		return;
+	}
+	if (currentUnit != unit) {
+		currentUnit = unit;
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+	if (slot >= 0 && unit < MAX_TEXTURE_UNITS) {
+		currentTextures[unit][slot] = texture;
+	}
+	glBindTexture(target, texture);
+	RenderStats::countTextureBind();
+}
+
+/*
+*	Binds a framebuffer, GL_FRAMEBUFFER sets both the draw and the read binding.
+*	
+*/
+void GLState::bindFramebuffer(GLenum target, GLuint framebuffer) {
+	bool draw = target != GL_READ_FRAMEBUFFER;
+	bool read = target != GL_DRAW_FRAMEBUFFER;
+	if ((!draw || currentDrawFramebuffer == framebuffer) && (!read || currentReadFramebuffer == framebuffer)) {
+		return;
+	}
+	if (draw) {
+		currentDrawFramebuffer = framebuffer;
+	}
+	if (read) {
+		currentReadFramebuffer = framebuffer;
+	}
+	glBindFramebuffer(target, framebuffer);
+}
+
+/*
+*	Enables a capability.
+*	
+*/
+void GLState::enable(GLenum cap) {
+	setCap(cap, true);
+}
+
+/*
+*	Disables a capability.
+*	
+*/
+void GLState::disable(GLenum cap) {
+	setCap(cap, false);
+}
+
+/*
+*	Sets the depth comparison function.
+*	
+*/
+void GLState::depthFunc(GLenum func) {
+	if (currentDepthFunc != func) {
+		currentDepthFunc = func;
+		glDepthFunc(func);
+	}
+}
+
+/*
+*	Enables or disables depth writes.
+*	
+*/
+void GLState::depthMask(GLboolean flag) {
+	if (currentDepthMask != flag) {
+		currentDepthMask = flag;
+		glDepthMask(flag);
+	}
+}
+
+/*
+*	Enables or disables writes to the color channels.
+*	
+*/
+void GLState::colorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha) {
+	GLuint mask = (red ? 1 : 0) | (green ? 2 : 0) | (blue ? 4 : 0) | (alpha ? 8 : 0);
+	if (currentColorMask != mask) {
+		currentColorMask = mask;
+		glColorMask(red, green, blue, alpha);
+	}
+}
+
+/*
+*	Sets the blend factors.
+*	
+*/
+void GLState::blendFunc(GLenum sfactor, GLenum dfactor) {
+	if (currentBlendSrc != sfactor || currentBlendDst != dfactor) {
+		currentBlendSrc = sfactor;
+		currentBlendDst = dfactor;
+		glBlendFunc(sfactor, dfactor);
+	}
+}
+
+/*
+*	Sets the viewport.
+*	
+*/
+void GLState::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+	if (currentViewport[0] != x || currentViewport[1] != y || currentViewport[2] != width || currentViewport[3] != height) {
+		currentViewport[0] = x;
+		currentViewport[1] = y;
+		currentViewport[2] = width;
+		currentViewport[3] = height;
+		glViewport(x, y, width, height);
+	}
+}
+
+/*
+*	Deletes buffers. GL unbinds deleted objects and may hand out their names again,
+*	so they have to be dropped from the cache as well.
+*/
+void GLState::deleteBuffers(GLsizei n, const GLuint *buffers) {
+	for (GLsizei i = 0; i < n; i++) {
+		for (unsigned int slot = 0; slot < BUFFER_SLOTS; slot++) {
+			if (currentBuffers[slot] == buffers[i]) {
+				currentBuffers[slot] = 0;
+			}
+		}
+		GPUMemory::releaseBuffer(buffers[i]);
+	}
+	glDeleteBuffers(n, buffers);
+}
+
+/*
+*	Deletes textures and drops them from the cache.
+*	
+*/
+void GLState::deleteTextures(GLsizei n, const GLuint *textures) {
+	for (GLsizei i = 0; i < n; i++) {
+		for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+			for (unsigned int slot = 0; slot < TEXTURE_SLOTS; slot++) {
+				if (currentTextures[unit][slot] == textures[i]) {
+					currentTextures[unit][slot] = 0;
+				}
+			}
+		}
+		GPUMemory::releaseTexture(textures[i]);
+	}
+	glDeleteTextures(n, textures);
+}
+
+/*
+*	Deletes vertex array objects and drops them from the cache.
+*	
+*/
+void GLState::deleteVertexArrays(GLsizei n, const GLuint *arrays) {
+	for (GLsizei i = 0; i < n; i++) {
+		if (currentVAO == arrays[i]) {
+			currentVAO = 0;
+		}
+	}
+	glDeleteVertexArrays(n, arrays);
+}
+
+/*
+*	Deletes framebuffers and drops them from the cache.
+*	
+*/
+void GLState::deleteFramebuffers(GLsizei n, const GLuint *framebuffers) {
+	for (GLsizei i = 0; i < n; i++) {
+		if (currentDrawFramebuffer == framebuffers[i]) {
+			currentDrawFramebuffer = 0;
+		}
+		if (currentReadFramebuffer == framebuffers[i]) {
+			currentReadFramebuffer = 0;
+		}
+	}
+	glDeleteFramebuffers(n, framebuffers);
+}
+
+/*
+*	Deletes a shader program and drops it from the cache.
+*	
+*/
+void GLState::deleteProgram(GLuint program) {
+	if (currentProgram == program) {
+		currentProgram = 0;
+	}
+	glDeleteProgram(program);
+}
+
+/*
+*	Forgets all cached state, e.g. after creating a context or after code that bypassed the cache.
+*	
+*/
+void GLState::invalidate() {
+	currentProgram = UNKNOWN;
+	currentVAO = UNKNOWN;
+	for (unsigned int slot = 0; slot < BUFFER_SLOTS; slot++) {
+		currentBuffers[slot] = UNKNOWN;
+	}
+	for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+		for (unsigned int slot = 0; slot < TEXTURE_SLOTS; slot++) {
+			currentTextures[unit][slot] = UNKNOWN;
+		}
+	}
+	currentUnit = UNKNOWN;
+	currentDrawFramebuffer = UNKNOWN;
+	currentReadFramebuffer = UNKNOWN;
+	for (unsigned int slot = 0; slot < CAP_SLOTS; slot++) {
+		currentCaps[slot] = UNKNOWN;
+	}
+	currentDepthFunc = UNKNOWN;
+	currentDepthMask = UNKNOWN;
+	currentColorMask = UNKNOWN;
+	currentBlendSrc = UNKNOWN;
+	currentBlendDst = UNKNOWN;
+	for (unsigned int i = 0; i < 4; i++) {
+		currentViewport[i] = -1;
+	}
+}
+
+/*
+*	Returns the cache slot of a buffer target, -1 for targets that aren't cached.
+*	
+*/
+int GLState::bufferSlot(GLenum target) {
+	switch (target) {
+	case GL_ARRAY_BUFFER:			return 0;
+	case GL_COPY_READ_BUFFER:		return 1;
+	case GL_COPY_WRITE_BUFFER:		return 2;
+	case GL_PIXEL_PACK_BUFFER:		return 3;
+	case GL_PIXEL_UNPACK_BUFFER:	return 4;
+	case GL_UNIFORM_BUFFER:			return 5;
+	default:						return -1;
+	}
+}
+
+/*
+*	Returns the cache slot of a texture target, -1 for targets that aren't cached.
+*	
+*/
+int GLState::textureSlot(GLenum target) {
+	switch (target) {
+	case GL_TEXTURE_2D:				return 0;
+	case GL_TEXTURE_2D_MULTISAMPLE:	return 1;
+	case GL_TEXTURE_CUBE_MAP:		return 2;
+	case GL_TEXTURE_BUFFER:			return 3;
+	default:						return -1;
+	}
+}
+
+/*
+*	Returns the cache slot of a capability, -1 for capabilities that aren't cached.
+*	
+*/
+int GLState::capSlot(GLenum cap) {
+	switch (cap) {
+	case GL_DEPTH_TEST:				return 0;
+	case GL_BLEND:					return 1;
+	case GL_CULL_FACE:				return 2;
+	case GL_MULTISAMPLE:			return 3;
+	case GL_SCISSOR_TEST:			return 4;
+	default:						return -1;
+	}
+}
+
+/*
+*	Enables or disables a capability if it isn't in that state already.
+*	
+*/
+void GLState::setCap(GLenum cap, bool enabled) {
+	int slot = capSlot(cap);
+	GLuint value = enabled ? 1 : 0;
+	if (slot >= 0 && currentCaps[slot] == value) {
+		return;
+	}
+	if (slot >= 0) {
+		currentCaps[slot] = value;
+	}
+	if (enabled) {
+		glEnable(cap);
+	}
+	else {
+		glDisable(cap);
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <glad/glad.h>
+#include "RenderStats.hpp"
+#include "GPUMemory.hpp"
+
+/*
+*	Thin cache in front of the GL state machine. All engine code binds programs, VAOs, buffers,
+*	textures and framebuffers and changes depth / blend state through here, so calls that wouldn't
+*	change anything never reach the driver. Everything not listed here is passed straight through.
+*/
+class GLState
+{
+public:
+	static const unsigned int MAX_TEXTURE_UNITS = 16;
+	static void useProgram(GLuint program);
+	static void bindVertexArray(GLuint vao);
+	static void bindBuffer(GLenum target, GLuint buffer);
+	static void bindTexture(GLuint unit, GLenum target, GLuint texture);
+	static void bindFramebuffer(GLenum target, GLuint framebuffer);
+	static void enable(GLenum cap);
+	static void disable(GLenum cap);
+	static void depthFunc(GLenum func);
+	static void depthMask(GLboolean flag);
+	static void colorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha);
+	static void blendFunc(GLenum sfactor, GLenum dfactor);
+	static void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+	static void deleteBuffers(GLsizei n, const GLuint *buffers);
+	static void deleteTextures(GLsizei n, const GLuint *textures);
+	static void deleteVertexArrays(GLsizei n, const GLuint *arrays);
+	static void deleteFramebuffers(GLsizei n, const GLuint *framebuffers);
+	static void deleteProgram(GLuint program);
+	static void invalidate(void);
+private:
+	static int bufferSlot(GLenum target);
+	static int textureSlot(GLenum target);
+	static int capSlot(GLenum cap);
+	static void setCap(GLenum cap, bool enabled);
+};
+
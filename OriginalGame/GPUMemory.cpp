@@ -0,0 +1,242 @@
+#include "GPUMemory.hpp"
+
+namespace dev {
+	void eventLog(const std::string eventMsg);
+}
+
+struct Allocation {
+	GPUMemoryCategory category;
+	GLsizeiptr bytes;
+	std::string owner;
+	unsigned long long serial;		// allocation order, compared against the baseline
+};
+
+static std::map<std::pair<int, GLuint>, Allocation> allocations;
+static unsigned long long current[GPU_MEMORY_CATEGORY_COUNT]	= { 0 };
+static unsigned long long peak[GPU_MEMORY_CATEGORY_COUNT]		= { 0 };
+static unsigned long long total									= 0;
+static unsigned long long totalPeak								= 0;
+static unsigned long long nextSerial							= 1;
+static unsigned long long baselineSerial						= 0;
+static bool releaseCPUCopies									= false;
+
+/*
+*	Records the storage of a texture, replacing a previous record for the same texture (e.g. after a resize).
+*	
+*/
+void GPUMemory::trackTexture(GLuint texture, GLsizeiptr bytes, GPUMemoryCategory category, const std::string &owner) {
+	track(OBJECT_TEXTURE, texture, bytes, category, owner);
+}
+
+/*
+*	Records the storage of a renderbuffer, renderbuffers always count as render targets.
+*	
+*/
+void GPUMemory::trackRenderbuffer(GLuint renderbuffer, GLsizeiptr bytes, const std::string &owner) {
+	track(OBJECT_RENDERBUFFER, renderbuffer, bytes, GPU_MEMORY_RENDER_TARGETS, owner);
+}
+
+/*
+*	Records the storage of a buffer object, replacing a previous record for the same buffer.
+*	
+*/
+void GPUMemory::trackBuffer(GLuint buffer, GLsizeiptr bytes, GPUMemoryCategory category, const std::string &owner) {
+	track(OBJECT_BUFFER, buffer, bytes, category, owner);
+}
+
+/*
+*	Removes the record of a deleted texture.
+*	
+*/
+void GPUMemory::releaseTexture(GLuint texture) {
+	release(OBJECT_TEXTURE, texture);
+}
+
+/*
+*	Removes the record of a deleted renderbuffer.
+*	
+*/
+void GPUMemory::releaseRenderbuffer(GLuint renderbuffer) {
+	release(OBJECT_RENDERBUFFER, renderbuffer);
+}
+
+/*
+*	Removes the record of a deleted buffer.
+*	
+*/
+void GPUMemory::releaseBuffer(GLuint buffer) {
+	release(OBJECT_BUFFER, buffer);
+}
+
+/*
+*	Estimates the storage of a texture or renderbuffer. Three channel formats are counted with four
+*	bytes per texel since drivers pad them, a full mipmap chain adds a third.
+*/
+GLsizeiptr GPUMemory::textureSize(GLenum format, GLsizei width, GLsizei height, GLsizei samples, bool mipmaps) {
+	GLsizeiptr bytesPerTexel;
+	switch (format) {
+	case GL_RED:
+	case GL_R8:
+		bytesPerTexel = 1;
+		break;
+	case GL_RG:
+	case GL_RG8:
+		bytesPerTexel = 2;
+		break;
+	case GL_RGBA16F:
+		bytesPerTexel = 8;
+		break;
+	case GL_RGBA32F:
+		bytesPerTexel = 16;
+		break;
+	default:
+		// RGB(A)8, depth and depth-stencil formats
+		bytesPerTexel = 4;
+		break;
+	}
+	GLsizeiptr bytes = static_cast<GLsizeiptr>(width) * height * bytesPerTexel * (samples > 1 ? samples : 1);
+	return mipmaps ? bytes + bytes / 3 : bytes;
+}
+
+/*
+*	Returns the bytes currently allocated in a category.
+*	
+*/
+unsigned long long GPUMemory::getCurrent(GPUMemoryCategory category) {
+	return current[category];
+}
+
+/*
+*	Returns the highest number of bytes ever allocated at once in a category.
+*	
+*/
+unsigned long long GPUMemory::getPeak(GPUMemoryCategory category) {
+	return peak[category];
+}
+
+/*
+*	Returns the bytes currently allocated over all categories.
+*	
+*/
+unsigned long long GPUMemory::getTotal() {
+	return total;
+}
+
+/*
+*	Returns the highest number of bytes ever allocated at once over all categories.
+*	
+*/
+unsigned long long GPUMemory::getTotalPeak() {
+	return totalPeak;
+}
+
+/*
+*	Returns the bytes currently allocated by an owner.
+*	
+*/
+unsigned long long GPUMemory::getOwnerUsage(const std::string &owner) {
+	unsigned long long bytes = 0;
+	for (std::map<std::pair<int, GLuint>, Allocation>::const_iterator it = allocations.begin(); it != allocations.end(); it++) {
+		if (it->second.owner == owner) {
+			bytes += it->second.bytes;
+		}
+	}
+	return bytes;
+}
+
+/*
+*	Returns a readable name for a category.
+*	
+*/
+const char *GPUMemory::getCategoryName(GPUMemoryCategory category) {
+	switch (category) {
+	case GPU_MEMORY_TEXTURES:		return "textures";
+	case GPU_MEMORY_RENDER_TARGETS:	return "render targets";
+	case GPU_MEMORY_GEOMETRY:		return "geometry";
+	case GPU_MEMORY_STREAMING:		return "streaming";
+	default:						return "unknown";
+	}
+}
+
+/*
+*	Everything allocated from now on is expected to be freed before shutdown, e.g. call it once
+*	the engine's own resources are set up and before the scenario loads its content.
+*/
+void GPUMemory::markBaseline() {
+	baselineSerial = nextSerial;
+}
+
+/*
+*	Logs every allocation made after the baseline that is still alive, grouped by owner, together with
+*	the usage per category. Returns the number of leaked allocations.
+*/
+unsigned int GPUMemory::reportLeaks() {
+	std::map<std::string, unsigned long long> leakedBytes;
+	unsigned int leaks = 0;
+	for (std::map<std::pair<int, GLuint>, Allocation>::const_iterator it = allocations.begin(); it != allocations.end(); it++) {
+		if (it->second.serial >= baselineSerial) {
+			leakedBytes[it->second.owner] += it->second.bytes;
+			leaks++;
+		}
+	}
+	for (unsigned int i = 0; i < GPU_MEMORY_CATEGORY_COUNT; i++) {
+		dev::eventLog(std::string("GPU memory ") + getCategoryName(static_cast<GPUMemoryCategory>(i)) + ": "
+			+ std::to_string(current[i] / 1024) + " KB at shutdown, peak " + std::to_string(peak[i] / 1024) + " KB");
+	}
+	for (std::map<std::string, unsigned long long>::const_iterator it = leakedBytes.begin(); it != leakedBytes.end(); it++) {
+		dev::eventLog("GPU memory leak: " + std::to_string(it->second / 1024) + " KB still allocated by " + it->first);
+	}
+	return leaks;
+}
+
+/*
+*	When set, meshes drop their CPU-side vertex and index copies once they are uploaded.
+*	
+*/
+void GPUMemory::setReleaseCPUCopies(bool release) {
+	releaseCPUCopies = release;
+}
+
+/*
+*	Returns true if meshes drop their CPU-side copies after upload.
+*	
+*/
+bool GPUMemory::getReleaseCPUCopies() {
+	return releaseCPUCopies;
+}
+
+/*
+*	Adds or replaces the record of an object and updates the counters.
+*	
+*/
+void GPUMemory::track(ObjectKind kind, GLuint object, GLsizeiptr bytes, GPUMemoryCategory category, const std::string &owner) {
+	release(kind, object);
+	Allocation allocation;
+	allocation.category = category;
+	allocation.bytes = bytes;
+	allocation.owner = owner;
+	allocation.serial = nextSerial++;
+	allocations[std::make_pair(static_cast<int>(kind), object)] = allocation;
+	current[category] += bytes;
+	total += bytes;
+	if (current[category] > peak[category]) {
+		peak[category] = current[category];
+	}
+	if (total > totalPeak) {
+		totalPeak = total;
+	}
+}
+
+/*
+*	Removes the record of an object, if there is one.
+*	
+*/
+void GPUMemory::release(ObjectKind kind, GLuint object) {
+	std::map<std::pair<int, GLuint>, Allocation>::iterator it = allocations.find(std::make_pair(static_cast<int>(kind), object));
+	if (it == allocations.end()) {
+		return;
+	}
+	current[it->second.category] -= it->second.bytes;
+	total -= it->second.bytes;
+	allocations.erase(it);
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <glad/glad.h>
+#include <map>
+#include <string>
+#include <utility>
+
+enum GPUMemoryCategory {
+	GPU_MEMORY_TEXTURES,
+	GPU_MEMORY_RENDER_TARGETS,
+	GPU_MEMORY_GEOMETRY,
+	GPU_MEMORY_STREAMING,
+	GPU_MEMORY_CATEGORY_COUNT
+};
+
+/*
+*	Accounting of GPU memory by category and owner. Every texture, renderbuffer and buffer allocation
+*	is recorded here with its (estimated) size, GLState's delete functions release the records again.
+*	Allocations made after markBaseline() that are still alive at shutdown are reported as leaks.
+*/
+class GPUMemory
+{
+public:
+	static void trackTexture(GLuint texture, GLsizeiptr bytes, GPUMemoryCategory category, const std::string &owner);
+	static void trackRenderbuffer(GLuint renderbuffer, GLsizeiptr bytes, const std::string &owner);
+	static void trackBuffer(GLuint buffer, GLsizeiptr bytes, GPUMemoryCategory category, const std::string &owner);
+	static void releaseTexture(GLuint texture);
+	static void releaseRenderbuffer(GLuint renderbuffer);
+	static void releaseBuffer(GLuint buffer);
+	static GLsizeiptr textureSize(GLenum format, GLsizei width, GLsizei height, GLsizei samples = 1, bool mipmaps = false);
+	static unsigned long long getCurrent(GPUMemoryCategory category);
+	static unsigned long long getPeak(GPUMemoryCategory category);
+	static unsigned long long getTotal(void);
+	static unsigned long long getTotalPeak(void);
+	static unsigned long long getOwnerUsage(const std::string &owner);
+	static const char *getCategoryName(GPUMemoryCategory category);
+	static void markBaseline(void);
+	static unsigned int reportLeaks(void);
+	static void setReleaseCPUCopies(bool release);
+	static bool getReleaseCPUCopies(void);
+private:
+	enum ObjectKind {
+		OBJECT_TEXTURE,
+		OBJECT_RENDERBUFFER,
+		OBJECT_BUFFER
+	};
+	static void track(ObjectKind kind, GLuint object, GLsizeiptr bytes, GPUMemoryCategory category, const std::string &owner);
+	static void release(ObjectKind kind, GLuint object);
+};
+
@@ -0,0 +1,64 @@
+#include "GPUTimer.hpp"
+
+/*
+*	Constructor.
+*	
+*/
+GPUTimer::GPUTimer() : writeIndex(0), readIndex(0), pending(0), running(false) {
+	glGenQueries(QUERY_COUNT, queries);
+}
+
+/*
+*	Starts timing the GPU commands issued from now on. Does nothing if all queries are still in flight.
+*	
+*/
+void GPUTimer::begin() {
+	if (pending == QUERY_COUNT) {
+		return;
+	}
+	glBeginQuery(GL_TIME_ELAPSED, queries[writeIndex]);
+	running = true;
+}
+
+/*
+*	Stops timing.
+*	
+*/
+void GPUTimer::end() {
+	if (!running) {
+		return;
+	}
+	glEndQuery(GL_TIME_ELAPSED);
+	running = false;
+	writeIndex = (writeIndex + 1) % QUERY_COUNT;
+	pending++;
+}
+
+/*
+*	Returns true and the measured time of the oldest finished query if one is available.
+*	
+*/
+bool GPUTimer::poll(float &milliseconds) {
+	if (pending == 0) {
+		return false;
+	}
+	GLint available = 0;
+	glGetQueryObjectiv(queries[readIndex], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) {
+		return false;
+	}
+	GLuint64 elapsed = 0;
+	glGetQueryObjectui64v(queries[readIndex], GL_QUERY_RESULT, &elapsed);
+	readIndex = (readIndex + 1) % QUERY_COUNT;
+	pending--;
+	milliseconds = static_cast<float>(elapsed) / 1000000.0f;
+	return true;
+}
+
+/*
+*	Destructor.
+*	
+*/
+GPUTimer::~GPUTimer() {
+	glDeleteQueries(QUERY_COUNT, queries);
+}
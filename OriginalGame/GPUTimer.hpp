@@ -0,0 +1,22 @@
+#pragma once
+#include <glad/glad.h>
+
+/*
+*	Measures GPU time with GL_TIME_ELAPSED queries. Queries are kept in a small ring and read back
+*	a few frames later, so polling the result never stalls the pipeline.
+*/
+class GPUTimer
+{
+public:
+	GPUTimer();
+	void begin(void);
+	void end(void);
+	bool poll(float &milliseconds);
+	~GPUTimer();
+private:
+	static const unsigned int QUERY_COUNT = 4;
+	unsigned int queries[QUERY_COUNT];
+	unsigned int writeIndex, readIndex, pending;
+	bool running;
+};
+
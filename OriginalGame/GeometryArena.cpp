@@ -0,0 +1,400 @@
+#include "GeometryArena.hpp"
+#include "Mesh.hpp"
+
+static GeometryArena *arena = nullptr;
+
+/*
+*	Returns the arena shared by all meshes, it is created on first use (which requires a current GL context).
+*
+*/
+GeometryArena &GeometryArena::get() {
+	if (arena == nullptr) {
+		arena = new GeometryArena(1 << 17, 1 << 19);
+	}
+	return *arena;
+}
+
+/*
+*	Releases the shared buffers, before the leak report and while the context is still current. 
+*	Ranges handed out before are invalid afterwards.
+*/
+void GeometryArena::shutdown() {
+	delete arena;
+	arena = nullptr;
+}
+
+/*
+*	Constructor, allocates the shared buffers with the given capacities (in vertices and indices).
+*
+*/
+GeometryArena::GeometryArena(GLuint vertexCapacity, GLuint indexCapacity)
+	: VAO(VertexArrayHandle::create()), vertexCapacity(vertexCapacity), indexCapacity(indexCapacity) {
+	VBO = growBuffer(BufferHandle(), 0, vertexCapacity * sizeof(Vertex));
+	EBO = growBuffer(BufferHandle(), 0, indexCapacity * sizeof(GLuint));
+	freeVertices.push_back({ 0, vertexCapacity });
+	freeIndices.push_back({ 0, indexCapacity });
+	setupVertexFormat();
+}
+
+/*
+*	Copies a mesh's vertices and indices into free regions of the shared buffers, growing them if needed.
+*
+*/
+GeometryRange GeometryArena::allocate(const Vertex *vertices, GLuint vertexCount, const GLuint *indices, GLuint indexCount) {
+	GeometryRange range;
+	GLuint vertexOffset, indexOffset;
+	if (!takeBlock(freeVertices, vertexCount, vertexOffset)) {
+		growVertices(vertexCapacity + vertexCount);
+		takeBlock(freeVertices, vertexCount, vertexOffset);
+	}
+	if (!takeBlock(freeIndices, indexCount, indexOffset)) {
+		growIndices(indexCapacity + indexCount);
+		takeBlock(freeIndices, indexCount, indexOffset);
+	}
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, VBO.get());
+	glBufferSubData(
+		GL_COPY_WRITE_BUFFER,
+		vertexOffset * sizeof(Vertex),
+		vertexCount * sizeof(Vertex),
+		vertices
+	);
+	RenderStats::countUpload(vertexCount * sizeof(Vertex));
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, EBO.get());
+	glBufferSubData(
+		GL_COPY_WRITE_BUFFER,
+		indexOffset * sizeof(GLuint),
+		indexCount * sizeof(GLuint),
+		indices
+	);
+	RenderStats::countUpload(indexCount * sizeof(GLuint));
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	range.baseVertex = static_cast<GLint>(vertexOffset);
+	range.vertexCount = vertexCount;
+	range.firstIndex = indexOffset;
+	range.indexCount = indexCount;
+	return range;
+}
+
+/*
+*	Copies an alternative index list for the vertices of base into the index buffer, e.g. a simplified 
+*	level of detail. The returned range owns no vertices, so freeing it only returns the indices.
+*/
+GeometryRange GeometryArena::allocateIndices(const GeometryRange &base, const GLuint *indices, GLuint indexCount) {
+	GeometryRange range;
+	GLuint indexOffset;
+	if (!takeBlock(freeIndices, indexCount, indexOffset)) {
+		growIndices(indexCapacity + indexCount);
+		takeBlock(freeIndices, indexCount, indexOffset);
+	}
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, EBO.get());
+	glBufferSubData(
+		GL_COPY_WRITE_BUFFER,
+		indexOffset * sizeof(GLuint),
+		indexCount * sizeof(GLuint),
+		indices
+	);
+	RenderStats::countUpload(indexCount * sizeof(GLuint));
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	range.baseVertex = base.baseVertex;
+	range.vertexCount = 0;
+	range.firstIndex = indexOffset;
+	range.indexCount = indexCount;
+	return range;
+}
+
+/*
+*	Returns a mesh's regions to the arena so later meshes can reuse them.
+*
+*/
+void GeometryArena::free(const GeometryRange &range) {
+	giveBlock(freeVertices, static_cast<GLuint>(range.baseVertex), range.vertexCount);
+	giveBlock(freeIndices, range.firstIndex, range.indexCount);
+}
+
+/*
+*	Binds the VAO shared by all meshes in the arena.
+*
+*/
+void GeometryArena::bindVAO() {
+	GLState::bindVertexArray(VAO.get());
+}
+
+/*
+*	Draws a single mesh with a base-vertex draw.
+*
+*/
+void GeometryArena::draw(const GeometryRange &range) {
+	bindVAO();
+	glDrawElementsBaseVertex(
+		GL_TRIANGLES,
+		range.indexCount,
+		GL_UNSIGNED_INT,
+		(void*)(range.firstIndex * sizeof(GLuint)),
+		range.baseVertex
+	);
+	RenderStats::countDraw(GL_TRIANGLES, range.indexCount);
+}
+
+/*
+*	Draws several meshes with a single call, they all have to use the same textures and model matrix.
+*
+*/
+void GeometryArena::multiDraw(const GeometryRange *ranges, GLsizei count) {
+	multiCounts.resize(count);
+	multiOffsets.resize(count);
+	multiBaseVertices.resize(count);
+	for (GLsizei i = 0; i < count; i++) {
+		multiCounts[i] = ranges[i].indexCount;
+		multiOffsets[i] = (void*)(ranges[i].firstIndex * sizeof(GLuint));
+		multiBaseVertices[i] = ranges[i].baseVertex;
+	}
+	bindVAO();
+	glMultiDrawElementsBaseVertex(
+		GL_TRIANGLES,
+		&multiCounts[0],
+		GL_UNSIGNED_INT,
+		&multiOffsets[0],
+		count,
+		&multiBaseVertices[0]
+	);
+	RenderStats::countMultiDraw(GL_TRIANGLES, &multiCounts[0], count);
+}
+
+/*
+*	Points the instance matrix attribute (locations 5 to 8) at tightly packed matrices starting at 
+*	offset in buffer, for the INSTANCING shader variants. With a paletteOffset the per instance 
+*	palette offsets (location 11) are read from there too, for the INSTANCING | SKINNING variants.
+*/
+void GeometryArena::bindInstances(GLuint buffer, GLintptr offset, GLintptr paletteOffset) {
+	bindVAO();
+	GLState::bindBuffer(GL_ARRAY_BUFFER, buffer);
+	for (GLuint i = 0; i < 4; i++) {
+		glEnableVertexAttribArray(5 + i);
+		glVertexAttribPointer(
+			5 + i,
+			4,
+			GL_FLOAT,
+			GL_FALSE,
+			sizeof(glm::mat4),
+			(void*)(offset + i * sizeof(glm::vec4))
+		);
+		glVertexAttribDivisor(5 + i, 1);
+	}
+	if (paletteOffset >= 0) {
+		glEnableVertexAttribArray(11);
+		glVertexAttribIPointer(11, 1, GL_INT, sizeof(GLint), (void*)paletteOffset);
+		glVertexAttribDivisor(11, 1);
+	}
+	else {
+		glDisableVertexAttribArray(11);
+	}
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/*
+*	Draws instanceCount instances of a mesh, each with the matrix bindInstances points at.
+*
+*/
+void GeometryArena::drawInstanced(const GeometryRange &range, GLsizei instanceCount) {
+	bindVAO();
+	glDrawElementsInstancedBaseVertex(
+		GL_TRIANGLES,
+		range.indexCount,
+		GL_UNSIGNED_INT,
+		(void*)(range.firstIndex * sizeof(GLuint)),
+		instanceCount,
+		range.baseVertex
+	);
+	RenderStats::countDraw(GL_TRIANGLES, range.indexCount, instanceCount);
+}
+
+/*
+*	Returns the capacity of the vertex buffer in vertices.
+*
+*/
+GLuint GeometryArena::getVertexCapacity() const {
+	return vertexCapacity;
+}
+
+/*
+*	Returns the capacity of the index buffer in indices.
+*
+*/
+GLuint GeometryArena::getIndexCapacity() const {
+	return indexCapacity;
+}
+
+/*
+*	Points the VAO's attributes and element buffer at the current shared buffers.
+*
+*/
+void GeometryArena::setupVertexFormat() {
+	GLState::bindVertexArray(VAO.get());
+	GLState::bindBuffer(GL_ARRAY_BUFFER, VBO.get());
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO.get());
+
+	// vertex positions
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(
+		0,
+		3,
+		GL_FLOAT,
+		GL_FALSE,
+		sizeof(Vertex),
+		(void*)0
+	);
+
+	// vertex normals
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(
+		1,
+		3,
+		GL_FLOAT,
+		GL_FALSE,
+		sizeof(Vertex),
+		(void*)offsetof(Vertex, normal)
+	);
+
+	// vertex texture coordinates
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(
+		2,
+		2,
+		GL_FLOAT,
+		GL_FALSE,
+		sizeof(Vertex),
+		(void*)offsetof(Vertex, texCoords)
+	);
+
+	// vertex tangent
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(
+		3,
+		3,
+		GL_FLOAT,
+		GL_FALSE,
+		sizeof(Vertex),
+		(void*)offsetof(Vertex, tangent)
+	);
+
+	// vertex bitangent
+	glEnableVertexAttribArray(4);
+	glVertexAttribPointer(
+		4,
+		3,
+		GL_FLOAT,
+		GL_FALSE,
+		sizeof(Vertex),
+		(void*)offsetof(Vertex, bitangent)
+	);
+
+	// bone indices and weights, after the instance matrix at locations 5 to 8 and before the 
+	// instance palette offset at 11
+	glEnableVertexAttribArray(9);
+	glVertexAttribIPointer(
+		9,
+		MAX_BONE_INFLUENCES,
+		GL_UNSIGNED_BYTE,
+		sizeof(Vertex),
+		(void*)offsetof(Vertex, boneIDs)
+	);
+	glEnableVertexAttribArray(10);
+	glVertexAttribPointer(
+		10,
+		MAX_BONE_INFLUENCES,
+		GL_FLOAT,
+		GL_FALSE,
+		sizeof(Vertex),
+		(void*)offsetof(Vertex, boneWeights)
+	);
+
+	GLState::bindVertexArray(0);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/*
+*	Grows the vertex buffer to at least minCapacity vertices and adds the new space to the free list.
+*
+*/
+void GeometryArena::growVertices(GLuint minCapacity) {
+	GLuint newCapacity = vertexCapacity * 2 > minCapacity ? vertexCapacity * 2 : minCapacity;
+	VBO = growBuffer(VBO, vertexCapacity * sizeof(Vertex), newCapacity * sizeof(Vertex));
+	giveBlock(freeVertices, vertexCapacity, newCapacity - vertexCapacity);
+	vertexCapacity = newCapacity;
+	setupVertexFormat();
+	dev::eventLog("Geometry arena vertex buffer grown to " + std::to_string(vertexCapacity) + " vertices");
+}
+
+/*
+*	Grows the index buffer to at least minCapacity indices and adds the new space to the free list.
+*
+*/
+void GeometryArena::growIndices(GLuint minCapacity) {
+	GLuint newCapacity = indexCapacity * 2 > minCapacity ? indexCapacity * 2 : minCapacity;
+	EBO = growBuffer(EBO, indexCapacity * sizeof(GLuint), newCapacity * sizeof(GLuint));
+	giveBlock(freeIndices, indexCapacity, newCapacity - indexCapacity);
+	indexCapacity = newCapacity;
+	setupVertexFormat();
+	dev::eventLog("Geometry arena index buffer grown to " + std::to_string(indexCapacity) + " indices");
+}
+
+/*
+*	Takes size elements from the first free block that is large enough.
+*
+*/
+bool GeometryArena::takeBlock(std::vector<Block> &blocks, GLuint size, GLuint &offset) {
+	for (unsigned int i = 0; i < blocks.size(); i++) {
+		if (blocks[i].size >= size) {
+			offset = blocks[i].offset;
+			blocks[i].offset += size;
+			blocks[i].size -= size;
+			if (blocks[i].size == 0) {
+				blocks.erase(blocks.begin() + i);
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+*	Returns a region to the free list, which is kept sorted by offset and merged with its neighbours.
+*
+*/
+void GeometryArena::giveBlock(std::vector<Block> &blocks, GLuint offset, GLuint size) {
+	if (size == 0) {
+		return;
+	}
+	unsigned int i = 0;
+	while (i < blocks.size() && blocks[i].offset < offset) {
+		i++;
+	}
+	blocks.insert(blocks.begin() + i, { offset, size });
+	if (i + 1 < blocks.size() && blocks[i].offset + blocks[i].size == blocks[i + 1].offset) {
+		blocks[i].size += blocks[i + 1].size;
+		blocks.erase(blocks.begin() + i + 1);
+	}
+	if (i > 0 && blocks[i - 1].offset + blocks[i - 1].size == blocks[i].offset) {
+		blocks[i - 1].size += blocks[i].size;
+		blocks.erase(blocks.begin() + i);
+	}
+}
+
+/*
+*	Creates a buffer of newSize bytes and copies the first oldSize bytes of the old buffer into it.
+*	Uses the copy targets so the currently bound VAO is left untouched. Assigning the result over 
+*	the old handle deletes the old buffer.
+*/
+BufferHandle GeometryArena::growBuffer(const BufferHandle &buffer, GLsizeiptr oldSize, GLsizeiptr newSize) {
+	BufferHandle newBuffer = BufferHandle::create();
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, newBuffer.get());
+	glBufferData(GL_COPY_WRITE_BUFFER, newSize, NULL, GL_STATIC_DRAW);
+	GPUMemory::trackBuffer(newBuffer.get(), newSize, GPU_MEMORY_GEOMETRY, "Geometry arena");
+	if (buffer.get() != 0) {
+		GLState::bindBuffer(GL_COPY_READ_BUFFER, buffer.get());
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+		GLState::bindBuffer(GL_COPY_READ_BUFFER, 0);
+	}
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	return newBuffer;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <glad/glad.h>
+#include <vector>
+#include "GLState.hpp"
+#include "GLHandle.hpp"
+
+struct Vertex;
+
+/*
+*	Location of a mesh inside the arena's shared buffers. Indices stay relative to the
+*	mesh's own vertices, baseVertex is added by glDrawElementsBaseVertex.
+*/
+struct GeometryRange {
+	GLint baseVertex;
+	GLuint vertexCount;
+	GLuint firstIndex;
+	GLuint indexCount;
+};
+
+/*
+*	Suballocates the geometry of all static meshes from one large vertex and one large
+*	index buffer, which share a single VAO for the Vertex format. Meshes are drawn with
+*	base-vertex draws, so loading a model never has to create new GL objects.
+*/
+class GeometryArena
+{
+public:
+	static GeometryArena &get(void);
+	static void shutdown(void);
+	GeometryRange allocate(const Vertex *vertices, GLuint vertexCount, const GLuint *indices, GLuint indexCount);
+	GeometryRange allocateIndices(const GeometryRange &base, const GLuint *indices, GLuint indexCount);
+	void free(const GeometryRange &range);
+	void bindVAO(void);
+	void draw(const GeometryRange &range);
+	void multiDraw(const GeometryRange *ranges, GLsizei count);
+	void bindInstances(GLuint buffer, GLintptr offset, GLintptr paletteOffset = -1);
+	void drawInstanced(const GeometryRange &range, GLsizei instanceCount);
+	GLuint getVertexCapacity(void) const;
+	GLuint getIndexCapacity(void) const;
+private:
+	struct Block {
+		GLuint offset;
+		GLuint size;
+	};
+	VertexArrayHandle VAO;
+	BufferHandle VBO, EBO;
+	GLuint vertexCapacity, indexCapacity;
+	std::vector<Block> freeVertices, freeIndices;
+	std::vector<GLsizei> multiCounts;
+	std::vector<const void*> multiOffsets;
+	std::vector<GLint> multiBaseVertices;
+	GeometryArena(GLuint vertexCapacity, GLuint indexCapacity);
+	GeometryArena(const GeometryArena&) = delete;
+	GeometryArena &operator=(const GeometryArena&) = delete;
+	void setupVertexFormat(void);
+	void growVertices(GLuint minCapacity);
+	void growIndices(GLuint minCapacity);
+	static bool takeBlock(std::vector<Block> &blocks, GLuint size, GLuint &offset);
+	static void giveBlock(std::vector<Block> &blocks, GLuint offset, GLuint size);
+	static BufferHandle growBuffer(const BufferHandle &buffer, GLsizeiptr oldSize, GLsizeiptr newSize);
+};
+
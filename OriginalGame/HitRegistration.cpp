@@ -0,0 +1,217 @@
+#include "HitRegistration.hpp"
+#include <cmath>
+
+static const float RANGE		= 100.0f;	// how far shots can hit the static scene
+
+/*
+*	Constructor, center and radius give each target's bounding sphere relative to its position.
+*	
+*/
+HitRegistration::HitRegistration(const glm::vec3 &center, float radius) 
+	: center(center), radius(radius), shape(nullptr), scene(nullptr), newest(0), recorded(0), pendingCount(0), shots(0), hits(0) {
+	for (unsigned int i = 0; i < HISTORY_SIZE; i++) {
+		history[i].time = 0.0;
+		history[i].count = 0;
+	}
+	results.reserve(MAX_SHOTS);
+}
+
+/*
+*	Makes shots hit the targets' triangles instead of their spheres. base places the shape relative 
+*	to a target's position, like the instance transform without the translation.
+*/
+void HitRegistration::setShape(const TriangleBVH *shape, const glm::mat4 &base) {
+	this->shape = shape;
+	this->base = base;
+	toShape = glm::inverse(base);
+}
+
+/*
+*	Sets the static scene's triangles in world space, shots stop at them.
+*	
+*/
+void HitRegistration::setScene(const TriangleBVH *scene) {
+	this->scene = scene;
+}
+
+/*
+*	Stores the target positions rendered at time, overwriting the oldest frame. The snapshot's 
+*	arrays only grow when targets are added, so recording doesn't allocate in a steady state.
+*/
+void HitRegistration::record(double time, const TargetMotion &motion) {
+	newest = (newest + 1) % HISTORY_SIZE;
+	recorded = recorded < HISTORY_SIZE ? recorded + 1 : HISTORY_SIZE;
+	Snapshot &snapshot = history[newest];
+	snapshot.time = time;
+	snapshot.count = motion.getCount();
+	if (snapshot.x.size() < snapshot.count) {
+		snapshot.x.resize(snapshot.count);
+		snapshot.y.resize(snapshot.count);
+		snapshot.z.resize(snapshot.count);
+	}
+	if (snapshot.count > 0) {
+		motion.interpolate(&snapshot.x[0], &snapshot.y[0], &snapshot.z[0]);
+	}
+}
+
+/*
+*	Queues a shot fired at time (the input event's, not the frame's) along direction, which has 
+*	to be normalized. Returns false if too many shots are pending.
+*/
+bool HitRegistration::fire(double time, const glm::vec3 &origin, const glm::vec3 &direction) {
+	if (pendingCount == MAX_SHOTS) {
+		return false;
+	}
+	Shot &shot = pending[pendingCount++];
+	shot.time = time;
+	shot.origin = origin;
+	shot.direction = direction;
+	return true;
+}
+
+/*
+*	Evaluates all shots fired up to the newest recorded frame, the results stay available until 
+*	the next call. Later shots wait for the frame that follows them.
+*/
+void HitRegistration::resolve() {
+	results.clear();
+	if (recorded == 0) {
+		return;
+	}
+	unsigned int kept = 0;
+	for (unsigned int i = 0; i < pendingCount; i++) {
+		if (pending[i].time > history[newest].time) {
+			pending[kept++] = pending[i];
+			continue;
+		}
+		ShotResult result = evaluate(pending[i]);
+		results.push_back(result);
+		shots++;
+		if (result.target >= 0) {
+			hits++;
+		}
+	}
+	pendingCount = kept;
+}
+
+/*
+*	Returns the number of shots evaluated by the last resolve().
+*	
+*/
+unsigned int HitRegistration::getResultCount() const {
+	return static_cast<unsigned int>(results.size());
+}
+
+/*
+*	Returns a shot evaluated by the last resolve().
+*	
+*/
+const ShotResult &HitRegistration::getResult(unsigned int i) const {
+	return results[i];
+}
+
+/*
+*	Returns the number of shots evaluated so far.
+*	
+*/
+unsigned int HitRegistration::getShots() const {
+	return shots;
+}
+
+/*
+*	Returns the number of shots that hit a target so far.
+*	
+*/
+unsigned int HitRegistration::getHits() const {
+	return hits;
+}
+
+/*
+*	Finds the frames around the shot's time, interpolates every target between them and returns 
+*	the nearest target the shot's ray hits. Rays through a sphere are traced against the shape in 
+*	model space. Shots older than the history are evaluated against its oldest frame.
+*/
+ShotResult HitRegistration::evaluate(const Shot &shot) const {
+	const Snapshot *after = &history[newest];
+	const Snapshot *before = after;
+	for (unsigned int i = 1; i < recorded; i++) {
+		const Snapshot *older = &history[(newest + HISTORY_SIZE - i) % HISTORY_SIZE];
+		before = older;
+		if (older->time <= shot.time) {
+			break;
+		}
+		after = older;
+	}
+	float t = 0.0f;
+	if (after->time > before->time && shot.time > before->time) {
+		t = static_cast<float>((shot.time - before->time) / (after->time - before->time));
+		t = t < 1.0f ? t : 1.0f;
+	}
+	unsigned int count = before->count < after->count ? before->count : after->count;
+
+	ShotResult result = { shot.time, -1, false, 0.0f, glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f) };
+	if (scene != nullptr) {
+		float fraction = 1.0f;
+		glm::vec3 normal;
+		if (scene->sweep(shot.origin, shot.direction * RANGE, 0.0f, fraction, normal)) {
+			result.struck = true;
+			result.distance = fraction * RANGE;
+			result.normal = normal;
+		}
+	}
+	glm::vec3 hitCenter;
+	float radiusSquared = radius * radius;
+	for (unsigned int i = 0; i < count; i++) {
+		glm::vec3 position(
+			before->x[i] + (after->x[i] - before->x[i]) * t,
+			before->y[i] + (after->y[i] - before->y[i]) * t,
+			before->z[i] + (after->z[i] - before->z[i]) * t
+		);
+		glm::vec3 offset = position + center - shot.origin;
+		float along = glm::dot(offset, shot.direction);
+		float missSquared = glm::dot(offset, offset) - along * along;
+		if (missSquared > radiusSquared) {
+			continue;
+		}
+		float half = std::sqrt(radiusSquared - missSquared);
+		float distance = along - half;
+		if (distance < 0.0f) {
+			// the shot starts inside the sphere
+			distance = 0.0f;
+			if (along + half < 0.0f) {
+				continue;
+			}
+		}
+		if (result.struck && distance >= result.distance) {
+			continue;
+		}
+		glm::vec3 normal;
+		if (shape != nullptr) {
+			// trace up to where the ray leaves the sphere or reaches the nearest hit so far
+			float exit = along + half;
+			float fraction = result.struck && result.distance < exit ? result.distance / exit : 1.0f;
+			glm::vec3 start = glm::vec3(toShape * glm::vec4(shot.origin - position, 1.0f));
+			glm::vec3 segment = glm::vec3(toShape * glm::vec4(shot.direction * exit, 0.0f));
+			if (!shape->sweep(start, segment, 0.0f, fraction, normal)) {
+				continue;
+			}
+			distance = fraction * exit;
+			normal = glm::normalize(glm::vec3(base * glm::vec4(normal, 0.0f)));
+		}
+		else {
+			glm::vec3 offset = shot.origin + shot.direction * distance - (position + center);
+			float length = glm::length(offset);
+			normal = length > 0.0f ? offset / length : -shot.direction;
+		}
+		result.target = static_cast<int>(i);
+		result.struck = true;
+		result.distance = distance;
+		result.normal = normal;
+		hitCenter = position + center;
+	}
+	result.position = shot.origin + shot.direction * result.distance;
+	if (result.target >= 0) {
+		result.offset = result.position - hitCenter;
+	}
+	return result;
+}
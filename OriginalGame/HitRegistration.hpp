@@ -0,0 +1,71 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include "TargetMotion.hpp"
+#include "TriangleBVH.hpp"
+
+/*
+*	Outcome of a shot, target is the index of the hit target in TargetMotion::interpolate order 
+*	or -1 for a miss. struck tells whether it hit a target or the static scene at all, position is 
+*	where at the shot's time and offset a target hit relative to the center of the target's sphere.
+*/
+struct ShotResult {
+	double time;
+	int target;
+	bool struck;
+	float distance;
+	glm::vec3 position;
+	glm::vec3 offset;
+	glm::vec3 normal;
+};
+
+/*
+*	Resolves shots against the targets as they were on screen when the shot was fired instead of 
+*	as they are when it is processed. Every frame records the rendered target positions into a ring 
+*	buffer, a shot is tested against the positions interpolated to its timestamp, from the camera 
+*	position and direction at that moment. Targets are found by their bounding spheres and, once a 
+*	shape is set, hit by its triangles. The static scene stops shots before they reach targets.
+*/
+class HitRegistration
+{
+public:
+	static const unsigned int HISTORY_SIZE	= 32;	// frames, about 200 ms at 144 FPS
+	static const unsigned int MAX_SHOTS		= 64;	// pending shots, more in a single frame are dropped
+	HitRegistration(const glm::vec3 &center, float radius);
+	void setShape(const TriangleBVH *shape, const glm::mat4 &base);
+	void setScene(const TriangleBVH *scene);
+	void record(double time, const TargetMotion &motion);
+	bool fire(double time, const glm::vec3 &origin, const glm::vec3 &direction);
+	void resolve(void);
+	unsigned int getResultCount(void) const;
+	const ShotResult &getResult(unsigned int i) const;
+	unsigned int getShots(void) const;
+	unsigned int getHits(void) const;
+private:
+	struct Snapshot {
+		double time;
+		unsigned int count;
+		std::vector<float> x, y, z;
+	};
+	struct Shot {
+		double time;
+		glm::vec3 origin;
+		glm::vec3 direction;
+	};
+	glm::vec3 center;
+	float radius;
+	const TriangleBVH *shape;		// shared by all targets, null to hit their spheres
+	glm::mat4 base;					// model space to the offset from a target's position
+	glm::mat4 toShape;
+	const TriangleBVH *scene;		// world space, may be null
+	Snapshot history[HISTORY_SIZE];
+	unsigned int newest;
+	unsigned int recorded;
+	Shot pending[MAX_SHOTS];
+	unsigned int pendingCount;
+	std::vector<ShotResult> results;
+	unsigned int shots;
+	unsigned int hits;
+	ShotResult evaluate(const Shot &shot) const;
+};
+
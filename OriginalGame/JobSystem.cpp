@@ -0,0 +1,271 @@
+#include "JobSystem.hpp"
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+/*
+*	Job deque of one thread, a fixed ring so queueing never allocates. The owner works at the 
+*	back, thieves take from the front.
+*/
+struct JobQueue {
+	std::mutex mutex;
+	Job jobs[JobSystem::QUEUE_CAPACITY];
+	unsigned int head;
+	unsigned int count;
+	JobQueue() : head(0), count(0) {}
+};
+
+static const unsigned int MAX_THREADS		= 64;
+static JobQueue *queues						= nullptr;
+static unsigned int threadCount				= 1;	// workers plus the main thread
+static std::vector<std::thread> workers;
+static std::atomic<unsigned int> queuedJobs(0);
+static std::atomic<bool> running(false);
+static std::mutex sleepMutex;
+static std::condition_variable wake;
+static thread_local int threadIndex			= -1;	// own queue, 0 is the main thread's
+
+/*
+*	Constructor.
+*	
+*/
+JobCounter::JobCounter() : pending(0), dependentCount(0) {
+
+}
+
+/*
+*	Returns true once every job counted here has finished.
+*	
+*/
+bool JobCounter::isDone() const {
+	return pending.load() == 0;
+}
+
+/*
+*	Starts the workers, by default one per core besides the calling thread, which becomes the 
+*	main thread of the scheduler.
+*/
+void JobSystem::init(unsigned int workerCount) {
+	if (running) {
+		return;
+	}
+	if (workerCount == 0) {
+		unsigned int cores = std::thread::hardware_concurrency();
+		workerCount = cores > 1 ? cores - 1 : 1;
+	}
+	if (workerCount > MAX_THREADS - 1) {
+		workerCount = MAX_THREADS - 1;
+	}
+	threadCount = workerCount + 1;
+	queues = new JobQueue[threadCount];
+	threadIndex = 0;
+	running = true;
+	for (unsigned int i = 1; i < threadCount; i++) {
+		workers.push_back(std::thread(&JobSystem::workerLoop, i));
+	}
+}
+
+/*
+*	Lets the workers finish the queued jobs and joins them.
+*	
+*/
+void JobSystem::shutdown() {
+	if (!running) {
+		return;
+	}
+	while (help()) {
+
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running = false;
+	}
+	wake.notify_all();
+	for (unsigned int i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+	workers.clear();
+	delete[] queues;
+	queues = nullptr;
+	threadCount = 1;
+}
+
+/*
+*	Returns the number of threads jobs run on, including the main thread.
+*	
+*/
+unsigned int JobSystem::getThreadCount() {
+	return threadCount;
+}
+
+/*
+*	Queues function(data, begin, end), counted by counter if it isn't null.
+*	
+*/
+void JobSystem::run(JobFunction function, void *data, JobCounter *counter, unsigned int begin, unsigned int end) {
+	if (counter != nullptr) {
+		counter->pending++;
+	}
+	push({ function, data, begin, end, counter });
+}
+
+/*
+*	Queues a job that only starts once every job counted by dependency has finished.
+*	
+*/
+void JobSystem::runAfter(JobCounter &dependency, JobFunction function, void *data, JobCounter *counter, unsigned int begin, unsigned int end) {
+	if (counter != nullptr) {
+		counter->pending++;
+	}
+	Job job = { function, data, begin, end, counter };
+	{
+		std::lock_guard<std::mutex> lock(dependency.mutex);
+		if (dependency.pending.load() != 0 && dependency.dependentCount < JobCounter::MAX_DEPENDENTS) {
+			dependency.dependents[dependency.dependentCount++] = job;
+			return;
+		}
+	}
+	// either the dependency is done already or it can't take more dependents
+	wait(dependency);
+	push(job);
+}
+
+/*
+*	Runs queued jobs until every job counted by counter has finished. Afterwards the counter
+*	may be destroyed.
+*/
+void JobSystem::wait(JobCounter &counter) {
+	while (!counter.isDone()) {
+		if (!help()) {
+			std::this_thread::yield();
+		}
+	}
+	// the last finish() may still hold the lock after dropping the count to zero
+	std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+/*
+*	Runs one queued job if there is any, returns false otherwise.
+*	
+*/
+bool JobSystem::help() {
+	Job job;
+	if (!pop(job)) {
+		return false;
+	}
+	execute(job);
+	return true;
+}
+
+/*
+*	Puts a job on the calling thread's queue (threads the scheduler doesn't know use the main thread's)
+*	and wakes a worker. Without workers or with a full queue the job runs right away.
+*/
+void JobSystem::push(const Job &job) {
+	if (!running) {
+		execute(job);
+		return;
+	}
+	JobQueue &queue = queues[threadIndex >= 0 ? threadIndex : 0];
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.count < QUEUE_CAPACITY) {
+			queue.jobs[(queue.head + queue.count) % QUEUE_CAPACITY] = job;
+			queue.count++;
+			queuedJobs++;
+			queued = true;
+		}
+	}
+	if (!queued) {
+		execute(job);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wake.notify_one();
+}
+
+/*
+*	Takes the newest job of the own queue, or steals the oldest one of another thread.
+*	
+*/
+bool JobSystem::pop(Job &job) {
+	if (!running || queuedJobs.load() == 0) {
+		return false;
+	}
+	unsigned int own = threadIndex >= 0 ? threadIndex : 0;
+	for (unsigned int i = 0; i < threadCount; i++) {
+		JobQueue &queue = queues[(own + i) % threadCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.count == 0) {
+			continue;
+		}
+		if (i == 0) {
+			job = queue.jobs[(queue.head + queue.count - 1) % QUEUE_CAPACITY];
+		}
+		else {
+			job = queue.jobs[queue.head];
+			queue.head = (queue.head + 1) % QUEUE_CAPACITY;
+		}
+		queue.count--;
+		queuedJobs--;
+		return true;
+	}
+	return false;
+}
+
+/*
+*	Runs a job and marks it finished.
+*	
+*/
+void JobSystem::execute(const Job &job) {
+	job.function(job.data, job.begin, job.end);
+	finish(job.counter);
+}
+
+/*
+*	Counts a job of counter as finished. The last one releases the jobs waiting for the counter.
+*	
+*/
+void JobSystem::finish(JobCounter *counter) {
+	if (counter == nullptr) {
+		return;
+	}
+	Job dependents[JobCounter::MAX_DEPENDENTS];
+	unsigned int dependentCount = 0;
+	{
+		std::lock_guard<std::mutex> lock(counter->mutex);
+		if (--counter->pending != 0) {
+			return;
+		}
+		dependentCount = counter->dependentCount;
+		for (unsigned int i = 0; i < dependentCount; i++) {
+			dependents[i] = counter->dependents[i];
+		}
+		counter->dependentCount = 0;
+	}
+	// the counter may be gone as soon as it reads zero, only the copies are used from here on
+	for (unsigned int i = 0; i < dependentCount; i++) {
+		push(dependents[i]);
+	}
+}
+
+/*
+*	Worker thread, runs jobs and sleeps while there are none.
+*	
+*/
+void JobSystem::workerLoop(unsigned int index) {
+	threadIndex = static_cast<int>(index);
+	while (true) {
+		if (help()) {
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, []() { return queuedJobs.load() != 0 || !running; });
+		if (!running && queuedJobs.load() == 0) {
+			return;
+		}
+	}
+}
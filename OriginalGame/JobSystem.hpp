@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+
+class JobCounter;
+
+typedef void (*JobFunction)(void *data, unsigned int begin, unsigned int end);
+
+/*
+*	A unit of work: function(data, begin, end). Jobs are copied into the queues by value, 
+*	so running one never allocates.
+*/
+struct Job {
+	JobFunction function;
+	void *data;
+	unsigned int begin;
+	unsigned int end;
+	JobCounter *counter;	// decremented once the job has finished, may be null
+};
+
+/*
+*	Counts unfinished jobs. Waiting on a counter, or queueing jobs behind it with runAfter(), 
+*	is how jobs depend on each other. A counter has to outlive the jobs it counts.
+*/
+class JobCounter
+{
+public:
+	static const unsigned int MAX_DEPENDENTS = 8;
+	JobCounter();
+	bool isDone(void) const;
+private:
+	friend class JobSystem;
+	std::atomic<unsigned int> pending;
+	std::mutex mutex;
+	Job dependents[MAX_DEPENDENTS];
+	unsigned int dependentCount;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter &operator=(const JobCounter&) = delete;
+};
+
+/*
+*	Work-stealing job scheduler. Every worker and the main thread own a job deque: they push and pop 
+*	at its back and steal from the front of the others' when they run dry. Threads waiting on a counter 
+*	keep running jobs meanwhile, so jobs may wait on jobs they spawned. Until init() (or with no workers) 
+*	jobs simply run inline.
+*/
+class JobSystem
+{
+public:
+	static const unsigned int QUEUE_CAPACITY = 1024;
+	static void init(unsigned int workerCount = 0);
+	static void shutdown(void);
+	static unsigned int getThreadCount(void);
+	static void run(JobFunction function, void *data, JobCounter *counter, unsigned int begin = 0, unsigned int end = 0);
+	static void runAfter(JobCounter &dependency, JobFunction function, void *data, JobCounter *counter, unsigned int begin = 0, unsigned int end = 0);
+	static void wait(JobCounter &counter);
+	static bool help(void);
+	template <typename Body>
+	static void parallelFor(unsigned int count, unsigned int grain, const Body &body);
+private:
+	static void push(const Job &job);
+	static bool pop(Job &job);
+	static void execute(const Job &job);
+	static void finish(JobCounter *counter);
+	static void workerLoop(unsigned int index);
+	template <typename Body>
+	static void invokeRange(void *data, unsigned int begin, unsigned int end);
+};
+
+/*
+*	Calls body(i) for every i below count, in jobs of grain indices each, and returns once all are
+*	done. The calling thread works on them as well.
+*/
+template <typename Body>
+void JobSystem::parallelFor(unsigned int count, unsigned int grain, const Body &body) {
+	if (grain == 0) {
+		grain = 1;
+	}
+	if (count <= grain || getThreadCount() <= 1) {
+		for (unsigned int i = 0; i < count; i++) {
+			body(i);
+		}
+		return;
+	}
+	JobCounter counter;
+	for (unsigned int begin = 0; begin < count; begin += grain) {
+		unsigned int end = begin + grain < count ? begin + grain : count;
+		run(&JobSystem::invokeRange<Body>, const_cast<Body*>(&body), &counter, begin, end);
+	}
+	wait(counter);
+}
+
+/*
+*	Job function of parallelFor.
+*	
+*/
+template <typename Body>
+void JobSystem::invokeRange(void *data, unsigned int begin, unsigned int end) {
+	const Body &body = *static_cast<const Body*>(data);
+	for (unsigned int i = begin; i < end; i++) {
+		body(i);
+	}
+}
+
@@ -6,6 +6,23 @@
 #include "Model.hpp"
 #include "Skybox.hpp"
 #include "Framebuffer.hpp"
+#include "GPUTimer.hpp"
+#include "ResolutionScaler.hpp"
+#include "ShaderVariants.hpp"
+#include "StreamBuffer.hpp"
+#include "FrameCapture.hpp"
+#include "OcclusionCuller.hpp"
+#include "ModelLoader.hpp"
+#include "JobSystem.hpp"
+#include "BonePalette.hpp"
+#include "TargetBatch.hpp"
+#include "HitRegistration.hpp"
+#include "ClickTimer.hpp"
+#include "Ballistics.hpp"
+#include "SpatialGrid.hpp"
+#include "Decals.hpp"
+#include "Particles.hpp"
+#include "FrameArena.hpp"
 #include "Prototypes.hpp"
 
 /*			GLOBAL VARIABLES	*/
@@ -16,16 +33,75 @@ struct Character {
 	GLuint     Advance;    // Offset to advance to next glyph
 };
 
+enum ObjectType {
+	OBJECT_PLANE,
+	OBJECT_CUBE,
+	OBJECT_MODEL
+};
+
+struct SceneObject {
+	ObjectType type;
+	glm::mat4  transform;  // model matrix
+	GLuint     texture;    // diffuse texture for planes and cubes, models bind their own
+	Model     *model;      // only set for OBJECT_MODEL
+	float      distance;   // squared distance to the camera, used for sorting
+	unsigned int lod;      // level of detail of OBJECT_MODEL, kept between frames for hysteresis
+	bool       occluded;   // hidden behind the occluders this frame, only skipped in the camera passes
+	bool       outside;    // outside the view frustum this frame, only skipped in the camera passes
+	int        entity;     // id in the scene's spatial index, -1 for the floor which is too large to index
+	Animator   animator;   // playback state of a skinned OBJECT_MODEL
+	GLint      palette;    // paletteOffset of this frame's bone matrices, -1 for objects drawn rigid
+};
+
 std::map<GLchar, Character> Characters;
-GLuint VAO, VBO;
+std::vector<SceneObject> sceneObjects;
+GLuint VAO;
 HWND consoleWindow			= GetConsoleWindow();
 GLFWwindow *window			= nullptr;
 const int SCR_WIDTH			= 1280;
 const int SCR_HEIGHT		= 768;
 const char *TITLE			= "Aiming Simulator by D3PSI";
+const float TARGET_FRAME_TIME	= 1000.0f / 144.0f;
+const int SHADOW_MAP_UNIT	= 8;	// above the units used by model textures, so drawing a model can't unbind it
+const int SHADOW_LOD_BIAS	= 1;	// the shadow map is low resolution, models cast shadows one level coarser
+const unsigned int OBJECT_GRAIN	= 64;	// scene objects per job in the per-frame object loops
+const unsigned int ANIMATION_GRAIN	= 4;	// animated objects per job, pose evaluation is much heavier
+const unsigned int TARGET_SEED	= 1337;	// same seed, same target paths
+const unsigned int TARGETS_PER_PATTERN	= 8;
+const float PROJECTILE_SPEED	= 60.0f;
+const float DECAL_SIZE		= 0.05f;	// half size of an impact decal
+const unsigned int SPARKS_PER_IMPACT	= 16;
+const unsigned int DEBRIS_PER_HIT	= 24;	// burst when a target is hit
+int windowWidth				= SCR_WIDTH;
+int windowHeight			= SCR_HEIGHT;
+bool windowResized			= false;
+bool depthPrepass			= true;
+unsigned int objectFeatures	= SHADER_DIFFUSE_MAP | SHADER_SHADOWS_PCF;
+unsigned int activeFeatures	= objectFeatures;	// what is drawn until objectFeatures' variants have compiled
+bool showRenderStats		= false;
+FrameCapture *frameCapture	= nullptr;
+OcclusionCuller *occlusionCuller = nullptr;
+TargetMotion *targetMotion	= nullptr;
+TargetBatch *targetBatch	= nullptr;
+HitRegistration *hitRegistration = nullptr;
+Ballistics *ballistics		= nullptr;
+SpatialGrid *sceneIndex		= nullptr;
+SpatialGrid *targetIndex	= nullptr;
+Decals *decals				= nullptr;
+TriangleBVH sceneCollision;		// floor and cubes in world space
+Particles *particles		= nullptr;
+glm::vec3 targetBoundsCenter;	// bounding sphere of a target relative to its position
+float targetBoundsRadius		= 0.0f;
+std::vector<float> targetX, targetY, targetZ;
+std::vector<unsigned int> visibleEntities;
+std::vector<char> entityVisible;
+std::vector<unsigned int> visibleTargets;
+std::vector<char> targetVisible;
+bool occlusionCulling		= true;
 float lastFrame				= 0.0;
 float deltaTime				= 0.0;
 bool process				= true;
+double previousPoll			= 0.0;		// glfwGetTime() when the previous glfwPollEvents() started
 Camera *camera				= new Camera(glm::vec3(
 												0.0f,
 												0.0f,
@@ -103,7 +179,83 @@ namespace dev {
 	*
 	*/
 	void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
-		glViewport(0, 0, width, height);
+		GLState::viewport(0, 0, width, height);
+		if (width > 0 && height > 0) {
+			windowWidth = width;
+			windowHeight = height;
+			windowResized = true;
+		}
+	}
+
+	/*
+	*	Executes on key events, used for toggles that should fire once per key press.
+	*
+	*/
+	void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+		if (action != GLFW_PRESS) {
+			return;
+		}
+		if (key == GLFW_KEY_F2) {
+			depthPrepass = !depthPrepass;
+			eventLog(depthPrepass ? "Depth pre-pass enabled" : "Depth pre-pass disabled");
+		}
+		else if (key == GLFW_KEY_F3) {
+			// cycle shadow quality PCF -> hard -> off, each one is its own shader variant
+			unsigned int shadows = objectFeatures & (SHADER_SHADOWS_HARD | SHADER_SHADOWS_PCF);
+			objectFeatures &= ~(SHADER_SHADOWS_HARD | SHADER_SHADOWS_PCF);
+			if (shadows == SHADER_SHADOWS_PCF) {
+				objectFeatures |= SHADER_SHADOWS_HARD;
+				eventLog("Shadow quality set to hard");
+			}
+			else if (shadows == SHADER_SHADOWS_HARD) {
+				eventLog("Shadow quality set to off");
+			}
+			else {
+				objectFeatures |= SHADER_SHADOWS_PCF;
+				eventLog("Shadow quality set to PCF");
+			}
+		}
+		else if (key == GLFW_KEY_F4) {
+			showRenderStats = !showRenderStats;
+		}
+		else if (key == GLFW_KEY_F5) {
+			occlusionCulling = !occlusionCulling;
+			eventLog(occlusionCulling ? "Occlusion culling enabled" : "Occlusion culling disabled");
+		}
+		else if (key == GLFW_KEY_F9 && frameCapture != nullptr) {
+			if (frameCapture->isRecording()) {
+				frameCapture->stopRecording();
+			}
+			else {
+				frameCapture->startRecording();
+			}
+		}
+		else if (key == GLFW_KEY_F12 && frameCapture != nullptr) {
+			frameCapture->requestScreenshot();
+		}
+	}
+
+	/*
+	*	Executes on mouse button events, a left click fires a hitscan shot stamped with the time the 
+	*	press arrived, a right click a projectile. Cursor movement delivered before the click has 
+	*	already turned the camera.
+	*/
+	void mouse_button_callback(GLFWwindow *window, int button, int action, int mods) {
+		if (!process || action != GLFW_PRESS) {
+			return;
+		}
+		if (button == GLFW_MOUSE_BUTTON_LEFT && hitRegistration != nullptr) {
+			// a press delivered by this poll arrived after the previous one started, without raw input
+			// it is only known to have happened before now
+			double time;
+			if (!ClickTimer::take(previousPoll, time)) {
+				time = glfwGetTime();
+			}
+			hitRegistration->fire(time, camera->Position, camera->Front);
+		}
+		else if (button == GLFW_MOUSE_BUTTON_RIGHT && ballistics != nullptr) {
+			ballistics->fire(camera->Position, camera->Front * PROJECTILE_SPEED);
+		}
 	}
 
 	/*
@@ -261,7 +413,7 @@ namespace dev {
 			else if (nrComponents == 4) {
 				format = GL_RGBA;
 			}
-			glBindTexture(GL_TEXTURE_2D, textureID);
+			GLState::bindTexture(0, GL_TEXTURE_2D, textureID);
 			glTexImage2D(
 					GL_TEXTURE_2D, 
 					0, 
@@ -274,6 +426,7 @@ namespace dev {
 					data
 			);
 			glGenerateMipmap(GL_TEXTURE_2D);
+			GPUMemory::trackTexture(textureID, GPUMemory::textureSize(format, width, height, 1, true), GPU_MEMORY_TEXTURES, path);
 			glTexParameteri(
 					GL_TEXTURE_2D,
 					GL_TEXTURE_WRAP_S, 
@@ -313,8 +466,6 @@ namespace dev {
 	unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma) {
 		std::string filename = std::string(path);
 		filename = directory + '/' + filename;
-		unsigned int textureID;
-		glGenTextures(1, &textureID);
 		int width, height, nrComponents;
 		unsigned char *data = stbi_load(
 									filename.c_str(),
@@ -323,6 +474,16 @@ namespace dev {
 									&nrComponents,
 									0
 								);
+		return textureFromImage(data, width, height, nrComponents, filename);
+	}
+
+	/*
+	*	Creates a mipmapped 2D texture from decoded image data and frees the data. The decoding can 
+	*	happen on any thread, this part needs the context. Null data means the decode failed.
+	*/
+	unsigned int textureFromImage(unsigned char *data, int width, int height, int nrComponents, const std::string &filename) {
+		unsigned int textureID;
+		glGenTextures(1, &textureID);
 		if (data) {
 			GLenum format;
 			if (nrComponents == 1) {
@@ -334,7 +495,7 @@ namespace dev {
 			else if (nrComponents == 4) {
 				format = GL_RGBA;
 			}
-			glBindTexture(GL_TEXTURE_2D, textureID);
+			GLState::bindTexture(0, GL_TEXTURE_2D, textureID);
 			glTexImage2D(
 					GL_TEXTURE_2D,
 					0, 
@@ -347,6 +508,7 @@ namespace dev {
 					data
 			);
 			glGenerateMipmap(GL_TEXTURE_2D);
+			GPUMemory::trackTexture(textureID, GPUMemory::textureSize(format, width, height, 1, true), GPU_MEMORY_TEXTURES, filename);
 			glTexParameteri(
 					GL_TEXTURE_2D,
 					GL_TEXTURE_WRAP_S,
@@ -371,8 +533,8 @@ namespace dev {
 		}
 		else {
 			showConsoleWindow();
-			std::cerr << "Texture failed to load at path: " << path << std::endl;
-			error("Texture failed to load at path: " + *path);
+			std::cerr << "Texture failed to load at path: " << filename << std::endl;
+			error("Texture failed to load at path: " + filename);
 			stbi_image_free(data);
 		}
 		return textureID;
@@ -385,9 +547,10 @@ namespace dev {
 	unsigned int loadCubemap(std::vector<std::string> faces) {
 		unsigned int textureID;
 		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+		GLState::bindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
 
 		int width, height, nrChannels;
+		GLsizeiptr bytes = 0;
 		for (unsigned int i = 0; i < faces.size(); i++) {
 			unsigned char *data = stbi_load(
 										faces[i].c_str(),
@@ -408,6 +571,7 @@ namespace dev {
 						GL_UNSIGNED_BYTE, 
 						data
 				);
+				bytes += GPUMemory::textureSize(GL_RGB, width, height);
 				stbi_image_free(data);
 			}
 			else {
@@ -417,6 +581,7 @@ namespace dev {
 				stbi_image_free(data);
 			}
 		}
+		GPUMemory::trackTexture(textureID, bytes, GPU_MEMORY_TEXTURES, faces.empty() ? "Cubemap" : faces[0]);
 		glTexParameteri(
 				GL_TEXTURE_CUBE_MAP,
 				GL_TEXTURE_MIN_FILTER,
@@ -464,17 +629,19 @@ namespace dev {
 			// setup quad VAO
 			glGenVertexArrays(1, &quadVAO);
 			glGenBuffers(1, &quadVBO);
-			glBindVertexArray(quadVAO);
-			glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+			GLState::bindVertexArray(quadVAO);
+			GLState::bindBuffer(GL_ARRAY_BUFFER, quadVBO);
 			glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
+			RenderStats::countUpload(sizeof(quadVertices));
+			GPUMemory::trackBuffer(quadVBO, sizeof(quadVertices), GPU_MEMORY_GEOMETRY, "Primitives");
 			glEnableVertexAttribArray(0);
 			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
 			glEnableVertexAttribArray(1);
 			glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
 		}
-		glBindVertexArray(quadVAO);
+		GLState::bindVertexArray(quadVAO);
 		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-		glBindVertexArray(0);
+		RenderStats::countDraw(GL_TRIANGLE_STRIP, 4);
 	}
 
 	/*
@@ -540,109 +707,433 @@ namespace dev {
 			glGenBuffers(1, &cubeVBO);
 
 			// fill buffer
-			glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+			GLState::bindBuffer(GL_ARRAY_BUFFER, cubeVBO);
 			glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+			RenderStats::countUpload(sizeof(vertices));
+			GPUMemory::trackBuffer(cubeVBO, sizeof(vertices), GPU_MEMORY_GEOMETRY, "Primitives");
 
 			// link vertex attributes
-			glBindVertexArray(cubeVAO);
+			GLState::bindVertexArray(cubeVAO);
 			glEnableVertexAttribArray(0);
 			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
 			glEnableVertexAttribArray(1);
 			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
 			glEnableVertexAttribArray(2);
 			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-			glBindVertexArray(0);
+			GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+			GLState::bindVertexArray(0);
 		}
 		// render Cube
-		glBindVertexArray(cubeVAO);
+		GLState::bindVertexArray(cubeVAO);
 		glDrawArrays(GL_TRIANGLES, 0, 36);
-		glBindVertexArray(0);
+		RenderStats::countDraw(GL_TRIANGLES, 36);
 	}
 
 	/*
-	*	Renders the entire scene.
+	*	renderPlane() renders the 50x50 floor plane.
 	*	
 	*/
-	void renderScene(const Shader &shader) {
-		float planeVertices[] = {
-			// positions            // normals         // texcoords
-			25.0f, -0.5f,  25.0f,  0.0f, 1.0f, 0.0f,  25.0f,  0.0f,
-		   -25.0f, -0.5f,  25.0f,  0.0f, 1.0f, 0.0f,   0.0f,  0.0f,
-		   -25.0f, -0.5f, -25.0f,  0.0f, 1.0f, 0.0f,   0.0f, 25.0f,
-
-			25.0f, -0.5f,  25.0f,  0.0f, 1.0f, 0.0f,  25.0f,  0.0f,
-		   -25.0f, -0.5f, -25.0f,  0.0f, 1.0f, 0.0f,   0.0f, 25.0f,
-			25.0f, -0.5f, -25.0f,  0.0f, 1.0f, 0.0f,  25.0f, 25.0f
-		};
+	unsigned int planeVAO = 0;
+	unsigned int planeVBO = 0;
+	void renderPlane() {
+		if (planeVAO == 0) {
+			float planeVertices[] = {
+				// positions            // normals         // texcoords
+				25.0f, -0.5f,  25.0f,  0.0f, 1.0f, 0.0f,  25.0f,  0.0f,
+			   -25.0f, -0.5f,  25.0f,  0.0f, 1.0f, 0.0f,   0.0f,  0.0f,
+			   -25.0f, -0.5f, -25.0f,  0.0f, 1.0f, 0.0f,   0.0f, 25.0f,
+
+				25.0f, -0.5f,  25.0f,  0.0f, 1.0f, 0.0f,  25.0f,  0.0f,
+			   -25.0f, -0.5f, -25.0f,  0.0f, 1.0f, 0.0f,   0.0f, 25.0f,
+				25.0f, -0.5f, -25.0f,  0.0f, 1.0f, 0.0f,  25.0f, 25.0f
+			};
 
-		// plane VAO
-		unsigned int planeVBO, planeVAO;
-		glGenVertexArrays(1, &planeVAO);
-		glGenBuffers(1, &planeVBO);
-		glBindVertexArray(planeVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), planeVertices, GL_STATIC_DRAW);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-		glBindVertexArray(0);
-		glm::mat4 model;
-		shader.setMat4("model", model);
-		glBindVertexArray(planeVAO);
+			// plane VAO
+			glGenVertexArrays(1, &planeVAO);
+			glGenBuffers(1, &planeVBO);
+			GLState::bindVertexArray(planeVAO);
+			GLState::bindBuffer(GL_ARRAY_BUFFER, planeVBO);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), planeVertices, GL_STATIC_DRAW);
+			RenderStats::countUpload(sizeof(planeVertices));
+			GPUMemory::trackBuffer(planeVBO, sizeof(planeVertices), GPU_MEMORY_GEOMETRY, "Primitives");
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+			GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		GLState::bindVertexArray(planeVAO);
 		glDrawArrays(GL_TRIANGLES, 0, 6);
+		RenderStats::countDraw(GL_TRIANGLES, 6);
+	}
+
+	/*
+	*	Fills the list of scene objects: the floor, the cubes and the target model.
+	*	
+	*/
+	void buildScene(Model *target, unsigned int texture) {
+		SceneObject object;
+		object.texture = texture;
+		object.model = nullptr;
+		object.lod = 0;
+		object.occluded = false;
+		object.outside = false;
+		object.entity = -1;
+		object.palette = -1;
+
+		// plane
+		object.type = OBJECT_PLANE;
+		object.transform = glm::mat4();
+		sceneObjects.push_back(object);
 
 		// cubes
-		model = glm::mat4();
-		model = glm::translate(model, glm::vec3(0.0f, 1.5f, 0.0));
-		model = glm::scale(model, glm::vec3(0.5f));
-		shader.setMat4("model", model);
-		renderCube();
-		model = glm::mat4();
-		model = glm::translate(model, glm::vec3(2.0f, 0.0f, 1.0));
-		model = glm::scale(model, glm::vec3(0.5f));
-		shader.setMat4("model", model);
-		renderCube();
-		model = glm::mat4();
-		model = glm::translate(model, glm::vec3(-1.0f, 0.0f, 2.0));
-		model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
-		model = glm::scale(model, glm::vec3(0.25));
-		shader.setMat4("model", model);
-		renderCube();
-		glm::mat4 newModel;
-		newModel = glm::translate(newModel, glm::vec3(
-											0.0f, 
-											0.0f,
-											0.0f
-										));
-		shader.setMat4("model", newModel);
+		object.type = OBJECT_CUBE;
+		object.transform = glm::mat4();
+		object.transform = glm::translate(object.transform, glm::vec3(0.0f, 1.5f, 0.0));
+		object.transform = glm::scale(object.transform, glm::vec3(0.5f));
+		sceneObjects.push_back(object);
+		object.transform = glm::mat4();
+		object.transform = glm::translate(object.transform, glm::vec3(2.0f, 0.0f, 1.0));
+		object.transform = glm::scale(object.transform, glm::vec3(0.5f));
+		sceneObjects.push_back(object);
+		object.transform = glm::mat4();
+		object.transform = glm::translate(object.transform, glm::vec3(-1.0f, 0.0f, 2.0));
+		object.transform = glm::rotate(object.transform, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
+		object.transform = glm::scale(object.transform, glm::vec3(0.25));
+		sceneObjects.push_back(object);
+
+		// target
+		object.type = OBJECT_MODEL;
+		object.transform = glm::mat4();
+		object.texture = 0;
+		object.model = target;
+		sceneObjects.push_back(object);
 	}
 
 	/*
-	*	Renders a string of text to the screen.
-	*	
+	*	Sorts the scene objects front-to-back as seen from the given position, so the 
+	*	depth test rejects hidden fragments before they are shaded.
 	*/
-	void RenderText(Shader &s, std::string text, GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color) {
-		// Activate corresponding render state	
-		s.use();
-		glUniform3f(glGetUniformLocation(s.ID, "textColor"), color.x, color.y, color.z);
-		glActiveTexture(GL_TEXTURE0);
-		glBindVertexArray(VAO);
+	void sortScene(const glm::vec3 &viewPos) {
+		JobSystem::parallelFor(static_cast<unsigned int>(sceneObjects.size()), OBJECT_GRAIN, [&](unsigned int i) {
+			glm::vec3 offset = glm::vec3(sceneObjects[i].transform[3]) - viewPos;
+			sceneObjects[i].distance = glm::dot(offset, offset);
+		});
+		std::sort(sceneObjects.begin(), sceneObjects.end(), [](const SceneObject &a, const SceneObject &b) {
+			return a.distance < b.distance;
+		});
+	}
+
+	/*
+	*	Picks the level of detail of every model instance for this frame from its size on screen.
+	*
+	*/
+	void selectLODs(const glm::vec3 &viewPos, const glm::mat4 &projection) {
+		JobSystem::parallelFor(static_cast<unsigned int>(sceneObjects.size()), OBJECT_GRAIN, [&](unsigned int i) {
+			SceneObject &object = sceneObjects[i];
+			if (object.type == OBJECT_MODEL) {
+				object.lod = object.model->selectLOD(object.transform, viewPos, projection[1][1], object.lod);
+			}
+		});
+	}
+
+	/*
+	*	Adds the scene objects to the scene's spatial index by their bounding spheres, except for the 
+	*	floor which covers the whole area and is always drawn.
+	*/
+	void indexScene() {
+		for (unsigned int i = 0; i < sceneObjects.size(); i++) {
+			SceneObject &object = sceneObjects[i];
+			float scale = glm::length(glm::vec3(object.transform[0]));
+			if (object.type == OBJECT_CUBE) {
+				object.entity = static_cast<int>(sceneIndex->add(glm::vec3(object.transform[3]), 1.7320508f * scale));
+			}
+			else if (object.type == OBJECT_MODEL) {
+				glm::vec3 center = glm::vec3(object.transform * glm::vec4(object.model->boundsCenter, 1.0f));
+				object.entity = static_cast<int>(sceneIndex->add(center, object.model->boundsRadius * scale));
+			}
+		}
+	}
+
+	/*
+	*	Builds the triangles of the floor and the cubes in world space, which stop shots and carry
+	*	decals. The target model standing in the scene is left out as for the ballistics.
+	*/
+	void buildSceneCollision() {
+		static const int CUBE_FACES[6][4] = {
+			{ 0, 1, 3, 2 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 3, 7, 6 }, { 0, 2, 6, 4 }, { 1, 3, 7, 5 }
+		};
+		std::vector<glm::vec3> corners;
+		glm::vec3 floor[4] = {
+			glm::vec3(25.0f, -0.5f, 25.0f), glm::vec3(-25.0f, -0.5f, 25.0f),
+			glm::vec3(-25.0f, -0.5f, -25.0f), glm::vec3(25.0f, -0.5f, -25.0f)
+		};
+		corners.push_back(floor[0]); corners.push_back(floor[1]); corners.push_back(floor[2]);
+		corners.push_back(floor[0]); corners.push_back(floor[2]); corners.push_back(floor[3]);
+		for (unsigned int i = 0; i < sceneObjects.size(); i++) {
+			if (sceneObjects[i].type != OBJECT_CUBE) {
+				continue;
+			}
+			glm::vec3 cube[8];
+			for (int c = 0; c < 8; c++) {
+				glm::vec4 corner((c & 4) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 1) ? 1.0f : -1.0f, 1.0f);
+				cube[c] = glm::vec3(sceneObjects[i].transform * corner);
+			}
+			for (int f = 0; f < 6; f++) {
+				const int *face = CUBE_FACES[f];
+				corners.push_back(cube[face[0]]); corners.push_back(cube[face[1]]); corners.push_back(cube[face[2]]);
+				corners.push_back(cube[face[0]]); corners.push_back(cube[face[2]]); corners.push_back(cube[face[3]]);
+			}
+		}
+		sceneCollision.build(std::move(corners));
+	}
 
-		// Iterate through all characters
-		std::string::const_iterator c;
-		for (c = text.begin(); c != text.end(); c++) {
-			Character ch = Characters[*c];
+	/*
+	*	Moves the targets in their spatial index to their positions after the last tick, the first call
+	*	inserts them. Runs after every tick, so every ballistics tick sees the targets of the same tick.
+	*/
+	void indexTargets() {
+		unsigned int count = targetMotion->getCount();
+		if (count == 0) {
+			return;
+		}
+		targetX.resize(count);
+		targetY.resize(count);
+		targetZ.resize(count);
+		targetMotion->getPositions(&targetX[0], &targetY[0], &targetZ[0]);
+		for (unsigned int i = 0; i < count; i++) {
+			glm::vec3 center = glm::vec3(targetX[i], targetY[i], targetZ[i]) + targetBoundsCenter;
+			if (i < targetIndex->getCount()) {
+				targetIndex->move(i, center);
+			}
+			else {
+				targetIndex->add(center, targetBoundsRadius);
+			}
+		}
+		targetIndex->commit();
+	}
+
+	/*
+	*	Overwrites targetX, targetY and targetZ with the targets' interpolated positions, where they are
+	*	drawn this frame.
+	*/
+	void interpolateTargets() {
+		if (!targetX.empty()) {
+			targetMotion->interpolate(&targetX[0], &targetY[0], &targetZ[0]);
+		}
+	}
+
+	/*
+	*	Marks the objects outside the view frustum with a query of the scene's spatial index, then 
+	*	rasterizes the cubes as occluders and marks the models hidden behind them. Only models are 
+	*	tested, the cubes are cheap and would partly occlude themselves. The tests run as jobs.
+	*/
+	void cullOccluded(const glm::mat4 &viewProjection) {
+		visibleEntities.clear();
+		sceneIndex->queryFrustum(viewProjection, visibleEntities);
+		entityVisible.assign(sceneIndex->getCount(), 0);
+		for (unsigned int i = 0; i < visibleEntities.size(); i++) {
+			entityVisible[visibleEntities[i]] = 1;
+		}
+		if (occlusionCulling) {
+			occlusionCuller->beginFrame(viewProjection);
+			for (unsigned int i = 0; i < sceneObjects.size(); i++) {
+				if (sceneObjects[i].type == OBJECT_CUBE) {
+					occlusionCuller->addBox(sceneObjects[i].transform);
+				}
+			}
+			occlusionCuller->rasterize();
+		}
+		JobSystem::parallelFor(static_cast<unsigned int>(sceneObjects.size()), OBJECT_GRAIN, [&](unsigned int i) {
+			SceneObject &object = sceneObjects[i];
+			object.outside = object.entity >= 0 && !entityVisible[object.entity];
+			object.occluded = false;
+			if (occlusionCulling && !object.outside && object.type == OBJECT_MODEL) {
+				glm::vec3 extent(object.model->boundsRadius);
+				object.occluded = !occlusionCuller->isVisible(object.model->boundsCenter, extent, object.transform);
+			}
+		});
+		for (unsigned int i = 0; i < sceneObjects.size(); i++) {
+			if (sceneObjects[i].outside) {
+				RenderStats::countCulled();
+			}
+			else if (sceneObjects[i].occluded) {
+				RenderStats::countOccluded();
+			}
+		}
+	}
+
+	/*
+	*	Marks the targets inside the view frustum with a query of the targets' spatial index and tests
+	*	their drawn bounding spheres against the occluders cullOccluded rasterized. The index is at most
+	*	a tick ahead of the drawn positions, far less than a sphere's radius.
+	*/
+	void cullTargets(const glm::mat4 &viewProjection) {
+		unsigned int count = targetIndex->getCount();
+		visibleTargets.clear();
+		targetIndex->queryFrustum(viewProjection, visibleTargets);
+		targetVisible.assign(count, 0);
+		JobSystem::parallelFor(static_cast<unsigned int>(visibleTargets.size()), OBJECT_GRAIN, [&](unsigned int i) {
+			unsigned int id = visibleTargets[i];
+			glm::vec3 center = glm::vec3(targetX[id], targetY[id], targetZ[id]) + targetBoundsCenter;
+			bool visible = !occlusionCulling || occlusionCuller->isVisible(center, glm::vec3(targetBoundsRadius), glm::mat4());
+			targetVisible[id] = visible ? 1 : 0;
+		});
+		for (unsigned int i = static_cast<unsigned int>(visibleTargets.size()); i < count; i++) {
+			RenderStats::countCulled();
+		}
+		for (unsigned int i = 0; i < visibleTargets.size(); i++) {
+			if (!targetVisible[visibleTargets[i]]) {
+				RenderStats::countOccluded();
+			}
+		}
+	}
+
+	/*
+	*	Advances the animation of every skinned model instance and every target and evaluates their 
+	*	poses in parallel into the bone palette, which is then uploaded at once. Returns the number of 
+	*	skinned instances.
+	*/
+	unsigned int animateScene(float deltaTime) {
+		BonePalette::beginFrame();
+		unsigned int skinned = 0;
+		for (unsigned int i = 0; i < sceneObjects.size(); i++) {
+			SceneObject &object = sceneObjects[i];
+			object.palette = -1;
+			if (object.type == OBJECT_MODEL && object.model->isSkinned()) {
+				object.palette = BonePalette::allocate(static_cast<unsigned int>(object.model->bones.size()));
+				skinned++;
+			}
+		}
+		if (skinned > 0) {
+			JobSystem::parallelFor(static_cast<unsigned int>(sceneObjects.size()), ANIMATION_GRAIN, [&](unsigned int i) {
+				SceneObject &object = sceneObjects[i];
+				if (object.palette >= 0) {
+					object.animator.update(*object.model, deltaTime);
+					object.animator.evaluate(*object.model, BonePalette::getMatrices(object.palette));
+				}
+			});
+		}
+		// the targets reserve their ranges after the objects filled theirs
+		skinned += targetBatch->animate(*targetMotion, deltaTime);
+		if (skinned == 0) {
+			return 0;
+		}
+		bool uploaded = BonePalette::upload();
+		for (unsigned int i = 0; i < sceneObjects.size(); i++) {
+			// from the palette index to the shader's texel offset
+			if (sceneObjects[i].palette >= 0) {
+				sceneObjects[i].palette = uploaded ? BonePalette::getTexelOffset(sceneObjects[i].palette) : -1;
+			}
+		}
+		return uploaded ? skinned : 0;
+	}
+
+	/*
+	*	Sets the sampler units of an objectShader variant and the flat color untextured variants use,
+	*	called once per variant when it is first used.
+	*/
+	void setupObjectShader(Shader &shader) {
+		shader.setInt("diffuseTexture", TEXTURE_UNIT_DIFFUSE);
+		shader.setInt("normalMap", TEXTURE_UNIT_NORMAL);
+		shader.setVec3("diffuseColor", glm::vec3(0.8f));
+		shader.setInt("shadowMap", SHADOW_MAP_UNIT);
+		shader.setInt("bonePalette", BonePalette::TEXTURE_UNIT);
+		shader.setFloat("alphaCutoff", 0.5f);
+	}
+
+	/*
+	*	Sets the per-frame uniforms of an objectShader variant for the main pass.
+	*
+	*/
+	void setObjectUniforms(Shader &shader, const glm::mat4 &viewProjection, const glm::mat4 &lightSpaceMatrix, bool shadows) {
+		shader.use();
+		shader.setMat4("viewProjection", viewProjection);
+		shader.setVec3("viewPos", camera->Position);
+		shader.setVec3("lightPos", lightPos);
+		if (shadows) {
+			shader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
+		}
+	}
+
+	/*
+	*	Renders the entire scene. Depth-only passes pass textured = false, which skips all 
+	*	texture binds and draws each model node with one call. lodBias coarsens every model's LOD, 
+	*	passes that don't look through the camera (shadows) pass skipOccluded = false. Animated 
+	*	models are drawn last with skinnedShader, the skinning variant of shader; without one 
+	*	they are drawn in their bind pose.
+	*/
+	void renderScene(const Shader &shader, bool textured, unsigned int lodBias = 0, bool skipOccluded = true, Shader *skinnedShader = nullptr) {
+		bool anySkinned = false;
+		GLState::useProgram(shader.ID);
+		for (unsigned int i = 0; i < sceneObjects.size(); i++) {
+			const SceneObject &object = sceneObjects[i];
+			if (skipOccluded && (object.outside || object.occluded)) {
+				continue;
+			}
+			if (object.type == OBJECT_MODEL) {
+				if (skinnedShader != nullptr && object.palette >= 0) {
+					anySkinned = true;
+					continue;
+				}
+				object.model->draw(shader, object.transform, textured, object.lod + lodBias);
+				continue;
+			}
+			if (textured && object.texture != 0) {
+				GLState::bindTexture(0, GL_TEXTURE_2D, object.texture);
+			}
+			shader.setMat4("model", object.transform);
+			if (object.type == OBJECT_PLANE) {
+				renderPlane();
+			}
+			else {
+				renderCube();
+			}
+		}
+		if (!anySkinned) {
+			return;
+		}
+		skinnedShader->use();
+		for (unsigned int i = 0; i < sceneObjects.size(); i++) {
+			const SceneObject &object = sceneObjects[i];
+			if (object.palette >= 0 && !(skipOccluded && (object.outside || object.occluded))) {
+				object.model->draw(*skinnedShader, object.transform, textured, object.lod + lodBias, object.palette);
+			}
+		}
+		GLState::useProgram(shader.ID);
+	}
+
+	/*
+	*	Renders a string of text to the screen. All glyph quads are written into the stream buffer 
+	*	at once, then every glyph is drawn from its slice of that range with its own texture.
+	*/
+	void RenderText(Shader &s, const char *text, GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color) {
+		unsigned int length = static_cast<unsigned int>(std::strlen(text));
+		if (length == 0) {
+			return;
+		}
+		typedef GLfloat GlyphQuad[6][4];
+		GLintptr offset;
+		GlyphQuad *quads = static_cast<GlyphQuad*>(StreamBuffer::get().map(
+			length * sizeof(GlyphQuad),
+			4 * sizeof(GLfloat),
+			offset
+		));
+		if (quads == nullptr) {
+			return;
+		}
+
+		// Fill in the quads of all characters
+		for (unsigned int i = 0; i < length; i++) {
+			const Character &ch = Characters[text[i]];
 
 			GLfloat xpos = x + ch.Bearing.x * scale;
 			GLfloat ypos = y - (ch.Size.y - ch.Bearing.y) * scale;
 
 			GLfloat w = ch.Size.x * scale;
 			GLfloat h = ch.Size.y * scale;
-			// Update VBO for each character
 			GLfloat vertices[6][4] = {
 			{ xpos,     ypos + h,   0.0, 0.0 },
 			{ xpos,     ypos,       0.0, 1.0 },
@@ -652,23 +1143,51 @@ namespace dev {
 			{ xpos + w, ypos,       1.0, 1.0 },
 			{ xpos + w, ypos + h,   1.0, 0.0 }
 			};
-
-			// Render glyph texture over quad
-			glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-
-			// Update content of VBO memory
-			glBindBuffer(GL_ARRAY_BUFFER, VBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-			// Render quad
-			glDrawArrays(GL_TRIANGLES, 0, 6);
+			std::copy(&vertices[0][0], &vertices[0][0] + 24, &quads[i][0][0]);
 
 			// Now advance cursors for next glyph (note that advance is number of 1/64 pixels)
 			x += (ch.Advance >> 6) * scale; // Bitshift by 6 to get value in pixels (2^6 = 64)
 		}
-		glBindVertexArray(0);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		StreamBuffer::get().unmap();
+
+		// Activate corresponding render state	
+		s.use();
+		glUniform3f(glGetUniformLocation(s.ID, "textColor"), color.x, color.y, color.z);
+		RenderStats::countUniform();
+		GLState::bindVertexArray(VAO);
+
+		// Render glyph textures over their quads
+		GLint first = static_cast<GLint>(offset / (4 * sizeof(GLfloat)));
+		for (unsigned int i = 0; i < length; i++) {
+			GLState::bindTexture(0, GL_TEXTURE_2D, Characters[text[i]].TextureID);
+			glDrawArrays(GL_TRIANGLES, first + 6 * i, 6);
+			RenderStats::countDraw(GL_TRIANGLES, 6);
+		}
+	}
+
+	/*
+	*	Renders the previous frame's render statistics above the given position, one counter per line.
+	*	
+	*/
+	void renderStats(Shader &s, GLfloat x, GLfloat y) {
+		const FrameStats &stats = RenderStats::getLastFrame();
+		FrameString lines[] = {
+			FrameArena::format("GPU memory: %llu MB (peak %llu MB)", GPUMemory::getTotal() / (1024 * 1024), GPUMemory::getTotalPeak() / (1024 * 1024)),
+			FrameArena::format("Uploaded: %llu KB", stats.bytesUploaded / 1024),
+			FrameArena::format("Uniforms: %u", stats.uniformUploads),
+			FrameArena::format("Binds: %u prog %u tex %u vao", stats.programBinds, stats.textureBinds, stats.vaoBinds),
+			FrameArena::format("Triangles: %llu", stats.triangles),
+			FrameArena::format("Culled: %u outside, %u occluded", stats.culledObjects, stats.occludedObjects),
+			FrameArena::format("Draws: %u (%u instances)", stats.drawCalls, stats.instances),
+			FrameArena::format("Shots: %u (%u hits)", hitRegistration->getShots(), hitRegistration->getHits()),
+			FrameArena::format("Projectiles: %u (%u hits)", ballistics->getCount(), ballistics->getHits()),
+			FrameArena::format("Decals: %u", decals->getCount()),
+			FrameArena::format("Particles: %u (%u dropped)", particles->getCount(), particles->getDropped()),
+			FrameArena::format("Frame arena: %u KB (%u growths)", static_cast<unsigned int>(FrameArena::getUsed() / 1024), FrameArena::getGrowths())
+		};
+		for (unsigned int i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+			RenderText(s, lines[i].c_str(), x, y + i * 30.0f, 0.5f, glm::vec3(1.0f, 1.0f, 0.0f));
+		}
 	}
 
 	/*
@@ -714,7 +1233,9 @@ namespace dev {
 		// set callback functions
 		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 		glfwSetCursorPosCallback(window, mouse_callback);
+		glfwSetMouseButtonCallback(window, mouse_button_callback);
 		glfwSetScrollCallback(window, scroll_callback);
+		glfwSetKeyCallback(window, key_callback);
 
 		// capture cursor
 		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -742,8 +1263,28 @@ int main() {
 	dev::startLog();
 	//dev::hideConsoleWindow();
 	dev::init();
+	// the cache starts out zeroed, which claims e.g. that GL_MULTISAMPLE is off while GL enables it
+	GLState::invalidate();
+	JobSystem::init();
+	dev::eventLog("Job system started with " + std::to_string(JobSystem::getThreadCount()) + " threads");
+	if (!ClickTimer::start()) {
+		dev::eventLog("Raw mouse input unavailable, clicks are timed by frame");
+	}
 	dev::eventLog("Engine successfully initialized");
 
+	/*			SHADERS				*/
+	// only kicks off compilation, the driver builds the programs while the assets below are loaded
+	ShaderVariants objectShaders("src/shaders/objectShader.vert", "src/shaders/objectShader.frag", nullptr, dev::setupObjectShader);
+	objectShaders.prepare(SHADER_DIFFUSE_MAP | SHADER_SHADOWS_PCF);
+	objectShaders.prepare(SHADER_DIFFUSE_MAP | SHADER_SHADOWS_HARD);
+	objectShaders.prepare(SHADER_DIFFUSE_MAP);
+	Shader simpleDepthShader("src/shaders/simpleDepthShader.vert", "src/shaders/simpleDepthShader.frag");
+	Shader skinnedDepthShader("src/shaders/simpleDepthShader.vert", "src/shaders/simpleDepthShader.frag", nullptr, SHADER_SKINNING);
+	Shader instancedDepthShader("src/shaders/simpleDepthShader.vert", "src/shaders/simpleDepthShader.frag", nullptr, SHADER_INSTANCING);
+	Shader skinnedInstancedDepthShader("src/shaders/simpleDepthShader.vert", "src/shaders/simpleDepthShader.frag", nullptr, SHADER_INSTANCING | SHADER_SKINNING);
+	Shader debugDepthQuad("src/shaders/debugDepthQuad.vert", "src/shaders/debugDepthQuad.frag");
+	Shader glyphShader("src/shaders/glyph.vert", "src/shaders/glyph.frag");
+
 	/*			BUFFERS				*/
 	Framebuffer framebuffer(
 					SCR_WIDTH, 
@@ -759,7 +1300,7 @@ int main() {
 	const int SHADOW_HEIGHT = 1024;
 	unsigned int depthMap;
 	glGenTextures(1, &depthMap);
-	glBindTexture(GL_TEXTURE_2D, depthMap);
+	GLState::bindTexture(0, GL_TEXTURE_2D, depthMap);
 	glTexImage2D(
 		GL_TEXTURE_2D,
 		0,
@@ -771,6 +1312,7 @@ int main() {
 		GL_FLOAT,
 		NULL
 	);
+	GPUMemory::trackTexture(depthMap, GPUMemory::textureSize(GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT), GPU_MEMORY_RENDER_TARGETS, "Shadow map");
 	glTexParameteri(
 		GL_TEXTURE_2D, 
 		GL_TEXTURE_MIN_FILTER, 
@@ -791,7 +1333,7 @@ int main() {
 		GL_TEXTURE_WRAP_T, 
 		GL_REPEAT
 	);
-	glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
 	glFramebufferTexture2D(
 		GL_FRAMEBUFFER, 
 		GL_DEPTH_ATTACHMENT,
@@ -801,28 +1343,7 @@ int main() {
 	);
 	glDrawBuffer(GL_NONE);
 	glReadBuffer(GL_NONE);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	/*			SHADERS				*/
-	Shader objectShader("src/shaders/objectShader.vert", "src/shaders/objectShader.frag");
-	Shader simpleDepthShader("src/shaders/simpleDepthShader.vert", "src/shaders/simpleDepthShader.frag");
-	Shader debugDepthQuad("src/shaders/debugDepthQuad.vert", "src/shaders/debugDepthQuad.frag");
-	Shader glyphShader("src/shaders/glyph.vert", "src/shaders/glyph.frag");
-
-	objectShader.use();
-	objectShader.setInt("diffuseTexture", 0);
-	objectShader.setInt("shadowMap", 1);
-
-	debugDepthQuad.use();
-	debugDepthQuad.setInt("depthMap", 0);
-	glm::mat4 glyphProjection = glm::ortho(
-		0.0f,
-		static_cast<GLfloat>(SCR_WIDTH),
-		0.0f,
-		static_cast<GLfloat>(SCR_HEIGHT)
-	);
-	glyphShader.use();
-	glyphShader.setMat4("projection", glyphProjection);
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
 
 	/*			FONTS				*/
 	FT_Library ft;
@@ -861,7 +1382,7 @@ int main() {
 		// Generate texture
 		GLuint texture;
 		glGenTextures(1, &texture);
-		glBindTexture(GL_TEXTURE_2D, texture);
+		GLState::bindTexture(0, GL_TEXTURE_2D, texture);
 		glTexImage2D(
 			GL_TEXTURE_2D,
 			0,
@@ -873,6 +1394,7 @@ int main() {
 			GL_UNSIGNED_BYTE,
 			face->glyph->bitmap.buffer
 		);
+		GPUMemory::trackTexture(texture, GPUMemory::textureSize(GL_RED, face->glyph->bitmap.width, face->glyph->bitmap.rows), GPU_MEMORY_TEXTURES, "Glyphs");
 
 		// Set texture options
 		glTexParameteri(
@@ -905,50 +1427,148 @@ int main() {
 		};
 		Characters.insert(std::pair<GLchar, Character>(c, character));
 	}
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLState::bindTexture(0, GL_TEXTURE_2D, 0);
 	FT_Done_Face(face);
 	FT_Done_FreeType(ft);
 	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
+	GLState::bindVertexArray(VAO);
+	// glyph quads are streamed, RenderText draws them with the stream buffer offset as first vertex
+	GLState::bindBuffer(GL_ARRAY_BUFFER, StreamBuffer::get().getBuffer());
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
-
-	/*			MODELS				*/
-	Model target("res/models/nanosuit/nanosuit.obj");
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+	GLState::bindVertexArray(0);
 
 	/*			SKYBOX				*/
 	Skybox skybox("res/skybox/");
 
+	/*			MODELS				*/
+	// everything from here on belongs to the scene and has to be freed before shutdown
+	GPUMemory::markBaseline();
+	GPUMemory::setReleaseCPUCopies(true);
+	std::vector<Model*> models = ModelLoader::load({
+		"res/models/nanosuit/nanosuit.obj"
+	});
+	Model *target = models[0];
+	for (unsigned int i = 0; i < models.size(); i++) {
+		if (models[i]->isSkinned()) {
+			objectShaders.prepare(objectFeatures | SHADER_SKINNING);
+			break;
+		}
+	}
+
 	unsigned int woodTexture = dev::loadTexture("res/textures/wood.png");
+	dev::buildScene(target, woodTexture);
+	dev::buildSceneCollision();
+
+	/*			TARGETS				*/
+	targetMotion = new TargetMotion(TARGET_SEED, glm::vec3(-10.0f, -0.5f, -10.0f), glm::vec3(10.0f, -0.5f, 10.0f));
+	for (unsigned int i = 0; i < MOTION_PATTERN_COUNT; i++) {
+		targetMotion->spawn(static_cast<MotionPattern>(i), TARGETS_PER_PATTERN);
+	}
+	glm::mat4 targetBase = glm::scale(glm::mat4(), glm::vec3(0.2f));
+	targetBatch = new TargetBatch(target, targetBase);
+	targetBoundsCenter = glm::vec3(targetBase * glm::vec4(target->boundsCenter, 1.0f));
+	targetBoundsRadius = target->boundsRadius * 0.2f;
+	hitRegistration = new HitRegistration(targetBoundsCenter, targetBoundsRadius);
+	hitRegistration->setShape(&target->collision, targetBase);
+	hitRegistration->setScene(&sceneCollision);
+
+	/*			PROJECTILES			*/
+	ballistics = new Ballistics(0.02f, 0.005f, 5.0f);
+	ballistics->setGround(-0.5f);
+	ballistics->setTargetShape(&target->collision, glm::translate(glm::mat4(), -targetBoundsCenter) * targetBase);
+	for (unsigned int i = 0; i < sceneObjects.size(); i++) {
+		if (sceneObjects[i].type == OBJECT_CUBE) {
+			ballistics->addBox(sceneObjects[i].transform);
+		}
+	}
+
+	/*			SPATIAL INDEX		*/
+	sceneIndex = new SpatialGrid(glm::vec3(-25.0f, -0.5f, -25.0f), glm::vec3(25.0f, 5.0f, 25.0f), 2.0f);
+	dev::indexScene();
+	targetIndex = new SpatialGrid(glm::vec3(-25.0f, -0.5f, -25.0f), glm::vec3(25.0f, 5.0f, 25.0f), 2.0f);
+	dev::indexTargets();
+
+	/*			DECALS				*/
+	decals = new Decals(&sceneCollision, &target->collision, targetBase);
+	particles = new Particles();
+	particles->setGround(-0.5f);
+	objectShaders.prepare(objectFeatures | SHADER_INSTANCING);
+	if (target->isSkinned()) {
+		objectShaders.prepare(objectFeatures | SHADER_INSTANCING | SHADER_SKINNING);
+	}
+
+	/*			SHADER UNIFORMS		*/
+	debugDepthQuad.use();
+	debugDepthQuad.setInt("depthMap", 0);
+	skinnedDepthShader.use();
+	skinnedDepthShader.setInt("bonePalette", BonePalette::TEXTURE_UNIT);
+	skinnedInstancedDepthShader.use();
+	skinnedInstancedDepthShader.setInt("bonePalette", BonePalette::TEXTURE_UNIT);
+	glm::mat4 glyphProjection = glm::ortho(
+		0.0f,
+		static_cast<GLfloat>(SCR_WIDTH),
+		0.0f,
+		static_cast<GLfloat>(SCR_HEIGHT)
+	);
+	glyphShader.use();
+	glyphShader.setMat4("projection", glyphProjection);
 
 	/*			OPENGL SETTINGS		*/
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LESS);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::enable(GL_BLEND);
+	GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
 	int counter = 0;
 
+	/*			DYNAMIC RESOLUTION	*/
+	GPUTimer gpuTimer;
+	ResolutionScaler resolutionScaler(TARGET_FRAME_TIME);
+
+	/*			CAPTURE				*/
+	frameCapture = new FrameCapture();
+
+	/*			OCCLUSION CULLING	*/
+	occlusionCuller = new OcclusionCuller();
+
 	/*			GAME LOOP			*/	
 	while (!glfwWindowShouldClose(window)) {
 		// Per-frame time logic
 		counter++;
-		float currentFrame = static_cast<float>(glfwGetTime());
+		double frameStart = glfwGetTime();
+		float currentFrame = static_cast<float>(frameStart);
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 		float fps = 1 / deltaTime;
+		RenderStats::beginFrame();
+		StreamBuffer::get().beginFrame();
+		FrameArena::beginFrame();
 		//std::cout << fps << std::endl;
 		
 		dev::processInput(window);
 
-		glEnable(GL_DEPTH_TEST);
-		glDepthFunc(GL_LESS);
+		if (windowResized) {
+			framebuffer.resize(windowWidth, windowHeight);
+			glyphProjection = glm::ortho(
+				0.0f,
+				static_cast<GLfloat>(windowWidth),
+				0.0f,
+				static_cast<GLfloat>(windowHeight)
+			);
+			glyphShader.use();
+			glyphShader.setMat4("projection", glyphProjection);
+			windowResized = false;
+		}
+		float gpuFrameTime;
+		while (gpuTimer.poll(gpuFrameTime)) {
+			resolutionScaler.update(gpuFrameTime);
+		}
+		framebuffer.setRenderScale(resolutionScaler.getScale());
+		gpuTimer.begin();
+
+		GLState::enable(GL_DEPTH_TEST);
+		GLState::depthFunc(GL_LESS);
 		glClearColor(
 			0.2f,
 			0.3f,
@@ -956,6 +1576,56 @@ int main() {
 			1.0f
 		);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glm::mat4 projection = glm::perspective(glm::radians(camera->Zoom), static_cast<float>(windowWidth) / static_cast<float>(windowHeight), 0.1f, 100.0f);
+		glm::mat4 view = camera->GetViewMatrix();
+		glm::mat4 viewProjection = projection * view;
+		dev::selectLODs(camera->Position, projection);
+		dev::cullOccluded(viewProjection);
+		Shader *skinnedDepth = dev::animateScene(deltaTime) > 0 ? &skinnedDepthShader : nullptr;
+		// targets and projectiles tick together, the index is committed for every tick
+		unsigned int ticks = targetMotion->advance(deltaTime);
+		ballistics->beginFrame();
+		for (unsigned int t = 0; t < ticks; t++) {
+			targetMotion->stepTick();
+			dev::indexTargets();
+			ballistics->stepTick(*targetIndex);
+		}
+		dev::interpolateTargets();
+		dev::cullTargets(viewProjection);
+		for (unsigned int i = 0; i < ballistics->getImpactCount(); i++) {
+			const Impact &impact = ballistics->getImpact(i);
+			particles->emit(PARTICLE_SPARKS, impact.position, impact.normal, SPARKS_PER_IMPACT);
+			if (impact.target >= 0) {
+				glm::vec3 targetPosition = impact.targetCenter - targetBoundsCenter;
+				decals->addToTarget(impact.target, targetPosition, impact.position, impact.normal, DECAL_SIZE);
+				particles->emit(PARTICLE_DEBRIS, impact.position, impact.normal, DEBRIS_PER_HIT);
+			}
+			else {
+				decals->add(impact.position, impact.normal, DECAL_SIZE);
+			}
+		}
+		targetBatch->prepare(*targetMotion, camera->Position, projection[1][1], targetVisible.empty() ? nullptr : &targetVisible[0], skinnedDepth != nullptr);
+		// shots clicked since the last frame are resolved against what was on screen when they were fired
+		hitRegistration->record(frameStart, *targetMotion);
+		hitRegistration->resolve();
+		for (unsigned int i = 0; i < hitRegistration->getResultCount(); i++) {
+			const ShotResult &shot = hitRegistration->getResult(i);
+			if (shot.target >= 0) {
+				glm::vec3 targetPosition(targetX[shot.target], targetY[shot.target], targetZ[shot.target]);
+				glm::vec3 position = targetPosition + targetBoundsCenter + shot.offset;
+				decals->addToTarget(shot.target, targetPosition, position, shot.normal, DECAL_SIZE);
+				particles->emit(PARTICLE_SPARKS, position, shot.normal, SPARKS_PER_IMPACT);
+				particles->emit(PARTICLE_DEBRIS, position, shot.normal, DEBRIS_PER_HIT);
+			}
+			else if (shot.struck) {
+				decals->add(shot.position, shot.normal, DECAL_SIZE);
+				particles->emit(PARTICLE_SPARKS, shot.position, shot.normal, SPARKS_PER_IMPACT);
+			}
+		}
+		if (!targetX.empty()) {
+			decals->update(&targetX[0], &targetY[0], &targetZ[0], static_cast<unsigned int>(targetX.size()));
+		}
+		particles->update(deltaTime);
 
 		// 1. render pass
 		float near_plane = 1.0f, far_plane = 7.5f;
@@ -979,26 +1649,42 @@ int main() {
 								);
 
 		glm::mat4 lightSpaceMatrix = lightProjection * lightView;
-		simpleDepthShader.use();
-		simpleDepthShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-		glViewport(
-			0,
-			0,
-			SHADOW_WIDTH,
-			SHADOW_HEIGHT
-		);
-		glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-		glClear(GL_DEPTH_BUFFER_BIT);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, woodTexture);
-		dev::renderScene(simpleDepthShader);
-		target.draw(simpleDepthShader);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glViewport(
+		// switch to newly requested variants only once the driver finished them, so switching never stalls
+		if (activeFeatures != objectFeatures
+			&& objectShaders.isReady(objectFeatures)
+			&& objectShaders.isReady(objectFeatures | SHADER_INSTANCING)
+			&& (skinnedDepth == nullptr || objectShaders.isReady(objectFeatures | SHADER_SKINNING))
+			&& (!targetBatch->isSkinned() || objectShaders.isReady(objectFeatures | SHADER_INSTANCING | SHADER_SKINNING))) {
+			activeFeatures = objectFeatures;
+		}
+		bool shadows = (activeFeatures & (SHADER_SHADOWS_HARD | SHADER_SHADOWS_PCF)) != 0;
+		Shader &targetDepth = targetBatch->isSkinned() ? skinnedInstancedDepthShader : instancedDepthShader;
+		if (shadows) {
+			if (skinnedDepth != nullptr) {
+				skinnedDepth->use();
+				skinnedDepth->setMat4("lightSpaceMatrix", lightSpaceMatrix);
+			}
+			targetDepth.use();
+			targetDepth.setMat4("lightSpaceMatrix", lightSpaceMatrix);
+			simpleDepthShader.use();
+			simpleDepthShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
+			GLState::viewport(
+				0,
+				0,
+				SHADOW_WIDTH,
+				SHADOW_HEIGHT
+			);
+			GLState::bindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+			glClear(GL_DEPTH_BUFFER_BIT);
+			dev::renderScene(simpleDepthShader, false, SHADOW_LOD_BIAS, false, skinnedDepth);
+			targetBatch->draw(targetDepth, false, SHADOW_LOD_BIAS);
+			GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+		}
+		GLState::viewport(
 			0,
 			0,
-			SCR_WIDTH,
-			SCR_HEIGHT
+			framebuffer.getRenderWidth(),
+			framebuffer.getRenderHeight()
 		);
 		framebuffer.bindMSAAFBO();
 		glClearColor(
@@ -1008,60 +1694,76 @@ int main() {
 			1.0f
 		);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glEnable(GL_DEPTH_TEST);
-		glDepthFunc(GL_LESS);
-		objectShader.use();
-		glm::mat4 projection = glm::perspective(glm::radians(camera->Zoom), static_cast<float>(SCR_WIDTH) / static_cast<float>(SCR_HEIGHT), 0.1f, 100.0f);
-		glm::mat4 view = camera->GetViewMatrix();
-		objectShader.setMat4("projection", projection);
-		objectShader.setMat4("view", view);
-
-		// set light uniforms
-		objectShader.setVec3("viewPos", camera->Position);
-		objectShader.setVec3("lightPos", lightPos);
-		objectShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, woodTexture);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, depthMap);
-		dev::renderScene(objectShader);
-		glm::mat4 model;
-		model = glm::translate(model, glm::vec3(
-											0.0f,
-											0.0f, 
-											0.0f
-										));
-		objectShader.setMat4("model", model);
-		target.draw(objectShader);
-		glDepthFunc(GL_LEQUAL);
-		skybox.useShader();
+
+		// 2. depth pre-pass, lays down the depth so the main pass shades every pixel only once
+		if (depthPrepass) {
+			if (skinnedDepth != nullptr) {
+				skinnedDepth->use();
+				skinnedDepth->setMat4("lightSpaceMatrix", viewProjection);
+			}
+			targetDepth.use();
+			targetDepth.setMat4("lightSpaceMatrix", viewProjection);
+			simpleDepthShader.use();
+			simpleDepthShader.setMat4("lightSpaceMatrix", viewProjection);
+			GLState::colorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			dev::renderScene(simpleDepthShader, false, 0, true, skinnedDepth);
+			targetBatch->draw(targetDepth, false, 0, true);
+			GLState::colorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			GLState::depthFunc(GL_EQUAL);
+			GLState::depthMask(GL_FALSE);
+		}
+		else {
+			dev::sortScene(camera->Position);
+		}
+
+		// 3. main pass
+		Shader &objectShader = objectShaders.get(activeFeatures);
+		Shader *skinnedObjectShader = nullptr;
+		if (skinnedDepth != nullptr) {
+			skinnedObjectShader = &objectShaders.get(activeFeatures | SHADER_SKINNING);
+			dev::setObjectUniforms(*skinnedObjectShader, viewProjection, lightSpaceMatrix, shadows);
+		}
+		Shader &instancedObjectShader = objectShaders.get(activeFeatures | SHADER_INSTANCING | (targetBatch->isSkinned() ? SHADER_SKINNING : 0));
+		dev::setObjectUniforms(instancedObjectShader, viewProjection, lightSpaceMatrix, shadows);
+		dev::setObjectUniforms(objectShader, viewProjection, lightSpaceMatrix, shadows);
+		if (shadows) {
+			GLState::bindTexture(SHADOW_MAP_UNIT, GL_TEXTURE_2D, depthMap);
+		}
+		dev::renderScene(objectShader, true, 0, true, skinnedObjectShader);
+		targetBatch->draw(instancedObjectShader, true, 0, true);
+		GLState::depthFunc(GL_LEQUAL);
+		decals->draw(viewProjection);
+		GLState::depthMask(GL_TRUE);
+		GLState::depthFunc(GL_LEQUAL);
 		skybox.setUniforms(
 			camera,
-			SCR_WIDTH,
-			SCR_HEIGHT
+			windowWidth,
+			windowHeight
 		);
 		skybox.bindVAO();
 		skybox.bindTexture();
 		skybox.draw();
-		glBindVertexArray(0);
+		particles->draw(viewProjection, camera->Position, camera->Right, camera->Up);
+		GLState::depthMask(GL_TRUE);
 
-		framebuffer.blit(SCR_WIDTH, SCR_HEIGHT);
-		framebuffer.draw();
+		framebuffer.present();
+		frameCapture->capture(windowWidth, windowHeight, currentFrame);
 
 		debugDepthQuad.use();
 		debugDepthQuad.setFloat("near_plane", near_plane);
 		debugDepthQuad.setFloat("far_plane", far_plane);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, depthMap);
+		GLState::bindTexture(0, GL_TEXTURE_2D, depthMap);
 		//renderQuad();
 
 		if (counter % 10 == 0) {
 			printFPS = static_cast<int>(fps);
 		}
+		double pollStart = glfwGetTime();
 		glfwPollEvents();
+		previousPoll = pollStart;
 		dev::RenderText(
 			glyphShader,
-			"FPS:" + std::to_string(printFPS),
+			FrameArena::format("FPS:%d", printFPS).c_str(),
 			25.0f,
 			25.0f,
 			1.0f,
@@ -1071,11 +1773,38 @@ int main() {
 				1.0f
 			)
 		);
+		if (showRenderStats) {
+			dev::renderStats(glyphShader, 25.0f, 60.0f);
+		}
+		StreamBuffer::get().endFrame();
+		gpuTimer.end();
 		glfwSwapBuffers(window);
 	}
 	delete camera;
 
 	// shut everything down
+	for (unsigned int i = 0; i < models.size(); i++) {
+		delete models[i];
+	}
+	GLState::deleteTextures(1, &woodTexture);
+	frameCapture->shutdown();
+	delete frameCapture;
+	delete occlusionCuller;
+	delete targetBatch;
+	delete targetMotion;
+	delete hitRegistration;
+	delete ballistics;
+	delete sceneIndex;
+	delete targetIndex;
+	delete decals;
+	delete particles;
+	// the framebuffer lives on the stack, but its targets were resized after the baseline
+	framebuffer.release();
+	BonePalette::shutdown();
+	GeometryArena::shutdown();
+	JobSystem::shutdown();
+	ClickTimer::stop();
+	GPUMemory::reportLeaks();
 	glfwTerminate();
 	dev::stopEventLog();
 	dev::stopLog();
@@ -1,136 +1,160 @@
 #include "Mesh.hpp"
+#include "FrameArena.hpp"
+
+static const float LOD_MAX_ERROR			= 0.05f;	// relative to the mesh size
+static const unsigned int LOD_MIN_INDICES	= 3 * 64;
+
+/*
+*	Constructor, takes over the imported geometry without copying it and builds the bounds and 
+*	the LOD chain. Nothing is uploaded yet.
+*/
+Mesh::Mesh(std::vector<Vertex> &&vertices, std::vector<unsigned int> &&indices, std::vector<Texture> &&textures)
+	: vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), lodCount(1) {
+	computeBounds();
+	generateLODs();
+}
 
 /*
-*	Constructor.
+*	Renders the mesh at the given level of detail.
 *	
 */
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures) {
-	this->vertices = vertices;
-	this->indices = indices;
-	this->textures = textures;
-	setupMesh();
+void Mesh::draw(const Shader &shader, unsigned int lod) {
+	bindTextures(shader);
+	GeometryArena::get().draw(getLOD(lod));
 }
 
 /*
-*	Renders the mesh.
+*	Returns the geometry of a level of detail, levels past the end of the chain use the coarsest one.
 *	
 */
-void Mesh::draw(Shader shader) {
-	unsigned int diffuseNr		= 1;
-	unsigned int specularNr		= 1;
-	unsigned int normalNr		= 1;
-	unsigned int heightNr		= 1;
+const GeometryRange &Mesh::getLOD(unsigned int lod) const {
+	return lods[lod < lodCount ? lod : lodCount - 1];
+}
+
+/*
+*	Binds the mesh's textures to the units of their roles, independent of the order they were 
+*	loaded in, and points the shader's material samplers at them.
+*/
+void Mesh::bindTextures(const Shader &shader) {
+	static const struct {
+		const char *type;
+		GLuint unit;
+	} roles[] = {
+		{ "material.texture_diffuse",	TEXTURE_UNIT_DIFFUSE },
+		{ "material.texture_normal",	TEXTURE_UNIT_NORMAL },
+		{ "material.texture_specular",	TEXTURE_UNIT_SPECULAR },
+		{ "material.texture_height",	TEXTURE_UNIT_HEIGHT }
+	};
+	static const unsigned int ROLE_COUNT = sizeof(roles) / sizeof(roles[0]);
+	unsigned int counts[ROLE_COUNT] = { 0 };
+	GLuint extra = TEXTURE_UNIT_EXTRA;
 	for (unsigned int i = 0; i < textures.size(); i++) {
-		glActiveTexture(GL_TEXTURE0 + i);
-		std::string number;
-		std::string name = textures[i].type;
-		if (name == "material.texture_diffuse") {
-			number = std::to_string(diffuseNr++);
-		}
-		else if (name == "material.texture_specular") {
-			number = std::to_string(specularNr++);
+		const std::string &name = textures[i].type;
+		unsigned int role = 0;
+		while (role < ROLE_COUNT && name != roles[role].type) {
+			role++;
 		}
-		else if (name == "material.texture_normal") {
-			number = std::to_string(normalNr++);
+		GLuint unit;
+		// built in the frame arena, this runs for every texture of every mesh drawn
+		FrameString uniform;
+		if (role < ROLE_COUNT) {
+			unit = counts[role] == 0 ? roles[role].unit : extra++;
+			uniform = FrameArena::format("%s%u", name.c_str(), ++counts[role]);
 		}
-		else if (name == "material.texture_height") {
-			number = std::to_string(heightNr++);
+		else {
+			unit = extra++;
+			uniform = FrameArena::format("%s", name.c_str());
 		}
-		glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-		glBindTexture(GL_TEXTURE_2D, textures[i].ID);
+		glUniform1i(glGetUniformLocation(shader.ID, uniform.c_str()), unit);
+		RenderStats::countUniform();
+		GLState::bindTexture(unit, GL_TEXTURE_2D, textures[i].ID);
 	}
-	glBindVertexArray(VAO);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
-	glActiveTexture(GL_TEXTURE0);
 }
 
 /*
-*	Initializes all the buffer objects and arrays.
+*	Returns true if both meshes use the same textures, so they can be drawn with one call.
 *	
 */
-void Mesh::setupMesh() {
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(
-		GL_ARRAY_BUFFER, 
-		vertices.size() * sizeof(Vertex), 
-		&vertices[0],
-		GL_STATIC_DRAW
-	);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(
-		GL_ELEMENT_ARRAY_BUFFER, 
-		indices.size() * sizeof(unsigned int), 
-		&indices[0], 
-		GL_STATIC_DRAW
-	);
-	
-	// vertex positions
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(
-		0, 
-		3, 
-		GL_FLOAT, 
-		GL_FALSE, 
-		sizeof(Vertex), 
-		(void*)0
-	);
-	
-	// vertex normals
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(
-		1, 
-		3, 
-		GL_FLOAT, 
-		GL_FALSE, 
-		sizeof(Vertex), 
-		(void*)offsetof(Vertex, normal)
-	);
-
-	// vertex texture coordinates
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(
-		2, 
-		3, 
-		GL_FLOAT, 
-		GL_FALSE, 
-		sizeof(Vertex), 
-		(void*)offsetof(Vertex, texCoords)
-	);
+bool Mesh::sharesMaterial(const Mesh &other) const {
+	if (textures.size() != other.textures.size()) {
+		return false;
+	}
+	for (unsigned int i = 0; i < textures.size(); i++) {
+		if (textures[i].ID != other.textures[i].ID || textures[i].type != other.textures[i].type) {
+			return false;
+		}
+	}
+	return true;
+}
 
-	// vertex tangent
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(
-		3, 
-		3, 
-		GL_FLOAT,
-		GL_FALSE, 
-		sizeof(Vertex), 
-		(void*)offsetof(Vertex, tangent)
+/*
+*	Uploads the vertices, indices and LOD index lists into the shared geometry arena. The CPU-side
+*	copies are dropped afterwards if GPUMemory is set to release them, the LOD lists always are.
+*/
+void Mesh::upload() {
+	lods[0] = GeometryArena::get().allocate(
+		&vertices[0],
+		static_cast<GLuint>(vertices.size()),
+		&indices[0],
+		static_cast<GLuint>(indices.size())
 	);
+	for (unsigned int lod = 1; lod < lodCount; lod++) {
+		lods[lod] = GeometryArena::get().allocateIndices(
+			lods[0],
+			&lodIndices[lod][0],
+			static_cast<GLuint>(lodIndices[lod].size())
+		);
+		std::vector<unsigned int>().swap(lodIndices[lod]);
+	}
+	if (GPUMemory::getReleaseCPUCopies()) {
+		std::vector<Vertex>().swap(vertices);
+		std::vector<unsigned int>().swap(indices);
+	}
+}
 
-	// vertex bitangent
-	glEnableVertexAttribArray(4);
-	glVertexAttribPointer(
-		4, 
-		3, 
-		GL_FLOAT,
-		GL_FALSE,
-		sizeof(Vertex),
-		(void*)offsetof(Vertex, bitangent)
-	);
-	
-	glBindVertexArray(0);
+/*
+*	Simplifies every level from the previous one to about half its triangles. The chain ends early 
+*	once a level would exceed the error bound or barely shrink, e.g. because most vertices sit on seams.
+*/
+void Mesh::generateLODs() {
+	for (unsigned int lod = 1; lod < MAX_LODS; lod++) {
+		const std::vector<unsigned int> &source = lod == 1 ? indices : lodIndices[lod - 1];
+		GLuint target = static_cast<GLuint>(source.size() / 2 / 3 * 3);
+		if (target < LOD_MIN_INDICES) {
+			break;
+		}
+		MeshSimplifier::simplify(
+			&vertices[0],
+			static_cast<GLuint>(vertices.size()),
+			&source[0],
+			static_cast<GLuint>(source.size()),
+			target,
+			LOD_MAX_ERROR,
+			lodIndices[lod]
+		);
+		if (lodIndices[lod].size() > source.size() * 3 / 4) {
+			std::vector<unsigned int>().swap(lodIndices[lod]);
+			break;
+		}
+		lodCount++;
+	}
 }
 
 /*
-*	Destructor.
+*	Computes a bounding sphere around the center of the mesh's bounding box.
 *	
 */
-Mesh::~Mesh() {
-
+void Mesh::computeBounds() {
+	glm::vec3 minimum = vertices[0].position, maximum = vertices[0].position;
+	for (unsigned int i = 1; i < vertices.size(); i++) {
+		minimum = glm::min(minimum, vertices[i].position);
+		maximum = glm::max(maximum, vertices[i].position);
+	}
+	boundsCenter = (minimum + maximum) * 0.5f;
+	boundsRadius = 0.0f;
+	for (unsigned int i = 0; i < vertices.size(); i++) {
+		glm::vec3 offset = vertices[i].position - boundsCenter;
+		boundsRadius = glm::max(boundsRadius, glm::dot(offset, offset));
+	}
+	boundsRadius = glm::sqrt(boundsRadius);
 }
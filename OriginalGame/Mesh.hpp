@@ -8,6 +8,10 @@
 #include <string>
 #include <vector>
 #include "Shader.hpp"
+#include "GeometryArena.hpp"
+#include "MeshSimplifier.hpp"
+
+static const unsigned int MAX_BONE_INFLUENCES = 4;
 
 struct Vertex {
 	glm::vec3 position;
@@ -15,6 +19,18 @@ struct Vertex {
 	glm::vec2 texCoords;
 	glm::vec3 tangent;
 	glm::vec3 bitangent;
+	unsigned char boneIDs[MAX_BONE_INFLUENCES];		// into the model's bone table, unused slots have weight 0
+	float boneWeights[MAX_BONE_INFLUENCES];			// sum up to 1 for skinned meshes, all 0 otherwise
+};
+
+// units textures are bound to by role, the first texture of a role gets its unit, further ones
+// (and unknown roles) the units from TEXTURE_UNIT_EXTRA on
+enum TextureUnit {
+	TEXTURE_UNIT_DIFFUSE	= 0,
+	TEXTURE_UNIT_NORMAL		= 1,
+	TEXTURE_UNIT_SPECULAR	= 2,
+	TEXTURE_UNIT_HEIGHT		= 3,
+	TEXTURE_UNIT_EXTRA		= 4
 };
 
 struct Texture {
@@ -23,18 +39,35 @@ struct Texture {
 	std::string path;
 };
 
+/*
+*	A mesh of an imported model. Its geometry lives in the geometry arena together with a chain of 
+*	simplified index lists, lods[0] is the full mesh. The bounds are a sphere in mesh space.
+*	Construction only does CPU work and may run on any thread, upload() needs the GL context.
+*/
 class Mesh
 {
 public:
+	static const unsigned int MAX_LODS = 4;
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
 	std::vector<Texture> textures;
-	unsigned int VAO;
-	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
-	void draw(Shader shader);
-	~Mesh();
+	GeometryRange lods[MAX_LODS];
+	unsigned int lodCount;
+	glm::vec3 boundsCenter;
+	float boundsRadius;
+	Mesh(std::vector<Vertex> &&vertices, std::vector<unsigned int> &&indices, std::vector<Texture> &&textures);
+	Mesh(Mesh &&other) = default;
+	Mesh &operator=(Mesh &&other) = default;
+	Mesh(const Mesh&) = delete;
+	Mesh &operator=(const Mesh&) = delete;
+	void upload(void);
+	void draw(const Shader &shader, unsigned int lod = 0);
+	const GeometryRange &getLOD(unsigned int lod) const;
+	void bindTextures(const Shader &shader);
+	bool sharesMaterial(const Mesh &other) const;
 private:
-	unsigned int VBO, EBO;
-	void setupMesh(void);
+	std::vector<unsigned int> lodIndices[MAX_LODS];
+	void generateLODs(void);
+	void computeBounds(void);
 };
 
@@ -0,0 +1,252 @@
+#include "MeshSimplifier.hpp"
+#include "Mesh.hpp"
+#include <algorithm>
+#include <cmath>
+
+/*
+*	Simplifies the triangle list until it has at most targetIndexCount indices or no collapse stays
+*	below maxError, writes the new indices to result and returns the largest error it introduced.
+*/
+float MeshSimplifier::simplify(const Vertex *vertices, GLuint vertexCount, const GLuint *indices, GLuint indexCount, GLuint targetIndexCount, float maxError, std::vector<GLuint> &result) {
+	result.assign(indices, indices + indexCount);
+	if (vertexCount == 0) {
+		return 0.0f;
+	}
+
+	// errors are measured relative to the bounding box diagonal
+	glm::vec3 minimum = vertices[0].position, maximum = vertices[0].position;
+	for (GLuint i = 1; i < vertexCount; i++) {
+		minimum = glm::min(minimum, vertices[i].position);
+		maximum = glm::max(maximum, vertices[i].position);
+	}
+	float extent = glm::length(maximum - minimum);
+	if (extent == 0.0f) {
+		return 0.0f;
+	}
+	float costLimit = maxError * extent * maxError * extent;
+
+	// vertices that only differ in their attributes share a position id
+	std::vector<GLuint> order(vertexCount);
+	for (GLuint i = 0; i < vertexCount; i++) {
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [vertices](GLuint a, GLuint b) {
+		const glm::vec3 &pa = vertices[a].position;
+		const glm::vec3 &pb = vertices[b].position;
+		return pa.x < pb.x || (pa.x == pb.x && (pa.y < pb.y || (pa.y == pb.y && pa.z < pb.z)));
+	});
+	std::vector<GLuint> position(vertexCount);
+	std::vector<GLuint> wedges(vertexCount, 0);
+	for (GLuint i = 0; i < vertexCount; i++) {
+		bool same = i > 0 && vertices[order[i]].position == vertices[order[i - 1]].position;
+		position[order[i]] = same ? position[order[i - 1]] : order[i];
+		wedges[position[order[i]]]++;
+	}
+
+	// lock seam vertices and vertices on open or non-manifold edges
+	std::vector<bool> locked(vertexCount, false);
+	for (GLuint i = 0; i < vertexCount; i++) {
+		locked[i] = wedges[position[i]] > 1;
+	}
+	std::vector<unsigned long long> edges;
+	edges.reserve(indexCount);
+	for (GLuint i = 0; i + 2 < indexCount; i += 3) {
+		for (GLuint k = 0; k < 3; k++) {
+			unsigned long long a = position[indices[i + k]];
+			unsigned long long b = position[indices[i + (k + 1) % 3]];
+			edges.push_back(a << 32 | b);
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	for (size_t i = 0; i < edges.size(); i++) {
+		GLuint a = static_cast<GLuint>(edges[i] >> 32);
+		GLuint b = static_cast<GLuint>(edges[i] & 0xFFFFFFFF);
+		unsigned long long reverse = static_cast<unsigned long long>(b) << 32 | a;
+		bool duplicate = (i > 0 && edges[i - 1] == edges[i]) || (i + 1 < edges.size() && edges[i + 1] == edges[i]);
+		if (duplicate || !std::binary_search(edges.begin(), edges.end(), reverse)) {
+			locked[a] = true;
+			locked[b] = true;
+		}
+	}
+	for (GLuint i = 0; i < vertexCount; i++) {
+		if (locked[position[i]]) {
+			locked[i] = true;
+		}
+	}
+
+	// one quadric per position, built from the area weighted planes of its triangles
+	std::vector<Quadric> quadrics(vertexCount, Quadric());
+	for (GLuint i = 0; i + 2 < indexCount; i += 3) {
+		const glm::vec3 &p0 = vertices[indices[i]].position;
+		const glm::vec3 &p1 = vertices[indices[i + 1]].position;
+		const glm::vec3 &p2 = vertices[indices[i + 2]].position;
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float area = glm::length(normal);
+		if (area == 0.0f) {
+			continue;
+		}
+		normal /= area;
+		for (GLuint k = 0; k < 3; k++) {
+			addPlane(quadrics[position[indices[i + k]]], normal, -glm::dot(normal, p0), area * 0.5f);
+		}
+	}
+
+	std::vector<GLuint> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<GLuint> adjacencyOffsets(vertexCount + 1);
+	std::vector<GLuint> adjacency;
+	std::vector<Collapse> collapses;
+	float maxCost = 0.0f;
+	while (result.size() > targetIndexCount) {
+		// triangles around each vertex
+		GLuint resultCount = static_cast<GLuint>(result.size());
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (GLuint i = 0; i < resultCount; i++) {
+			adjacencyOffsets[result[i] + 1]++;
+		}
+		for (GLuint i = 0; i < vertexCount; i++) {
+			adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+		}
+		adjacency.resize(resultCount);
+		std::vector<GLuint> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (GLuint i = 0; i < resultCount; i++) {
+			adjacency[fill[result[i]]++] = i / 3;
+		}
+
+		// every edge in both directions, cheapest first
+		collapses.clear();
+		for (GLuint i = 0; i < resultCount; i += 3) {
+			for (GLuint k = 0; k < 3; k++) {
+				GLuint a = result[i + k];
+				GLuint b = result[i + (k + 1) % 3];
+				Quadric sum = quadrics[position[a]];
+				addQuadric(sum, quadrics[position[b]]);
+				if (!locked[a]) {
+					float cost = static_cast<float>(evaluate(sum, vertices[b].position));
+					if (cost <= costLimit) {
+						collapses.push_back({ a, b, cost });
+					}
+				}
+				if (!locked[b]) {
+					float cost = static_cast<float>(evaluate(sum, vertices[a].position));
+					if (cost <= costLimit) {
+						collapses.push_back({ b, a, cost });
+					}
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) {
+			return a.cost < b.cost;
+		});
+
+		// collapse as many independent edges as needed, every collapse removes about two triangles
+		GLuint limit = std::max<GLuint>(1, (resultCount - targetIndexCount) / 6);
+		GLuint done = 0;
+		for (GLuint i = 0; i < vertexCount; i++) {
+			remap[i] = i;
+		}
+		std::fill(touched.begin(), touched.end(), false);
+		for (size_t i = 0; i < collapses.size() && done < limit; i++) {
+			const Collapse &collapse = collapses[i];
+			if (touched[collapse.from] || touched[collapse.to]) {
+				continue;
+			}
+			const GLuint *adjacent = &adjacency[adjacencyOffsets[collapse.from]];
+			GLuint adjacentCount = adjacencyOffsets[collapse.from + 1] - adjacencyOffsets[collapse.from];
+			if (flips(vertices, &result[0], adjacent, adjacentCount, collapse.from, collapse.to)) {
+				continue;
+			}
+			// the neighbourhood must stay put for the flip test above to hold
+			for (GLuint j = 0; j < adjacentCount; j++) {
+				for (GLuint k = 0; k < 3; k++) {
+					touched[result[adjacent[j] * 3 + k]] = true;
+				}
+			}
+			remap[collapse.from] = collapse.to;
+			addQuadric(quadrics[position[collapse.to]], quadrics[position[collapse.from]]);
+			maxCost = std::max(maxCost, collapse.cost);
+			done++;
+		}
+		if (done == 0) {
+			break;
+		}
+
+		// drop the triangles that became degenerate
+		GLuint write = 0;
+		for (GLuint i = 0; i < resultCount; i += 3) {
+			GLuint a = remap[result[i]];
+			GLuint b = remap[result[i + 1]];
+			GLuint c = remap[result[i + 2]];
+			if (a != b && b != c && a != c) {
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+		}
+		result.resize(write);
+	}
+	return std::sqrt(maxCost) / extent;
+}
+
+/*
+*	Adds the quadric of a plane (normal, distance), weighted by the area of the triangle it came from.
+*	
+*/
+void MeshSimplifier::addPlane(Quadric &quadric, const glm::vec3 &normal, float distance, float weight) {
+	double a = normal.x, b = normal.y, c = normal.z, d = distance;
+	double *m = quadric.m;
+	m[0] += weight * a * a; m[1] += weight * a * b; m[2] += weight * a * c; m[3] += weight * a * d;
+	m[4] += weight * b * b; m[5] += weight * b * c; m[6] += weight * b * d;
+	m[7] += weight * c * c; m[8] += weight * c * d;
+	m[9] += weight * d * d;
+	quadric.weight += weight;
+}
+
+/*
+*	Accumulates another quadric into this one.
+*	
+*/
+void MeshSimplifier::addQuadric(Quadric &quadric, const Quadric &other) {
+	for (unsigned int i = 0; i < 10; i++) {
+		quadric.m[i] += other.m[i];
+	}
+	quadric.weight += other.weight;
+}
+
+/*
+*	Returns the mean squared distance of p to the quadric's planes, weighted by their area.
+*	
+*/
+double MeshSimplifier::evaluate(const Quadric &quadric, const glm::vec3 &p) {
+	const double *m = quadric.m;
+	double x = p.x, y = p.y, z = p.z;
+	double error = m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x
+		+ m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y
+		+ m[7] * z * z + 2.0 * m[8] * z
+		+ m[9];
+	return error > 0.0 && quadric.weight > 0.0 ? error / quadric.weight : 0.0;
+}
+
+/*
+*	Returns true if moving vertex from onto vertex to would turn one of the surrounding triangles 
+*	over or collapse it to a line.
+*/
+bool MeshSimplifier::flips(const Vertex *vertices, const GLuint *triangles, const GLuint *adjacent, GLuint adjacentCount, GLuint from, GLuint to) {
+	for (GLuint i = 0; i < adjacentCount; i++) {
+		const GLuint *triangle = &triangles[adjacent[i] * 3];
+		if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+			continue;
+		}
+		glm::vec3 before[3], after[3];
+		for (GLuint k = 0; k < 3; k++) {
+			before[k] = vertices[triangle[k]].position;
+			after[k] = triangle[k] == from ? vertices[to].position : before[k];
+		}
+		glm::vec3 oldNormal = glm::cross(before[1] - before[0], before[2] - before[0]);
+		glm::vec3 newNormal = glm::cross(after[1] - after[0], after[2] - after[0]);
+		if (glm::dot(oldNormal, newNormal) <= 0.0f) {
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+struct Vertex;
+
+/*
+*	Quadric error mesh simplification (Garland & Heckbert) by half-edge collapses, used to build the 
+*	LOD chains of imported meshes. Vertices are only ever moved onto existing vertices, so the result 
+*	is a new index buffer into the unchanged vertex buffer. Vertices on UV seams and open borders are 
+*	never collapsed, which keeps texture seams and silhouettes of open meshes intact. Errors are 
+*	distances relative to the size of the mesh.
+*/
+class MeshSimplifier
+{
+public:
+	static float simplify(
+		const Vertex *vertices,
+		GLuint vertexCount,
+		const GLuint *indices,
+		GLuint indexCount,
+		GLuint targetIndexCount,
+		float maxError,
+		std::vector<GLuint> &result
+	);
+private:
+	struct Quadric {
+		double m[10];		// upper triangle of the symmetric 4x4 matrix
+		double weight;		// summed area of the planes
+	};
+	struct Collapse {
+		GLuint from;
+		GLuint to;
+		float cost;
+	};
+	static void addPlane(Quadric &quadric, const glm::vec3 &normal, float distance, float weight);
+	static void addQuadric(Quadric &quadric, const Quadric &other);
+	static double evaluate(const Quadric &quadric, const glm::vec3 &p);
+	static bool flips(const Vertex *vertices, const GLuint *triangles, const GLuint *adjacent, GLuint adjacentCount, GLuint from, GLuint to);
+};
+
@@ -1,66 +1,497 @@
 #include "Model.hpp"
+#include "JobSystem.hpp"
+
+// screen height fraction below which a model switches to the next coarser level, and the
+// band around each threshold in which it keeps its current level to avoid popping back and forth
+static const float LOD_SCREEN_SIZES[Mesh::MAX_LODS - 1]	= { 0.5f, 0.25f, 0.125f };
+static const float LOD_HYSTERESIS						= 0.15f;
+
+/*
+*	Constructor, expects filepath to a 3D-model. Loads it right away, to load several models 
+*	at once use ModelLoader.
+*/
+Model::Model(std::string const &path, bool gamma) 
+	: gammaCorrection(gamma), lodCount(1), boundsCenter(0.0f), boundsRadius(0.0f), drawGroupsDirty(true) {
+	import(path);
+	upload();
+}
 
 /*
-*	Constructor, expects filepath to a 3D-model.
+*	Constructor for ModelLoader, which calls import() and upload() itself.
 *	
 */
-Model::Model(std::string const &path, bool gamma) : gammaCorrection(gamma) {
-	loadModel(path);
-	dev::eventLog("Model successfully loaded");
+Model::Model() 
+	: gammaCorrection(false), lodCount(1), boundsCenter(0.0f), boundsRadius(0.0f), drawGroupsDirty(true) {
+
 }
 
 /*
-*	Renders the model mesh by mesh.
+*	Renders the model mesh by mesh with the model placed at the origin.
 *	
 */
-void Model::draw(Shader shader) {
-	for (unsigned int i = 0; i < meshes.size(); i++) {
-		meshes[i].draw(shader);
+void Model::draw(const Shader &shader) {
+	draw(shader, glm::mat4());
+}
+
+/*
+*	Renders the model group by group: meshes of all nodes with the same world transform share one 
+*	model matrix and are ordered by material, so every run of meshes with the same textures is one 
+*	multi-draw (without textures, for depth-only passes, the whole group is). Skinned models drawn 
+*	with a palette (and a skinning shader) get their node transforms from the palette instead.
+*/
+void Model::draw(const Shader &shader, const glm::mat4 &model, bool textured, unsigned int lod, GLint paletteOffset) {
+	bool skinned = paletteOffset >= 0;
+	if (skinned) {
+		shader.setMat4("model", model);
+		shader.setInt("paletteOffset", paletteOffset);
+	}
+	updateDrawGroups();
+	for (unsigned int i = 0; i < drawGroups.size(); i++) {
+		const DrawGroup &group = drawGroups[i];
+		if (!skinned) {
+			shader.setMat4("model", model * hierarchy.nodes[group.node].world);
+		}
+		unsigned int end = group.first + group.count;
+		for (unsigned int j = group.first; j < end; ) {
+			const Mesh &first = meshes[drawOrder[j]];
+			unsigned int k = j + 1;
+			while (k < end && (!textured || meshes[drawOrder[k]].sharesMaterial(first))) {
+				k++;
+			}
+			if (textured && k - j == 1) {
+				meshes[drawOrder[j]].draw(shader, lod);
+			}
+			else {
+				batch.clear();
+				for (unsigned int m = j; m < k; m++) {
+					batch.push_back(meshes[drawOrder[m]].getLOD(lod));
+				}
+				if (textured) {
+					meshes[drawOrder[j]].bindTextures(shader);
+				}
+				GeometryArena::get().multiDraw(&batch[0], static_cast<GLsizei>(batch.size()));
+			}
+			j = k;
+		}
+	}
+}
+
+/*
+*	Returns true if the model has bones, it then needs an Animator and a skinning shader to move.
+*	
+*/
+bool Model::isSkinned() const {
+	return !bones.empty();
+}
+
+/*
+*	Renders instanceCount copies of the model with an INSTANCING shader, after the instance matrices 
+*	were bound with GeometryArena::bindInstances. Every mesh is one instanced draw, textures are only 
+*	bound where the material changes. skinned instances get their node transforms from their palettes.
+*/
+void Model::drawInstanced(const Shader &shader, GLsizei instanceCount, bool textured, unsigned int lod, bool skinned) {
+	if (skinned) {
+		shader.setMat4("model", glm::mat4());
+	}
+	updateDrawGroups();
+	for (unsigned int i = 0; i < drawGroups.size(); i++) {
+		const DrawGroup &group = drawGroups[i];
+		if (!skinned) {
+			shader.setMat4("model", hierarchy.nodes[group.node].world);
+		}
+		for (unsigned int j = group.first; j < group.first + group.count; j++) {
+			Mesh &mesh = meshes[drawOrder[j]];
+			if (textured && (j == group.first || !mesh.sharesMaterial(meshes[drawOrder[j - 1]]))) {
+				mesh.bindTextures(shader);
+			}
+			GeometryArena::get().drawInstanced(mesh.getLOD(lod), instanceCount);
+		}
 	}
 }
 
 /*
-*	Loads a model with supported ASSIMP formats from the specified filepath 
-*	and stores the resulting meshes in the meshes vector.
+*	Picks the level of detail for an instance from the fraction of the screen height its bounding 
+*	sphere covers. projectionScale is projection[1][1], current the level used last frame.
 */
-void Model::loadModel(std::string const &path) {
+unsigned int Model::selectLOD(const glm::mat4 &model, const glm::vec3 &viewPos, float projectionScale, unsigned int current) const {
+	glm::vec3 center = glm::vec3(model * glm::vec4(boundsCenter, 1.0f));
+	float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	float radius = boundsRadius * scale;
+	float distance = glm::length(center - viewPos);
+	if (distance <= radius) {
+		return 0;
+	}
+	float screenSize = radius * projectionScale / distance;
+	unsigned int lod = current < lodCount ? current : lodCount - 1;
+	while (lod + 1 < lodCount && screenSize < LOD_SCREEN_SIZES[lod] * (1.0f - LOD_HYSTERESIS)) {
+		lod++;
+	}
+	while (lod > 0 && screenSize > LOD_SCREEN_SIZES[lod - 1] * (1.0f + LOD_HYSTERESIS)) {
+		lod--;
+	}
+	return lod;
+}
+
+/*
+*	Sets the transform of a named node relative to its parent, e.g. to articulate a limb.
+*	
+*/
+void Model::setNodeTransform(const std::string &name, const glm::mat4 &local) {
+	int node = hierarchy.findNode(name);
+	if (node < 0) {
+		dev::eventLog("Model node not found: " + name);
+		return;
+	}
+	hierarchy.setLocalTransform(node, local);
+	drawGroupsDirty = true;
+}
+
+/*
+*	Updates the world transforms and, after a node moved, regroups the meshes: nodes with equal 
+*	world transforms are merged into one group and each group's meshes are ordered by material.
+*/
+void Model::updateDrawGroups() {
+	hierarchy.update();
+	if (!drawGroupsDirty) {
+		return;
+	}
+	drawGroupsDirty = false;
+	drawGroups.clear();
+	drawOrder.clear();
+	std::vector<std::vector<unsigned int>> groupMeshes;
+	for (unsigned int i = 0; i < hierarchy.nodes.size(); i++) {
+		const SceneNode &node = hierarchy.nodes[i];
+		if (node.meshCount == 0) {
+			continue;
+		}
+		unsigned int g = 0;
+		while (g < drawGroups.size() && hierarchy.nodes[drawGroups[g].node].world != node.world) {
+			g++;
+		}
+		if (g == drawGroups.size()) {
+			DrawGroup group = { i, 0, 0 };
+			drawGroups.push_back(group);
+			groupMeshes.push_back(std::vector<unsigned int>());
+		}
+		for (unsigned int j = node.firstMesh; j < node.firstMesh + node.meshCount; j++) {
+			groupMeshes[g].push_back(j);
+		}
+	}
+	for (unsigned int g = 0; g < drawGroups.size(); g++) {
+		std::vector<unsigned int> &pending = groupMeshes[g];
+		drawGroups[g].first = static_cast<unsigned int>(drawOrder.size());
+		drawGroups[g].count = static_cast<unsigned int>(pending.size());
+		// take the first unplaced mesh and everything else with its material, until none are left
+		std::vector<unsigned char> placed(pending.size(), 0);
+		for (unsigned int j = 0; j < pending.size(); j++) {
+			if (placed[j]) {
+				continue;
+			}
+			for (unsigned int k = j; k < pending.size(); k++) {
+				if (!placed[k] && meshes[pending[k]].sharesMaterial(meshes[pending[j]])) {
+					drawOrder.push_back(pending[k]);
+					placed[k] = 1;
+				}
+			}
+		}
+	}
+}
+
+/*
+*	Loads a model with supported ASSIMP formats from the specified filepath and converts it, without
+*	touching GL, so it can run on any thread. Meshes are converted and images decoded in parallel.
+*/
+void Model::import(std::string const &path) {
 	Assimp::Importer importer;
 	const aiScene *scene = importer.ReadFile(path, 
 		aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-		dev::showConsoleWindow();
-		std::string error = importer.GetErrorString();
-		std::cout << "ERROR::ASSIMP::" << error << std::endl;
-		dev::error("ERROR::ASSIMP::" + error);
+		importError = importer.GetErrorString();
 		return;
 	}
 	directory = path.substr(0, path.find_last_of('/'));
-	processNode(scene->mRootNode, scene);
+	std::vector<const aiMesh*> sources;
+	std::vector<std::vector<Texture>> sourceTextures;
+	processNode(scene->mRootNode, scene, sources, sourceTextures);
+	hierarchy.update();
+	std::vector<int> nodeBones;
+	registerBones(sources, nodeBones);
+	if (!importError.empty()) {
+		return;
+	}
+	loadAnimations(scene);
+
+	std::vector<std::unique_ptr<Mesh>> converted(sources.size());
+	JobSystem::parallelFor(static_cast<unsigned int>(sources.size()), 1, [&](unsigned int i) {
+		converted[i].reset(new Mesh(processMesh(sources[i], std::move(sourceTextures[i]), nodeBones[i])));
+	});
+	boneLookup.clear();
+	meshes.reserve(converted.size());
+	for (unsigned int i = 0; i < converted.size(); i++) {
+		meshes.push_back(std::move(*converted[i]));
+	}
+
+	decodedImages.resize(textures_loaded.size());
+	JobSystem::parallelFor(static_cast<unsigned int>(textures_loaded.size()), 1, [&](unsigned int i) {
+		std::string filename = directory + '/' + textures_loaded[i].path;
+		DecodedImage &image = decodedImages[i];
+		image.data = stbi_load(filename.c_str(), &image.width, &image.height, &image.components, 0);
+	});
+	computeBounds();
+	buildCollision();
 }
 
 /*
-*	Processes each of ASSIMP's nodes in a recursive fashion.
-*	
+*	Creates the GL objects of an imported model: its textures and its geometry in the arena. 
+*	Has to run on the render thread, import errors are reported from here as well.
+*/
+void Model::upload() {
+	if (!importError.empty()) {
+		dev::showConsoleWindow();
+		std::cout << "ERROR::ASSIMP::" << importError << std::endl;
+		dev::error("ERROR::ASSIMP::" + importError);
+		return;
+	}
+	for (unsigned int i = 0; i < textures_loaded.size(); i++) {
+		const DecodedImage &image = decodedImages[i];
+		textures_loaded[i].ID = dev::textureFromImage(
+			image.data,
+			image.width,
+			image.height,
+			image.components,
+			directory + '/' + textures_loaded[i].path
+		);
+		ownedTextures.push_back(TextureHandle(textures_loaded[i].ID));
+	}
+	decodedImages.clear();
+	for (unsigned int i = 0; i < meshes.size(); i++) {
+		for (unsigned int j = 0; j < meshes[i].textures.size(); j++) {
+			for (unsigned int k = 0; k < textures_loaded.size(); k++) {
+				if (textures_loaded[k].path == meshes[i].textures[j].path) {
+					meshes[i].textures[j].ID = textures_loaded[k].ID;
+					break;
+				}
+			}
+		}
+		meshes[i].upload();
+	}
+	dev::eventLog("Model successfully loaded");
+}
+
+/*
+*	Processes each of ASSIMP's nodes in a recursive fashion. Every node keeps its transformation 
+*	and the range of meshes it owns in the scene graph, the meshes are collected for conversion.
 */
-void Model::processNode(aiNode *node, const aiScene *scene) {
+void Model::processNode(aiNode *node, const aiScene *scene, std::vector<const aiMesh*> &sources, std::vector<std::vector<Texture>> &sourceTextures, int parent) {
+	unsigned int index = hierarchy.addNode(
+		node->mName.C_Str(),
+		parent,
+		toMat4(node->mTransformation)
+	);
+	hierarchy.nodes[index].firstMesh = static_cast<unsigned int>(sources.size());
+	hierarchy.nodes[index].meshCount = node->mNumMeshes;
 	for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-		aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.push_back(processMesh(mesh, scene));
+		const aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
+		aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
+		std::vector<Texture> textures;
+
+		// diffuse, specular, normal and height maps
+		loadMaterialTextures(material, aiTextureType_DIFFUSE, "material.texture_diffuse", textures);
+		loadMaterialTextures(material, aiTextureType_SPECULAR, "material.texture_specular", textures);
+		loadMaterialTextures(material, aiTextureType_AMBIENT, "material.texture_normal", textures);
+		loadMaterialTextures(material, aiTextureType_HEIGHT, "material.texture_height", textures);
+		sources.push_back(mesh);
+		sourceTextures.push_back(std::move(textures));
 	}
 
 	for (unsigned int i = 0; i < node->mNumChildren; i++) {
-		processNode(node->mChildren[i], scene);
+		processNode(node->mChildren[i], scene, sources, sourceTextures, index);
 	}
 }
 
 /*
-*	Processes each of ASSIMP's meshes in a recursive fashion.
+*	Computes the model's bounding sphere from its meshes' spheres placed by their nodes, 
+*	and the length of the longest LOD chain.
+*/
+void Model::computeBounds() {
+	bool empty = true;
+	glm::vec3 minimum, maximum;
+	for (unsigned int i = 0; i < hierarchy.nodes.size(); i++) {
+		const SceneNode &node = hierarchy.nodes[i];
+		float scale = glm::max(glm::length(glm::vec3(node.world[0])), glm::max(glm::length(glm::vec3(node.world[1])), glm::length(glm::vec3(node.world[2]))));
+		for (unsigned int j = node.firstMesh; j < node.firstMesh + node.meshCount; j++) {
+			glm::vec3 center = glm::vec3(node.world * glm::vec4(meshes[j].boundsCenter, 1.0f));
+			glm::vec3 extent = glm::vec3(meshes[j].boundsRadius * scale);
+			minimum = empty ? center - extent : glm::min(minimum, center - extent);
+			maximum = empty ? center + extent : glm::max(maximum, center + extent);
+			empty = false;
+			if (meshes[j].lodCount > lodCount) {
+				lodCount = meshes[j].lodCount;
+			}
+		}
+	}
+	if (!empty) {
+		boundsCenter = (minimum + maximum) * 0.5f;
+		boundsRadius = glm::length(maximum - minimum) * 0.5f;
+	}
+}
+
+/*
+*	Builds the hierarchy hit tests run against from the full detail meshes placed by their nodes. 
+*	Runs during the import, while the meshes still have their CPU-side copies.
+*/
+void Model::buildCollision() {
+	std::vector<glm::vec3> corners;
+	for (unsigned int i = 0; i < hierarchy.nodes.size(); i++) {
+		const SceneNode &node = hierarchy.nodes[i];
+		for (unsigned int j = node.firstMesh; j < node.firstMesh + node.meshCount; j++) {
+			const Mesh &mesh = meshes[j];
+			for (unsigned int k = 0; k < mesh.indices.size() / 3 * 3; k++) {
+				corners.push_back(glm::vec3(node.world * glm::vec4(mesh.vertices[mesh.indices[k]].position, 1.0f)));
+			}
+		}
+	}
+	collision.build(std::move(corners));
+}
+
+/*
+*	Converts ASSIMP's row-major matrix to a column-major glm matrix.
 *	
 */
-Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
+glm::mat4 Model::toMat4(const aiMatrix4x4 &matrix) {
+	glm::mat4 result;
+	result[0][0] = matrix.a1; result[1][0] = matrix.a2; result[2][0] = matrix.a3; result[3][0] = matrix.a4;
+	result[0][1] = matrix.b1; result[1][1] = matrix.b2; result[2][1] = matrix.b3; result[3][1] = matrix.b4;
+	result[0][2] = matrix.c1; result[1][2] = matrix.c2; result[2][2] = matrix.c3; result[3][2] = matrix.c4;
+	result[0][3] = matrix.d1; result[1][3] = matrix.d2; result[2][3] = matrix.d3; result[3][3] = matrix.d4;
+	return result;
+}
+
+/*
+*	Numbers the bones of all meshes before they are converted in parallel. If any mesh is skinned, every
+*	mesh's node becomes a bone as well, which rigid meshes and unweighted vertices are bound to, so one 
+*	skinning shader draws the whole model. nodeBones receives that bone per mesh, -1 where there is none.
+*/
+void Model::registerBones(const std::vector<const aiMesh*> &sources, std::vector<int> &nodeBones) {
+	nodeBones.assign(sources.size(), -1);
+	for (unsigned int i = 0; i < sources.size(); i++) {
+		for (unsigned int j = 0; j < sources[i]->mNumBones; j++) {
+			const aiBone *bone = sources[i]->mBones[j];
+			addBone(bone->mName.C_Str(), toMat4(bone->mOffsetMatrix));
+		}
+	}
+	if (bones.empty()) {
+		return;
+	}
+	for (unsigned int i = 0; i < hierarchy.nodes.size(); i++) {
+		const SceneNode &node = hierarchy.nodes[i];
+		if (node.meshCount == 0) {
+			continue;
+		}
+		// not registered by name, a node bone must not be confused with a skeleton bone of the same name
+		Bone bone;
+		bone.name = node.name;
+		bone.node = static_cast<int>(i);
+		for (unsigned int j = node.firstMesh; j < node.firstMesh + node.meshCount; j++) {
+			nodeBones[j] = static_cast<int>(bones.size());
+		}
+		bones.push_back(bone);
+	}
+	if (bones.size() > MAX_BONES) {
+		importError = "Model has " + std::to_string(bones.size()) + " bones, at most " + std::to_string(MAX_BONES) + " are supported";
+	}
+}
+
+/*
+*	Returns the index of the named bone, adding it on first use.
+*	
+*/
+unsigned int Model::addBone(const std::string &name, const glm::mat4 &offset) {
+	std::map<std::string, unsigned int>::const_iterator found = boneLookup.find(name);
+	if (found != boneLookup.end()) {
+		return found->second;
+	}
+	Bone bone;
+	bone.name = name;
+	bone.node = hierarchy.findNode(name);
+	bone.offset = offset;
+	boneLookup[name] = static_cast<unsigned int>(bones.size());
+	bones.push_back(bone);
+	return static_cast<unsigned int>(bones.size()) - 1;
+}
+
+/*
+*	Converts ASSIMP's animations, key times are converted from ticks to seconds and channels 
+*	are bound to the nodes they move.
+*/
+void Model::loadAnimations(const aiScene *scene) {
+	for (unsigned int i = 0; i < scene->mNumAnimations; i++) {
+		const aiAnimation *animation = scene->mAnimations[i];
+		double ticksPerSecond = animation->mTicksPerSecond != 0.0 ? animation->mTicksPerSecond : 25.0;
+		AnimationClip clip;
+		clip.name = animation->mName.C_Str();
+		clip.duration = static_cast<float>(animation->mDuration / ticksPerSecond);
+		clip.nodeChannels.assign(hierarchy.nodes.size(), -1);
+		for (unsigned int j = 0; j < animation->mNumChannels; j++) {
+			const aiNodeAnim *source = animation->mChannels[j];
+			int node = hierarchy.findNode(source->mNodeName.C_Str());
+			if (node < 0) {
+				continue;
+			}
+			AnimationChannel channel;
+			channel.positions.resize(source->mNumPositionKeys);
+			for (unsigned int k = 0; k < source->mNumPositionKeys; k++) {
+				const aiVectorKey &key = source->mPositionKeys[k];
+				channel.positions[k].time = static_cast<float>(key.mTime / ticksPerSecond);
+				channel.positions[k].value = glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z);
+			}
+			channel.rotations.resize(source->mNumRotationKeys);
+			for (unsigned int k = 0; k < source->mNumRotationKeys; k++) {
+				const aiQuatKey &key = source->mRotationKeys[k];
+				channel.rotations[k].time = static_cast<float>(key.mTime / ticksPerSecond);
+				channel.rotations[k].value = glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z);
+			}
+			channel.scales.resize(source->mNumScalingKeys);
+			for (unsigned int k = 0; k < source->mNumScalingKeys; k++) {
+				const aiVectorKey &key = source->mScalingKeys[k];
+				channel.scales[k].time = static_cast<float>(key.mTime / ticksPerSecond);
+				channel.scales[k].value = glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z);
+			}
+			clip.nodeChannels[node] = static_cast<int>(clip.channels.size());
+			clip.channels.push_back(std::move(channel));
+		}
+		animations.push_back(std::move(clip));
+	}
+}
+
+/*
+*	Puts a bone influence into a free slot of the vertex, or over its weakest one if the new 
+*	influence is stronger.
+*/
+void Model::addBoneWeight(Vertex &vertex, unsigned int bone, float weight) {
+	unsigned int weakest = 0;
+	for (unsigned int i = 1; i < MAX_BONE_INFLUENCES; i++) {
+		if (vertex.boneWeights[i] < vertex.boneWeights[weakest]) {
+			weakest = i;
+		}
+	}
+	if (weight > vertex.boneWeights[weakest]) {
+		vertex.boneIDs[weakest] = static_cast<unsigned char>(bone);
+		vertex.boneWeights[weakest] = weight;
+	}
+}
+
+/*
+*	Converts one of ASSIMP's meshes. The vectors are sized up front and moved into the mesh, 
+*	so the geometry is written once here and copied once more only by the upload. Bone weights 
+*	are reduced to the strongest MAX_BONE_INFLUENCES per vertex and normalized, vertices without 
+*	any follow nodeBone.
+*/
+Mesh Model::processMesh(const aiMesh *mesh, std::vector<Texture> &&textures, int nodeBone) {
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
-	std::vector<Texture> textures;
+	vertices.reserve(mesh->mNumVertices);
+	indices.reserve(mesh->mNumFaces * 3);
 	for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
 		Vertex vertex;
 		glm::vec3 vector;
@@ -100,78 +531,60 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
 		vector.z = mesh->mBitangents[i].z;
 		vertex.bitangent = vector;
 
+		// bone influences, filled in below
+		for (unsigned int k = 0; k < MAX_BONE_INFLUENCES; k++) {
+			vertex.boneIDs[k] = 0;
+			vertex.boneWeights[k] = 0.0f;
+		}
+
 		vertices.push_back(vertex);
 	}
 
+	for (unsigned int j = 0; j < mesh->mNumBones; j++) {
+		const aiBone *bone = mesh->mBones[j];
+		unsigned int index = boneLookup.find(bone->mName.C_Str())->second;
+		for (unsigned int k = 0; k < bone->mNumWeights; k++) {
+			addBoneWeight(vertices[bone->mWeights[k].mVertexId], index, bone->mWeights[k].mWeight);
+		}
+	}
+	if (nodeBone >= 0) {
+		for (unsigned int i = 0; i < vertices.size(); i++) {
+			Vertex &vertex = vertices[i];
+			float sum = 0.0f;
+			for (unsigned int k = 0; k < MAX_BONE_INFLUENCES; k++) {
+				sum += vertex.boneWeights[k];
+			}
+			if (sum <= 0.0f) {
+				vertex.boneIDs[0] = static_cast<unsigned char>(nodeBone);
+				vertex.boneWeights[0] = 1.0f;
+				continue;
+			}
+			for (unsigned int k = 0; k < MAX_BONE_INFLUENCES; k++) {
+				vertex.boneWeights[k] /= sum;
+			}
+		}
+	}
+
 	for (unsigned int j = 0; j < mesh->mNumFaces; j++) {
-		aiFace face = mesh->mFaces[j];
+		const aiFace &face = mesh->mFaces[j];
 		for (unsigned int k = 0; k < face.mNumIndices; k++) {
 			indices.push_back(face.mIndices[k]);
 		}
 	}
 
-	aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
-
-	// diffuse maps
-	std::vector<Texture> diffuseMaps = loadMaterialTextures(
-		material, 
-		aiTextureType_DIFFUSE, 
-		"material.texture_diffuse"
-	);
-	textures.insert(
-		textures.end(),
-		diffuseMaps.begin(),
-		diffuseMaps.end()
-	);
-
-	// specular maps
-	std::vector<Texture> specularMaps = loadMaterialTextures(
-		material, 
-		aiTextureType_SPECULAR, 
-		"material.texture_specular"
-	);
-	textures.insert(
-		textures.end(), 
-		specularMaps.begin(),
-		specularMaps.end()
-	);
-
-	// normal maps
-	std::vector<Texture> normalMaps = loadMaterialTextures(
-		material, 
-		aiTextureType_AMBIENT, 
-		"material.texture_normal"
-	);
-	textures.insert(
-		textures.end(),
-		normalMaps.begin(),
-		normalMaps.end()
-	);
-
-		// height maps
-	std::vector<Texture> heighMaps = loadMaterialTextures(
-		material, 
-		aiTextureType_HEIGHT, 
-		"material.texture_height"
-	);
-	textures.insert(
-		textures.end(), 
-		heighMaps.begin(),
-		heighMaps.end()
-	);
 	return Mesh(
-		vertices,
-		indices,
-		textures
+		std::move(vertices),
+		std::move(indices),
+		std::move(textures)
 	);
 }
 
 /*
-*	Loads up all the different textures and stores them in a Texture-vector.
-*	
+*	Registers the material's textures of the given type and appends them to textures. Textures shared 
+*	between meshes are loaded once, the model owns them and deletes them with itself. The IDs are only 
+*	filled in by upload().
 */
-std::vector<Texture> Model::loadMaterialTextures(aiMaterial *material, aiTextureType type, std::string typeName) {
-	std::vector<Texture> textures;
+void Model::loadMaterialTextures(aiMaterial *material, aiTextureType type, const std::string &typeName, std::vector<Texture> &textures) {
 	for (unsigned int i = 0; i < material->GetTextureCount(type); i++) {
 		aiString str;
 		material->GetTexture(
@@ -189,20 +602,23 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial *material, aiTexture
 		}
 		if (!skip) {
 			Texture texture;
-			texture.ID = dev::TextureFromFile(str.C_Str(), this->directory);
+			texture.ID = 0;
 			texture.type = typeName;
 			texture.path = str.C_Str();
 			textures.push_back(texture);
 			textures_loaded.push_back(texture);
 		}
 	}
-	return textures;
 }
 
 /*
-*	Destructor.
+*	Destructor, returns the meshes' geometry and LODs to the arena, the textures are freed by their handles.
 *	
 */
 Model::~Model() {
-
+	for (unsigned int i = 0; i < meshes.size(); i++) {
+		for (unsigned int lod = 0; lod < meshes[i].lodCount; lod++) {
+			GeometryArena::get().free(meshes[i].lods[lod]);
+		}
+	}
 }
@@ -7,8 +7,13 @@
 #include <assimp/postprocess.h>
 #include <string>
 #include <vector>
+#include <memory>
+#include <map>
 #include "Mesh.hpp"
+#include "Animation.hpp"
+#include "SceneGraph.hpp"
 #include "Shader.hpp"
+#include "TriangleBVH.hpp"
 
 namespace dev {
 	unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma = false);
@@ -19,14 +24,58 @@ class Model
 public:
 	std::vector<Texture> textures_loaded;
 	std::vector<Mesh> meshes;
+	SceneGraph hierarchy;
 	std::string directory;
 	bool gammaCorrection;
+	unsigned int lodCount;
+	glm::vec3 boundsCenter;
+	float boundsRadius;
+	TriangleBVH collision;		// full detail triangles in model space, in the bind pose
+	std::vector<Bone> bones;
+	std::vector<AnimationClip> animations;
 	Model(std::string const &path, bool gamma = false);
-	void draw(Shader shader);
+	void draw(const Shader &shader);
+	void draw(const Shader &shader, const glm::mat4 &model, bool textured = true, unsigned int lod = 0, GLint paletteOffset = -1);
+	void drawInstanced(const Shader &shader, GLsizei instanceCount, bool textured = true, unsigned int lod = 0, bool skinned = false);
+	bool isSkinned(void) const;
+	unsigned int selectLOD(const glm::mat4 &model, const glm::vec3 &viewPos, float projectionScale, unsigned int current) const;
+	void setNodeTransform(const std::string &name, const glm::mat4 &local);
 	~Model();
 private:
-	void loadModel(std::string const &path);
-	void processNode(aiNode *node, const aiScene *scene);
-	Mesh processMesh(aiMesh *mesh, const aiScene *scene);
-	std::vector<Texture> loadMaterialTextures(aiMaterial *material, aiTextureType type, std::string typeName);	
+	friend class ModelLoader;
+	struct DecodedImage {
+		unsigned char *data;
+		int width;
+		int height;
+		int components;
+	};
+	std::vector<DecodedImage> decodedImages;
+	std::string importError;
+	std::map<std::string, unsigned int> boneLookup;
+	Model();
+	void import(std::string const &path);
+	void upload(void);
+	void processNode(aiNode *node, const aiScene *scene, std::vector<const aiMesh*> &sources, std::vector<std::vector<Texture>> &sourceTextures, int parent = -1);
+	Mesh processMesh(const aiMesh *mesh, std::vector<Texture> &&textures, int nodeBone);
+	void registerBones(const std::vector<const aiMesh*> &sources, std::vector<int> &nodeBones);
+	unsigned int addBone(const std::string &name, const glm::mat4 &offset);
+	void loadAnimations(const aiScene *scene);
+	static void addBoneWeight(Vertex &vertex, unsigned int bone, float weight);
+	void loadMaterialTextures(aiMaterial *material, aiTextureType type, const std::string &typeName, std::vector<Texture> &textures);
+	void computeBounds(void);
+	void buildCollision(void);
+	static glm::mat4 toMat4(const aiMatrix4x4 &matrix);
+	struct DrawGroup {
+		unsigned int node;		// whose world transform all meshes of the group share
+		unsigned int first;		// into drawOrder
+		unsigned int count;
+	};
+	std::vector<DrawGroup> drawGroups;
+	std::vector<unsigned int> drawOrder;	// mesh indices, grouped by transform, then by material
+	bool drawGroupsDirty;
+	void updateDrawGroups(void);
+	std::vector<GeometryRange> batch;
+	std::vector<TextureHandle> ownedTextures;
+	Model(const Model&) = delete;
+	Model &operator=(const Model&) = delete;
 };
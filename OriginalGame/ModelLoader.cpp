@@ -0,0 +1,58 @@
+#include "ModelLoader.hpp"
+#include "Model.hpp"
+#include <thread>
+
+/*
+*	Loads the models at the given paths, must be called on the render thread. Returns them in the 
+*	order of the paths, the caller owns them.
+*/
+std::vector<Model*> ModelLoader::load(const std::vector<std::string> &paths) {
+	unsigned int count = static_cast<unsigned int>(paths.size());
+	std::vector<Model*> models(count);
+	for (unsigned int i = 0; i < count; i++) {
+		models[i] = new Model();
+	}
+	double start = glfwGetTime();
+	LoadState state;
+	state.paths = &paths;
+	state.models = &models;
+	JobCounter imports;
+	for (unsigned int i = 0; i < count; i++) {
+		JobSystem::run(&ModelLoader::importJob, &state, &imports, i, i + 1);
+	}
+	for (unsigned int uploaded = 0; uploaded < count;) {
+		bool ready = false;
+		unsigned int i = 0;
+		{
+			std::lock_guard<std::mutex> lock(state.mutex);
+			if (!state.imported.empty()) {
+				i = state.imported.front();
+				state.imported.pop_front();
+				ready = true;
+			}
+		}
+		if (ready) {
+			models[i]->upload();
+			uploaded++;
+		}
+		else if (!JobSystem::help()) {
+			std::this_thread::yield();
+		}
+	}
+	JobSystem::wait(imports);
+	dev::eventLog("Loaded " + std::to_string(count) + " models in " + std::to_string(glfwGetTime() - start) + "s");
+	return models;
+}
+
+/*
+*	Imports the models in [begin, end) and hands them to the render thread for uploading.
+*	
+*/
+void ModelLoader::importJob(void *data, unsigned int begin, unsigned int end) {
+	LoadState &state = *static_cast<LoadState*>(data);
+	for (unsigned int i = begin; i < end; i++) {
+		(*state.models)[i]->import((*state.paths)[i]);
+		std::lock_guard<std::mutex> lock(state.mutex);
+		state.imported.push_back(i);
+	}
+}
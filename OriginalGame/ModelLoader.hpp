@@ -0,0 +1,28 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "JobSystem.hpp"
+
+class Model;
+
+/*
+*	Loads several models at once. Imports (ASSIMP, vertex conversion, LOD generation, image decoding)
+*	run as jobs, the render thread uploads each model as soon as its import has finished, 
+*	so GL object creation stays on the render thread and overlaps with the imports still running.
+*/
+class ModelLoader
+{
+public:
+	static std::vector<Model*> load(const std::vector<std::string> &paths);
+private:
+	struct LoadState {
+		const std::vector<std::string> *paths;
+		std::vector<Model*> *models;
+		std::mutex mutex;
+		std::deque<unsigned int> imported;
+	};
+	static void importJob(void *data, unsigned int begin, unsigned int end);
+};
+
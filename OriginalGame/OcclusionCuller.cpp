@@ -0,0 +1,235 @@
+#include "OcclusionCuller.hpp"
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+
+static const float MIN_W = 1e-4f;	// occluders crossing the near plane are skipped, candidates count as visible
+
+static const glm::vec3 BOX_VERTICES[8] = {
+	glm::vec3(-1.0f, -1.0f, -1.0f), glm::vec3( 1.0f, -1.0f, -1.0f),
+	glm::vec3( 1.0f,  1.0f, -1.0f), glm::vec3(-1.0f,  1.0f, -1.0f),
+	glm::vec3(-1.0f, -1.0f,  1.0f), glm::vec3( 1.0f, -1.0f,  1.0f),
+	glm::vec3( 1.0f,  1.0f,  1.0f), glm::vec3(-1.0f,  1.0f,  1.0f)
+};
+
+static const unsigned int BOX_INDICES[36] = {
+	0, 2, 1, 0, 3, 2,	// back
+	4, 5, 6, 4, 6, 7,	// front
+	0, 4, 7, 0, 7, 3,	// left
+	1, 2, 6, 1, 6, 5,	// right
+	0, 1, 5, 0, 5, 4,	// bottom
+	3, 7, 6, 3, 6, 2	// top
+};
+
+/*
+*	Constructor, splits the depth buffer into one band per job thread (at most four), 
+*	so the job system has to be initialized first.
+*/
+OcclusionCuller::OcclusionCuller() 
+	: depth(WIDTH * HEIGHT, 1.0f), hiZ(TILES_X * TILES_Y, 1.0f) {
+	unsigned int threads = JobSystem::getThreadCount();
+	bandCount = threads >= 4 ? 4 : (threads >= 2 ? 2 : 1);
+}
+
+/*
+*	Starts a new frame, drops last frame's occluders.
+*	
+*/
+void OcclusionCuller::beginFrame(const glm::mat4 &viewProjection) {
+	this->viewProjection = viewProjection;
+	triangles.clear();
+}
+
+/*
+*	Projects an occluder mesh to the depth buffer's screen space. Occluders have to be closed and 
+*	solid from every side they can be seen from, everything behind them is culled.
+*/
+void OcclusionCuller::addOccluder(const glm::vec3 *vertices, const unsigned int *indices, unsigned int indexCount, const glm::mat4 &model) {
+	glm::mat4 transform = viewProjection * model;
+	for (unsigned int i = 0; i + 2 < indexCount; i += 3) {
+		Triangle triangle;
+		bool clipped = false;
+		for (unsigned int k = 0; k < 3; k++) {
+			glm::vec4 clip = transform * glm::vec4(vertices[indices[i + k]], 1.0f);
+			if (clip.w < MIN_W) {
+				clipped = true;
+				break;
+			}
+			triangle.x[k] = (clip.x / clip.w * 0.5f + 0.5f) * WIDTH;
+			triangle.y[k] = (clip.y / clip.w * 0.5f + 0.5f) * HEIGHT;
+			triangle.z[k] = clip.z / clip.w * 0.5f + 0.5f;
+		}
+		if (clipped) {
+			continue;
+		}
+		float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) 
+			- (triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+		if (area == 0.0f) {
+			continue;
+		}
+		// both sides are rasterized, bring the triangle into counter-clockwise order
+		if (area < 0.0f) {
+			std::swap(triangle.x[1], triangle.x[2]);
+			std::swap(triangle.y[1], triangle.y[2]);
+			std::swap(triangle.z[1], triangle.z[2]);
+		}
+		triangles.push_back(triangle);
+	}
+}
+
+/*
+*	Adds a box occluder, the model matrix places the cube from -1 to 1 (the one renderCube draws).
+*	
+*/
+void OcclusionCuller::addBox(const glm::mat4 &model) {
+	addOccluder(BOX_VERTICES, BOX_INDICES, 36, model);
+}
+
+/*
+*	Rasterizes all occluders and builds the hierarchical-Z, returns once every band is done.
+*	
+*/
+void OcclusionCuller::rasterize() {
+	JobSystem::parallelFor(static_cast<unsigned int>(bandCount), 1, [this](unsigned int band) {
+		rasterizeBand(static_cast<int>(band));
+	});
+}
+
+/*
+*	Returns false if the box (center and half extent in model space) is certainly hidden behind the
+*	occluders, i.e. its nearest depth lies behind the farthest occluder depth in every tile it covers.
+*/
+bool OcclusionCuller::isVisible(const glm::vec3 &center, const glm::vec3 &extent, const glm::mat4 &model) const {
+	glm::mat4 transform = viewProjection * model;
+	float minX = (float)WIDTH, minY = (float)HEIGHT, minZ = 1.0f;
+	float maxX = 0.0f, maxY = 0.0f;
+	for (unsigned int i = 0; i < 8; i++) {
+		glm::vec3 corner = center + extent * BOX_VERTICES[i];
+		glm::vec4 clip = transform * glm::vec4(corner, 1.0f);
+		if (clip.w < MIN_W) {
+			return true;
+		}
+		float x = (clip.x / clip.w * 0.5f + 0.5f) * WIDTH;
+		float y = (clip.y / clip.w * 0.5f + 0.5f) * HEIGHT;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minZ = std::min(minZ, clip.z / clip.w * 0.5f + 0.5f);
+	}
+	if (maxX < 0.0f || maxY < 0.0f || minX >= WIDTH || minY >= HEIGHT) {
+		return true;
+	}
+	int firstTileX = static_cast<int>(std::max(minX, 0.0f)) / TILE_SIZE;
+	int lastTileX = static_cast<int>(std::min(maxX, WIDTH - 1.0f)) / TILE_SIZE;
+	int firstTileY = static_cast<int>(std::max(minY, 0.0f)) / TILE_SIZE;
+	int lastTileY = static_cast<int>(std::min(maxY, HEIGHT - 1.0f)) / TILE_SIZE;
+	for (int ty = firstTileY; ty <= lastTileY; ty++) {
+		for (int tx = firstTileX; tx <= lastTileX; tx++) {
+			if (minZ < hiZ[ty * TILES_X + tx]) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/*
+*	Returns the number of occluder triangles of the current frame.
+*	
+*/
+unsigned int OcclusionCuller::getOccluderTriangles() const {
+	return static_cast<unsigned int>(triangles.size());
+}
+
+/*
+*	Clears the band, rasterizes every occluder clipped to it and reduces it to hierarchical-Z.
+*	
+*/
+void OcclusionCuller::rasterizeBand(int band) {
+	int firstRow = band * HEIGHT / bandCount;
+	int lastRow = (band + 1) * HEIGHT / bandCount;
+	std::fill(depth.begin() + firstRow * WIDTH, depth.begin() + lastRow * WIDTH, 1.0f);
+	for (unsigned int i = 0; i < triangles.size(); i++) {
+		rasterizeTriangle(triangles[i], firstRow, lastRow);
+	}
+	buildHiZ(firstRow, lastRow);
+}
+
+/*
+*	Rasterizes one triangle into rows [firstRow, lastRow), keeping the nearest depth. Edge functions 
+*	and the depth plane are evaluated at the centers of four horizontally adjacent pixels at once.
+*/
+void OcclusionCuller::rasterizeTriangle(const Triangle &t, int firstRow, int lastRow) {
+	float left = std::max(0.0f, std::floor(std::min(t.x[0], std::min(t.x[1], t.x[2]))));
+	float right = std::min(WIDTH - 1.0f, std::ceil(std::max(t.x[0], std::max(t.x[1], t.x[2]))));
+	float bottom = std::max(static_cast<float>(firstRow), std::floor(std::min(t.y[0], std::min(t.y[1], t.y[2]))));
+	float top = std::min(lastRow - 1.0f, std::ceil(std::max(t.y[0], std::max(t.y[1], t.y[2]))));
+	if (left > right || bottom > top) {
+		return;
+	}
+	int minX = static_cast<int>(left), maxX = static_cast<int>(right);
+	int minY = static_cast<int>(bottom), maxY = static_cast<int>(top);
+
+	// edge i is opposite vertex i and positive inside, the edges sum up to twice the area
+	float a[3], b[3], c[3];
+	for (int i = 0; i < 3; i++) {
+		int j = (i + 1) % 3, k = (i + 2) % 3;
+		a[i] = t.y[j] - t.y[k];
+		b[i] = t.x[k] - t.x[j];
+		c[i] = t.x[j] * t.y[k] - t.x[k] * t.y[j];
+	}
+	float area = c[0] + c[1] + c[2];
+	float za = (a[0] * t.z[0] + a[1] * t.z[1] + a[2] * t.z[2]) / area;
+	float zb = (b[0] * t.z[0] + b[1] * t.z[1] + b[2] * t.z[2]) / area;
+	float zc = (c[0] * t.z[0] + c[1] * t.z[1] + c[2] * t.z[2]) / area;
+
+	const __m128 centers = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+	__m128 a0 = _mm_set1_ps(a[0]), a1 = _mm_set1_ps(a[1]), a2 = _mm_set1_ps(a[2]);
+	__m128 stepZ = _mm_set1_ps(za);
+	minX &= ~3;
+	for (int y = minY; y <= maxY; y++) {
+		float py = y + 0.5f;
+		__m128 row0 = _mm_set1_ps(b[0] * py + c[0]);
+		__m128 row1 = _mm_set1_ps(b[1] * py + c[1]);
+		__m128 row2 = _mm_set1_ps(b[2] * py + c[2]);
+		__m128 rowZ = _mm_set1_ps(zb * py + zc);
+		float *line = &depth[y * WIDTH];
+		for (int x = minX; x <= maxX; x += 4) {
+			__m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), centers);
+			__m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), row0);
+			__m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), row1);
+			__m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), row2);
+			__m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+			if (_mm_movemask_ps(inside) == 0) {
+				continue;
+			}
+			__m128 z = _mm_add_ps(_mm_mul_ps(stepZ, px), rowZ);
+			__m128 old = _mm_loadu_ps(line + x);
+			__m128 nearest = _mm_min_ps(old, z);
+			_mm_storeu_ps(line + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+		}
+	}
+}
+
+/*
+*	Stores the farthest depth of every tile in rows [firstRow, lastRow), which have to be tile aligned.
+*	
+*/
+void OcclusionCuller::buildHiZ(int firstRow, int lastRow) {
+	for (int ty = firstRow / TILE_SIZE; ty < lastRow / TILE_SIZE; ty++) {
+		for (int tx = 0; tx < TILES_X; tx++) {
+			__m128 farthest = _mm_setzero_ps();
+			for (int y = ty * TILE_SIZE; y < (ty + 1) * TILE_SIZE; y++) {
+				const float *line = &depth[y * WIDTH + tx * TILE_SIZE];
+				for (int x = 0; x < TILE_SIZE; x += 4) {
+					farthest = _mm_max_ps(farthest, _mm_loadu_ps(line + x));
+				}
+			}
+			farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(1, 0, 3, 2)));
+			farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(2, 3, 0, 1)));
+			hiZ[ty * TILES_X + tx] = _mm_cvtss_f32(farthest);
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include "JobSystem.hpp"
+
+/*
+*	Software occlusion culling. Occluders are rasterized into a small CPU depth buffer, four pixels at a 
+*	time with SSE, in horizontal bands that are filled by parallel jobs. Every band is reduced to a 
+*	hierarchical-Z of the farthest depth per tile, which candidate bounding boxes are tested against.
+*/
+class OcclusionCuller
+{
+public:
+	static const int WIDTH			= 256;
+	static const int HEIGHT			= 128;
+	static const int TILE_SIZE		= 8;
+	static const int TILES_X		= WIDTH / TILE_SIZE;
+	static const int TILES_Y		= HEIGHT / TILE_SIZE;
+	OcclusionCuller();
+	void beginFrame(const glm::mat4 &viewProjection);
+	void addOccluder(const glm::vec3 *vertices, const unsigned int *indices, unsigned int indexCount, const glm::mat4 &model);
+	void addBox(const glm::mat4 &model);
+	void rasterize(void);
+	bool isVisible(const glm::vec3 &center, const glm::vec3 &extent, const glm::mat4 &model) const;
+	unsigned int getOccluderTriangles(void) const;
+private:
+	struct Triangle {
+		float x[3];
+		float y[3];
+		float z[3];
+	};
+	glm::mat4 viewProjection;
+	std::vector<Triangle> triangles;
+	std::vector<float> depth;
+	std::vector<float> hiZ;
+	int bandCount;
+	void rasterizeBand(int band);
+	void rasterizeTriangle(const Triangle &triangle, int firstRow, int lastRow);
+	void buildHiZ(int firstRow, int lastRow);
+};
+
@@ -0,0 +1,315 @@
+#include "Particles.hpp"
+#include "JobSystem.hpp"
+#include "StreamBuffer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <emmintrin.h>
+
+static const unsigned int CHUNK_SIZE		= 256;		// particles per job, a multiple of four
+static const float GROUND_FRICTION			= 0.6f;		// tangential speed kept on a bounce
+
+/*
+*	How an effect's particles are launched, move and look. Damping is the fraction of the speed
+*	kept per second.
+*/
+struct EffectSettings {
+	float minSpeed, maxSpeed;
+	float minLifetime, maxLifetime;
+	float minSize, maxSize;
+	float spread;
+	float gravity;
+	float damping;
+	float bounce;
+	glm::vec4 color;
+	bool additive;
+};
+
+static const EffectSettings EFFECTS[PARTICLE_EFFECT_COUNT] = {
+	{ 2.0f, 6.0f, 0.15f, 0.4f, 0.008f, 0.016f, 0.8f, -9.81f, 0.3f, 0.35f, glm::vec4(1.0f, 0.75f, 0.35f, 1.0f), true },
+	{ 0.8f, 2.5f, 0.6f, 1.2f, 0.02f, 0.05f, 1.2f, -6.0f, 0.5f, 0.15f, glm::vec4(0.55f, 0.5f, 0.45f, 0.85f), false }
+};
+
+/*
+*	Constructor, allocates every pool up front and creates the quad and the shader.
+*	
+*/
+Particles::Particles()
+	: ground(-1e30f), emitted(0), dropped(0), random(0x2545F491u),
+	shader("src/shaders/particle.vert", "src/shaders/particle.frag"), VAO(VertexArrayHandle::create()), quadVBO(BufferHandle::create()) {
+	const unsigned int capacities[PARTICLE_EFFECT_COUNT] = { MAX_SPARKS, MAX_DEBRIS };
+	for (unsigned int e = 0; e < PARTICLE_EFFECT_COUNT; e++) {
+		Pool &pool = pools[e];
+		pool.capacity = capacities[e];
+		pool.count = 0;
+		pool.x.resize(pool.capacity);
+		pool.y.resize(pool.capacity);
+		pool.z.resize(pool.capacity);
+		pool.velocityX.resize(pool.capacity);
+		pool.velocityY.resize(pool.capacity);
+		pool.velocityZ.resize(pool.capacity);
+		pool.age.resize(pool.capacity);
+		pool.lifetime.resize(pool.capacity);
+		pool.size.resize(pool.capacity);
+		if (!EFFECTS[e].additive) {
+			pool.depth.resize(pool.capacity);
+			pool.order.resize(pool.capacity);
+		}
+	}
+	float corners[] = {
+	   -1.0f, -1.0f,
+		1.0f, -1.0f,
+	   -1.0f,  1.0f,
+		1.0f,  1.0f
+	};
+	GLState::bindVertexArray(VAO.get());
+	GLState::bindBuffer(GL_ARRAY_BUFFER, quadVBO.get());
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	RenderStats::countUpload(sizeof(corners));
+	GPUMemory::trackBuffer(quadVBO.get(), sizeof(corners), GPU_MEMORY_GEOMETRY, "Particles");
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+	for (GLuint i = 1; i <= 2; i++) {
+		glEnableVertexAttribArray(i);
+		glVertexAttribDivisor(i, 1);
+	}
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+	GLState::bindVertexArray(0);
+}
+
+/*
+*	Sets the height of the ground plane particles bounce off.
+*	
+*/
+void Particles::setGround(float height) {
+	ground = height;
+}
+
+/*
+*	Launches up to count particles of an effect from position, spread around normal. Returns how
+*	many were launched, the rest is dropped once the pool or this frame's budget is used up.
+*/
+unsigned int Particles::emit(ParticleEffect effect, const glm::vec3 &position, const glm::vec3 &normal, unsigned int count) {
+	const EffectSettings &settings = EFFECTS[effect];
+	Pool &pool = pools[effect];
+	unsigned int accepted = std::min(count, std::min(pool.capacity - pool.count, MAX_EMITTED_PER_FRAME - emitted));
+	dropped += count - accepted;
+	emitted += accepted;
+	for (unsigned int k = 0; k < accepted; k++) {
+		glm::vec3 scatter(nextRandom() * 2.0f - 1.0f, nextRandom() * 2.0f - 1.0f, nextRandom() * 2.0f - 1.0f);
+		glm::vec3 direction = normal + scatter * settings.spread;
+		float length = glm::length(direction);
+		direction = length > 1e-4f ? direction / length : normal;
+		glm::vec3 velocity = direction * (settings.minSpeed + (settings.maxSpeed - settings.minSpeed) * nextRandom());
+		unsigned int i = pool.count++;
+		pool.x[i] = position.x;
+		pool.y[i] = position.y;
+		pool.z[i] = position.z;
+		pool.velocityX[i] = velocity.x;
+		pool.velocityY[i] = velocity.y;
+		pool.velocityZ[i] = velocity.z;
+		pool.age[i] = 0.0f;
+		pool.lifetime[i] = settings.minLifetime + (settings.maxLifetime - settings.minLifetime) * nextRandom();
+		pool.size[i] = settings.minSize + (settings.maxSize - settings.minSize) * nextRandom();
+	}
+	return accepted;
+}
+
+/*
+*	Advances every pool by deltaTime in one batch of jobs, then removes expired particles and
+*	resets the emission budget.
+*/
+void Particles::update(float deltaTime) {
+	emitted = 0;
+	unsigned int chunkStart[PARTICLE_EFFECT_COUNT + 1];
+	float damping[PARTICLE_EFFECT_COUNT];
+	chunkStart[0] = 0;
+	for (unsigned int e = 0; e < PARTICLE_EFFECT_COUNT; e++) {
+		chunkStart[e + 1] = chunkStart[e] + (pools[e].count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+		damping[e] = std::pow(EFFECTS[e].damping, deltaTime);
+	}
+	if (chunkStart[PARTICLE_EFFECT_COUNT] == 0) {
+		return;
+	}
+
+	JobSystem::parallelFor(chunkStart[PARTICLE_EFFECT_COUNT], 1, [&](unsigned int chunk) {
+		unsigned int e = 0;
+		while (chunk >= chunkStart[e + 1]) {
+			e++;
+		}
+		Pool &pool = pools[e];
+		unsigned int begin = (chunk - chunkStart[e]) * CHUNK_SIZE;
+		unsigned int end = begin + CHUNK_SIZE < pool.count ? begin + CHUNK_SIZE : pool.count;
+		integrate(pool, begin, end, deltaTime, EFFECTS[e].gravity, damping[e], EFFECTS[e].bounce);
+	});
+
+	for (unsigned int e = 0; e < PARTICLE_EFFECT_COUNT; e++) {
+		Pool &pool = pools[e];
+		for (unsigned int i = 0; i < pool.count; ) {
+			if (pool.age[i] >= pool.lifetime[i]) {
+				remove(pool, i);
+			}
+			else {
+				i++;
+			}
+		}
+	}
+}
+
+/*
+*	Streams all particles, grouped by effect and sorted where the effect blends, and draws every
+*	effect with one instanced draw without writing depth. Leaves depth writes disabled.
+*/
+void Particles::draw(const glm::mat4 &viewProjection, const glm::vec3 &viewPos, const glm::vec3 &right, const glm::vec3 &up) {
+	unsigned int total = getCount();
+	if (total == 0) {
+		return;
+	}
+	GLintptr offset;
+	void *data = StreamBuffer::get().map(total * sizeof(Instance), sizeof(float), offset);
+	if (data == nullptr) {
+		return;
+	}
+	Instance *instances = static_cast<Instance*>(data);
+	unsigned int first[PARTICLE_EFFECT_COUNT];
+	unsigned int written = 0;
+	for (unsigned int e = 0; e < PARTICLE_EFFECT_COUNT; e++) {
+		Pool &pool = pools[e];
+		bool sorted = !EFFECTS[e].additive;
+		if (sorted) {
+			sort(pool, viewPos);
+		}
+		first[e] = written;
+		for (unsigned int i = 0; i < pool.count; i++) {
+			unsigned int p = sorted ? pool.order[i] : i;
+			Instance &instance = instances[written++];
+			instance.positionSize = glm::vec4(pool.x[p], pool.y[p], pool.z[p], pool.size[p]);
+			instance.fade = pool.age[p] / pool.lifetime[p];
+		}
+	}
+	StreamBuffer::get().unmap();
+
+	shader.use();
+	shader.setMat4("viewProjection", viewProjection);
+	shader.setVec3("cameraRight", right);
+	shader.setVec3("cameraUp", up);
+	GLState::bindVertexArray(VAO.get());
+	GLState::depthMask(GL_FALSE);
+	for (unsigned int e = 0; e < PARTICLE_EFFECT_COUNT; e++) {
+		if (pools[e].count == 0) {
+			continue;
+		}
+		GLintptr base = offset + first[e] * sizeof(Instance);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, StreamBuffer::get().getBuffer());
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(base + offsetof(Instance, positionSize)));
+		glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(base + offsetof(Instance, fade)));
+		GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+		shader.setVec4("color", EFFECTS[e].color);
+		GLState::blendFunc(GL_SRC_ALPHA, EFFECTS[e].additive ? GL_ONE : GL_ONE_MINUS_SRC_ALPHA);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(pools[e].count));
+		RenderStats::countDraw(GL_TRIANGLE_STRIP, 4, static_cast<GLsizei>(pools[e].count));
+	}
+	GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+/*
+*	Returns the number of live particles of all effects.
+*	
+*/
+unsigned int Particles::getCount() const {
+	unsigned int count = 0;
+	for (unsigned int e = 0; e < PARTICLE_EFFECT_COUNT; e++) {
+		count += pools[e].count;
+	}
+	return count;
+}
+
+/*
+*	Returns the number of particles dropped by the caps so far.
+*	
+*/
+unsigned int Particles::getDropped() const {
+	return dropped;
+}
+
+/*
+*	Xorshift, returns a float in [0, 1).
+*	
+*/
+float Particles::nextRandom() {
+	random ^= random << 13;
+	random ^= random >> 17;
+	random ^= random << 5;
+	return static_cast<float>(random >> 8) / 16777216.0f;
+}
+
+/*
+*	Semi-implicit Euler step of four particles at once. Particles that end up below the ground are
+*	put back onto it and bounce, losing speed.
+*/
+void Particles::integrate(Pool &pool, unsigned int begin, unsigned int end, float deltaTime, float gravity, float damping, float bounce) {
+	__m128 dt = _mm_set1_ps(deltaTime);
+	__m128 fall = _mm_set1_ps(gravity * deltaTime);
+	__m128 keep = _mm_set1_ps(damping);
+	__m128 floor = _mm_set1_ps(ground);
+	__m128 rebound = _mm_set1_ps(-bounce);
+	__m128 friction = _mm_set1_ps(GROUND_FRICTION);
+	// capacities are multiples of four, lanes past the end are scratch
+	for (unsigned int i = begin; i < end; i += 4) {
+		__m128 vx = _mm_mul_ps(_mm_loadu_ps(&pool.velocityX[i]), keep);
+		__m128 vy = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&pool.velocityY[i]), keep), fall);
+		__m128 vz = _mm_mul_ps(_mm_loadu_ps(&pool.velocityZ[i]), keep);
+		__m128 px = _mm_add_ps(_mm_loadu_ps(&pool.x[i]), _mm_mul_ps(vx, dt));
+		__m128 py = _mm_add_ps(_mm_loadu_ps(&pool.y[i]), _mm_mul_ps(vy, dt));
+		__m128 pz = _mm_add_ps(_mm_loadu_ps(&pool.z[i]), _mm_mul_ps(vz, dt));
+		__m128 below = _mm_cmplt_ps(py, floor);
+		py = _mm_or_ps(_mm_and_ps(below, floor), _mm_andnot_ps(below, py));
+		vy = _mm_or_ps(_mm_and_ps(below, _mm_mul_ps(vy, rebound)), _mm_andnot_ps(below, vy));
+		__m128 slide = _mm_or_ps(_mm_and_ps(below, friction), _mm_andnot_ps(below, _mm_set1_ps(1.0f)));
+		_mm_storeu_ps(&pool.velocityX[i], _mm_mul_ps(vx, slide));
+		_mm_storeu_ps(&pool.velocityY[i], vy);
+		_mm_storeu_ps(&pool.velocityZ[i], _mm_mul_ps(vz, slide));
+		_mm_storeu_ps(&pool.x[i], px);
+		_mm_storeu_ps(&pool.y[i], py);
+		_mm_storeu_ps(&pool.z[i], pz);
+		_mm_storeu_ps(&pool.age[i], _mm_add_ps(_mm_loadu_ps(&pool.age[i]), dt));
+	}
+}
+
+/*
+*	Removes a particle by moving the pool's last one into its place.
+*	
+*/
+void Particles::remove(Pool &pool, unsigned int i) {
+	unsigned int last = --pool.count;
+	pool.x[i] = pool.x[last];
+	pool.y[i] = pool.y[last];
+	pool.z[i] = pool.z[last];
+	pool.velocityX[i] = pool.velocityX[last];
+	pool.velocityY[i] = pool.velocityY[last];
+	pool.velocityZ[i] = pool.velocityZ[last];
+	pool.age[i] = pool.age[last];
+	pool.lifetime[i] = pool.lifetime[last];
+	pool.size[i] = pool.size[last];
+}
+
+/*
+*	Orders a pool's particles back to front from viewPos. Depths are computed four at a time, the
+*	order array is preallocated, so sorting never allocates.
+*/
+void Particles::sort(Pool &pool, const glm::vec3 &viewPos) {
+	__m128 cx = _mm_set1_ps(viewPos.x), cy = _mm_set1_ps(viewPos.y), cz = _mm_set1_ps(viewPos.z);
+	for (unsigned int i = 0; i < pool.count; i += 4) {
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(&pool.x[i]), cx);
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(&pool.y[i]), cy);
+		__m128 dz = _mm_sub_ps(_mm_loadu_ps(&pool.z[i]), cz);
+		_mm_storeu_ps(&pool.depth[i], _mm_add_ps(_mm_mul_ps(dx, dx), _mm_add_ps(_mm_mul_ps(dy, dy), _mm_mul_ps(dz, dz))));
+	}
+	for (unsigned int i = 0; i < pool.count; i++) {
+		pool.order[i] = i;
+	}
+	const std::vector<float> &depth = pool.depth;
+	std::sort(pool.order.begin(), pool.order.begin() + pool.count, [&depth](unsigned int a, unsigned int b) {
+		return depth[a] > depth[b];
+	});
+}
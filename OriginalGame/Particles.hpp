@@ -0,0 +1,62 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Shader.hpp"
+#include "GLHandle.hpp"
+
+enum ParticleEffect {
+	PARTICLE_SPARKS,		// additive, drawn unsorted
+	PARTICLE_DEBRIS,		// alpha blended, sorted back to front
+	PARTICLE_EFFECT_COUNT
+};
+
+/*
+*	Hit sparks and target debris. Every effect owns a fixed pool stored as structure of arrays that
+*	is integrated four particles at a time with SSE across jobs. Pools and the per frame emission
+*	budget are hard caps, particles past them are dropped instead of allocated. Only blended effects
+*	are sorted, each effect is drawn with one instanced draw of camera facing quads.
+*/
+class Particles
+{
+public:
+	static const unsigned int MAX_SPARKS			= 8192;
+	static const unsigned int MAX_DEBRIS			= 2048;
+	static const unsigned int MAX_EMITTED_PER_FRAME	= 1024;
+	Particles();
+	void setGround(float height);
+	unsigned int emit(ParticleEffect effect, const glm::vec3 &position, const glm::vec3 &normal, unsigned int count);
+	void update(float deltaTime);
+	void draw(const glm::mat4 &viewProjection, const glm::vec3 &viewPos, const glm::vec3 &right, const glm::vec3 &up);
+	unsigned int getCount(void) const;
+	unsigned int getDropped(void) const;
+private:
+	struct Instance {
+		glm::vec4 positionSize;
+		float fade;			// age over lifetime
+	};
+	struct Pool {
+		unsigned int capacity;
+		unsigned int count;
+		std::vector<float> x, y, z;
+		std::vector<float> velocityX, velocityY, velocityZ;
+		std::vector<float> age, lifetime, size;
+		std::vector<float> depth;			// squared distance to the camera, sorted effects only
+		std::vector<unsigned int> order;
+	};
+	Pool pools[PARTICLE_EFFECT_COUNT];
+	float ground;
+	unsigned int emitted;
+	unsigned int dropped;
+	unsigned int random;
+	Shader shader;
+	VertexArrayHandle VAO;
+	BufferHandle quadVBO;
+	float nextRandom(void);
+	void integrate(Pool &pool, unsigned int begin, unsigned int end, float deltaTime, float gravity, float damping, float bounce);
+	void remove(Pool &pool, unsigned int i);
+	void sort(Pool &pool, const glm::vec3 &viewPos);
+	Particles(const Particles&) = delete;
+	Particles &operator=(const Particles&) = delete;
+};
+
@@ -6,9 +6,11 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include <algorithm>
 #include <vector>
 #include <map>
 #include <string>
+#include <cstring>
 #include <fstream>
 #include <time.h>
 #include <Windows.h>
@@ -21,7 +23,9 @@ namespace dev {
 	void processInput(GLFWwindow* window);
 	void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 	void mouse_callback(GLFWwindow *window, double xpos, double ypos);
+	void mouse_button_callback(GLFWwindow *window, int button, int action, int mods);
 	void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
+	void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 	void error(const std::string errorMsg);
 	void startLog(void);
 	void stopLog(void);
@@ -32,5 +36,6 @@ namespace dev {
 	void hideConsoleWindow(void); 
 	unsigned int loadTexture(char const *path);
 	unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma);
+	unsigned int textureFromImage(unsigned char *data, int width, int height, int nrComponents, const std::string &filename);
 	const std::string currentDateTime(void);
 }
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include "RenderStats.hpp"
+
+static FrameStats currentFrame	= {};
+static FrameStats lastFrame		= {};
+
+/*
+*	Publishes the counters of the frame that just ended and starts counting from zero.
+*	
+*/
+void RenderStats::beginFrame() {
+	lastFrame = currentFrame;
+	currentFrame = FrameStats();
+}
+
+/*
+*	Returns the counters of the last completed frame.
+*	
+*/
+const FrameStats &RenderStats::getLastFrame() {
+	return lastFrame;
+}
+
+/*
+*	Returns the counters of the frame in progress.
+*	
+*/
+const FrameStats &RenderStats::getCurrentFrame() {
+	return currentFrame;
+}
+
+/*
+*	Counts one draw call of vertexCount vertices (or indices), instanced instanceCount times.
+*	
+*/
+void RenderStats::countDraw(GLenum mode, GLsizei vertexCount, GLsizei instanceCount) {
+	currentFrame.drawCalls++;
+	currentFrame.instances += instanceCount;
+	currentFrame.triangles += trianglesOf(mode, vertexCount) * instanceCount;
+}
+
+/*
+*	Counts a multi-draw, which is a single call to the driver but submits drawCount meshes.
+*	
+*/
+void RenderStats::countMultiDraw(GLenum mode, const GLsizei *vertexCounts, GLsizei drawCount) {
+	currentFrame.drawCalls++;
+	currentFrame.instances += drawCount;
+	for (GLsizei i = 0; i < drawCount; i++) {
+		currentFrame.triangles += trianglesOf(mode, vertexCounts[i]);
+	}
+}
+
+/*
+*	Counts a program switch.
+*	
+*/
+void RenderStats::countProgramBind() {
+	currentFrame.programBinds++;
+}
+
+/*
+*	Counts a texture bind.
+*	
+*/
+void RenderStats::countTextureBind() {
+	currentFrame.textureBinds++;
+}
+
+/*
+*	Counts a vertex array bind.
+*	
+*/
+void RenderStats::countVAOBind() {
+	currentFrame.vaoBinds++;
+}
+
+/*
+*	Counts a uniform upload.
+*	
+*/
+void RenderStats::countUniform() {
+	currentFrame.uniformUploads++;
+}
+
+/*
+*	Counts bytes sent to buffer objects with glBufferData / glBufferSubData.
+*	
+*/
+void RenderStats::countUpload(GLsizeiptr bytes) {
+	currentFrame.bytesUploaded += static_cast<unsigned long long>(bytes);
+}
+
+/*
+*	Counts a scene object that was skipped because it is hidden behind occluders.
+*	
+*/
+void RenderStats::countOccluded() {
+	currentFrame.occludedObjects++;
+}
+
+/*
+*	Counts a scene object that was skipped because it is outside the view frustum.
+*	
+*/
+void RenderStats::countCulled() {
+	currentFrame.culledObjects++;
+}
+
+/*
+*	Returns the number of triangles a draw of vertexCount vertices produces with the given primitive mode.
+*	
+*/
+unsigned long long RenderStats::trianglesOf(GLenum mode, GLsizei vertexCount) {
+	switch (mode) {
+	case GL_TRIANGLES:
+		return vertexCount / 3;
+	case GL_TRIANGLE_STRIP:
+	case GL_TRIANGLE_FAN:
+		return vertexCount > 2 ? vertexCount - 2 : 0;
+	default:
+		return 0;
+	}
+}
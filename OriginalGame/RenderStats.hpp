@@ -0,0 +1,43 @@
+#pragma once
+#include <glad/glad.h>
+
+/*
+*	Work submitted to GL during one frame.
+*
+*/
+struct FrameStats {
+	unsigned int drawCalls;
+	unsigned int instances;
+	unsigned long long triangles;
+	unsigned int programBinds;
+	unsigned int textureBinds;
+	unsigned int vaoBinds;
+	unsigned int uniformUploads;
+	unsigned long long bytesUploaded;
+	unsigned int occludedObjects;
+	unsigned int culledObjects;
+};
+
+/*
+*	Per-frame render counters. The engine reports draws, binds that actually reach the driver,
+*	uniform uploads and buffer uploads here; beginFrame() publishes the finished frame's numbers.
+*/
+class RenderStats
+{
+public:
+	static void beginFrame(void);
+	static const FrameStats &getLastFrame(void);
+	static const FrameStats &getCurrentFrame(void);
+	static void countDraw(GLenum mode, GLsizei vertexCount, GLsizei instanceCount = 1);
+	static void countMultiDraw(GLenum mode, const GLsizei *vertexCounts, GLsizei drawCount);
+	static void countProgramBind(void);
+	static void countTextureBind(void);
+	static void countVAOBind(void);
+	static void countUniform(void);
+	static void countUpload(GLsizeiptr bytes);
+	static void countOccluded(void);
+	static void countCulled(void);
+private:
+	static unsigned long long trianglesOf(GLenum mode, GLsizei vertexCount);
+};
+
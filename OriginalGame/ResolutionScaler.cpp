@@ -0,0 +1,85 @@
+#include "ResolutionScaler.hpp"
+#include <cmath>
+
+const float SMOOTHING				= 0.1f;	// weight of a new sample in the running average
+const float DOWNSCALE_THRESHOLD		= 0.95f;	// scale down above 95% of the budget
+const float UPSCALE_THRESHOLD		= 0.8f;	// scale up below 80% of the budget
+const float UPSCALE_STEP			= 0.02f;
+const unsigned int SETTLE_FRAMES	= 8;		// frames to wait after a change, the timer lags behind
+
+/*
+*	Constructor, expects the frame time to hold in milliseconds.
+*	
+*/
+ResolutionScaler::ResolutionScaler(float targetMilliseconds, float minScale, float maxScale)
+	: enabled(true), targetMilliseconds(targetMilliseconds), minScale(minScale), maxScale(maxScale),
+	scale(maxScale), smoothed(0.0f), samples(0), framesSinceChange(0) {
+
+}
+
+/*
+*	Feeds a measured GPU frame time and adjusts the scale. Scaling down is proportional to the 
+*	overshoot so spikes are absorbed quickly, scaling up happens in small steps to avoid oscillation.
+*/
+void ResolutionScaler::update(float gpuMilliseconds) {
+	smoothed = samples == 0 ? gpuMilliseconds : smoothed + (gpuMilliseconds - smoothed) * SMOOTHING;
+	samples++;
+	framesSinceChange++;
+	if (!enabled) {
+		scale = maxScale;
+		return;
+	}
+	if (framesSinceChange < SETTLE_FRAMES) {
+		return;
+	}
+	float newScale = scale;
+	if (smoothed > targetMilliseconds * DOWNSCALE_THRESHOLD) {
+		newScale = scale * std::sqrt(targetMilliseconds * DOWNSCALE_THRESHOLD / smoothed);
+	}
+	else if (smoothed < targetMilliseconds * UPSCALE_THRESHOLD) {
+		newScale = scale + UPSCALE_STEP;
+	}
+	if (newScale < minScale) {
+		newScale = minScale;
+	}
+	if (newScale > maxScale) {
+		newScale = maxScale;
+	}
+	if (newScale != scale) {
+		scale = newScale;
+		framesSinceChange = 0;
+		samples = 0;
+	}
+}
+
+/*
+*	Sets the frame time to hold in milliseconds.
+*	
+*/
+void ResolutionScaler::setTargetFrameTime(float milliseconds) {
+	targetMilliseconds = milliseconds;
+}
+
+/*
+*	Returns the current render scale.
+*	
+*/
+float ResolutionScaler::getScale() const {
+	return enabled ? scale : maxScale;
+}
+
+/*
+*	Returns the running average of the measured GPU frame time in milliseconds.
+*	
+*/
+float ResolutionScaler::getSmoothedFrameTime() const {
+	return smoothed;
+}
+
+/*
+*	Destructor.
+*	
+*/
+ResolutionScaler::~ResolutionScaler() {
+
+}
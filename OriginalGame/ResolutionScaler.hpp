@@ -0,0 +1,25 @@
+#pragma once
+
+/*
+*	Picks the internal render scale from measured GPU frame times so that a target frame time is held.
+*	Rendering cost grows with the pixel count, i.e. with the square of the scale.
+*/
+class ResolutionScaler
+{
+public:
+	bool enabled;
+	ResolutionScaler(float targetMilliseconds, float minScale = 0.5f, float maxScale = 1.0f);
+	void update(float gpuMilliseconds);
+	void setTargetFrameTime(float milliseconds);
+	float getScale(void) const;
+	float getSmoothedFrameTime(void) const;
+	~ResolutionScaler();
+private:
+	float targetMilliseconds;
+	float minScale, maxScale;
+	float scale;
+	float smoothed;
+	unsigned int samples;
+	unsigned int framesSinceChange;
+};
+
@@ -0,0 +1,105 @@
+#include "SceneGraph.hpp"
+
+/*
+*	Constructor.
+*
+*/
+SceneGraph::SceneGraph() : anyDirty(false) {
+
+}
+
+/*
+*	Appends a node to the hierarchy and returns its index. The parent has to be added
+*	beforehand (or be -1), which keeps the array in parent-before-child order.
+*/
+unsigned int SceneGraph::addNode(const std::string &name, int parent, const glm::mat4 &local) {
+	SceneNode node;
+	node.name = name;
+	node.parent = parent < static_cast<int>(nodes.size()) ? parent : -1;
+	node.local = local;
+	node.world = local;
+	node.firstMesh = 0;
+	node.meshCount = 0;
+	nodes.push_back(node);
+	dirty.push_back(1);
+	anyDirty = true;
+	return static_cast<unsigned int>(nodes.size() - 1);
+}
+
+/*
+*	Returns the index of the first node with the given name, -1 if there is none.
+*
+*/
+int SceneGraph::findNode(const std::string &name) const {
+	for (unsigned int i = 0; i < nodes.size(); i++) {
+		if (nodes[i].name == name) {
+			return static_cast<int>(i);
+		}
+	}
+	return -1;
+}
+
+/*
+*	Sets the transform of a node relative to its parent and marks it dirty.
+*
+*/
+void SceneGraph::setLocalTransform(unsigned int node, const glm::mat4 &local) {
+	nodes[node].local = local;
+	dirty[node] = 1;
+	anyDirty = true;
+}
+
+/*
+*	Returns the transform of a node relative to its parent.
+*
+*/
+const glm::mat4 &SceneGraph::getLocalTransform(unsigned int node) const {
+	return nodes[node].local;
+}
+
+/*
+*	Returns the cached world transform of a node, only valid after update().
+*
+*/
+const glm::mat4 &SceneGraph::getWorldTransform(unsigned int node) const {
+	return nodes[node].world;
+}
+
+/*
+*	Recomputes the world matrices of all dirty nodes and their descendants. Because parents
+*	precede their children, a dirty parent has already been visited when we reach the child.
+*/
+void SceneGraph::update() {
+	if (!anyDirty) {
+		return;
+	}
+	for (unsigned int i = 0; i < nodes.size(); i++) {
+		int parent = nodes[i].parent;
+		if (parent >= 0 && dirty[parent]) {
+			dirty[i] = 1;
+		}
+		if (dirty[i]) {
+			nodes[i].world = parent >= 0 ? nodes[parent].world * nodes[i].local : nodes[i].local;
+		}
+	}
+	std::fill(dirty.begin(), dirty.end(), 0);
+	anyDirty = false;
+}
+
+/*
+*	Removes all nodes.
+*
+*/
+void SceneGraph::clear() {
+	nodes.clear();
+	dirty.clear();
+	anyDirty = false;
+}
+
+/*
+*	Destructor.
+*
+*/
+SceneGraph::~SceneGraph() {
+
+}
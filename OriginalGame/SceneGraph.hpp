@@ -0,0 +1,42 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/*
+*	A single node of the transform hierarchy. Nodes are stored in a flat array where
+*	every parent comes before its children, so parent is always a smaller index (-1 for roots).
+*/
+struct SceneNode {
+	std::string name;
+	int parent;
+	glm::mat4 local;
+	glm::mat4 world;
+	unsigned int firstMesh;
+	unsigned int meshCount;
+};
+
+/*
+*	Transform hierarchy with cached world matrices. Changing a local transform only marks
+*	the node dirty, update() then recomputes dirty nodes and their descendants in one linear pass.
+*/
+class SceneGraph
+{
+public:
+	std::vector<SceneNode> nodes;
+	SceneGraph();
+	unsigned int addNode(const std::string &name, int parent, const glm::mat4 &local);
+	int findNode(const std::string &name) const;
+	void setLocalTransform(unsigned int node, const glm::mat4 &local);
+	const glm::mat4 &getLocalTransform(unsigned int node) const;
+	const glm::mat4 &getWorldTransform(unsigned int node) const;
+	void update(void);
+	void clear(void);
+	~SceneGraph();
+private:
+	std::vector<unsigned char> dirty;
+	bool anyDirty;
+};
+
@@ -3,8 +3,13 @@
 /*
 *	Constructor for a shader program which compiles and links the shaders.
 *	Geometry shader has a nullptr as its default argument, so you don't necessarily need one.
+*	The program is taken from the binary cache if possible. Otherwise compilation and linking 
+*	are only kicked off here and checked in finish(), so the driver can build several programs
+*	at once: construct all shaders first, then use them. The feature flags select the permutation
+*	that is compiled, see ShaderFeature.
 */
-Shader::Shader(const char *vertexPath, const char *fragmentPath, const char *geometryPath) {
+Shader::Shader(const char *vertexPath, const char *fragmentPath, const char *geometryPath, unsigned int features) 
+	: vertex(0), fragment(0), geometry(0), pending(false), features(features) {
 	std::string vertexCode;
 	std::string fragmentCode;
 	std::string geometryCode;
@@ -37,42 +42,128 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath, const char *geo
 		std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
 		dev::error("ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ");
 	}
+	vertexCode = injectDefines(vertexCode, features);
+	fragmentCode = injectDefines(fragmentCode, features);
+	if (geometryPath != nullptr) {
+		geometryCode = injectDefines(geometryCode, features);
+	}
+	program = ProgramHandle::create();
+	ID = program.get();
+	cacheKey = ShaderCache::makeKey(vertexCode, fragmentCode, geometryCode);
+	if (ShaderCache::load(ID, cacheKey)) {
+		dev::eventLog("Shader-Program successfully loaded from binary cache");
+		return;
+	}
 	const char* vShaderCode = vertexCode.c_str();
 	const char * fShaderCode = fragmentCode.c_str();
-	unsigned int vertex, fragment;
 	vertex = glCreateShader(GL_VERTEX_SHADER);
 	glShaderSource(vertex, 1, &vShaderCode, NULL);
 	glCompileShader(vertex);
-	checkCompileErrors(vertex, "VERTEX");
-	dev::eventLog("Vertex-Shader successfully compiled");
 	fragment = glCreateShader(GL_FRAGMENT_SHADER);
 	glShaderSource(fragment, 1, &fShaderCode, NULL);
 	glCompileShader(fragment);
-	checkCompileErrors(fragment, "FRAGMENT");
-	dev::eventLog("Fragment-Shader successfully compiled");
-	unsigned int geometry;
 	if (geometryPath != nullptr) {
 		const char * gShaderCode = geometryCode.c_str();
 		geometry = glCreateShader(GL_GEOMETRY_SHADER);
 		glShaderSource(geometry, 1, &gShaderCode, NULL);
 		glCompileShader(geometry);
-		checkCompileErrors(geometry, "GEOMETRY");
-		dev::eventLog("Geometry-Shader successfully compiled");
 	}
-	ID = glCreateProgram();
 	glAttachShader(ID, vertex);
 	glAttachShader(ID, fragment);
-	if (geometryPath != nullptr) {
+	if (geometry != 0) {
 		glAttachShader(ID, geometry);
 	}
+	ShaderCache::prepare(ID);
 	glLinkProgram(ID);
-	checkCompileErrors(ID, "PROGRAM");
-	dev::eventLog("Shader-Program successfully linked");
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
-	if (geometryPath != nullptr) {
-		glDeleteShader(geometry);
+	pending = true;
+}
+
+/*
+*	Returns true if the program is ready, i.e. finish() won't have to wait for the driver.
+*	
+*/
+bool Shader::isReady() const {
+	return !pending || ShaderCache::isLinkDone(ID);
+}
+
+/*
+*	Waits for compilation and linking to complete, reports errors and stores the program 
+*	in the binary cache. Called by use(), so calling it explicitly is optional.
+*/
+void Shader::finish() {
+	if (!pending) {
+		return;
+	}
+	pending = false;
+	GLint success;
+	glGetProgramiv(ID, GL_LINK_STATUS, &success);
+	if (success) {
+		dev::eventLog("Shader-Program successfully linked");
+		ShaderCache::store(ID, cacheKey);
+	}
+	else {
+		checkCompileErrors(vertex, "VERTEX");
+		checkCompileErrors(fragment, "FRAGMENT");
+		if (geometry != 0) {
+			checkCompileErrors(geometry, "GEOMETRY");
+		}
+		checkCompileErrors(ID, "PROGRAM");
+	}
+	unsigned int shaders[] = { vertex, fragment, geometry };
+	for (unsigned int i = 0; i < 3; i++) {
+		if (shaders[i] != 0 && glIsShader(shaders[i])) {
+			glDetachShader(ID, shaders[i]);
+			glDeleteShader(shaders[i]);
+		}
+	}
+}
+
+/*
+*	Returns the feature flags this permutation was compiled with.
+*
+*/
+unsigned int Shader::getFeatures() const {
+	return features;
+}
+
+/*
+*	Inserts a #define for every set feature flag right after the #version line, followed by a #line
+*	directive so compile errors still report the line numbers of the file on disk.
+*/
+std::string Shader::injectDefines(const std::string &code, unsigned int features) {
+	static const struct {
+		unsigned int flag;
+		const char *define;
+	} defines[] = {
+		{ SHADER_SHADOWS_HARD, "SHADOWS_HARD" },
+		{ SHADER_SHADOWS_PCF, "SHADOWS_PCF" },
+		{ SHADER_DIFFUSE_MAP, "DIFFUSE_MAP" },
+		{ SHADER_NORMAL_MAP, "NORMAL_MAP" },
+		{ SHADER_INSTANCING, "INSTANCING" },
+		{ SHADER_ALPHA_TEST, "ALPHA_TEST" },
+		{ SHADER_SKINNING, "SKINNING" }
+	};
+	if (features == SHADER_FEATURES_NONE) {
+		return code;
+	}
+	std::string header;
+	for (unsigned int i = 0; i < sizeof(defines) / sizeof(defines[0]); i++) {
+		if (features & defines[i].flag) {
+			header += std::string("#define ") + defines[i].define + "\n";
+		}
+	}
+	size_t insertAt = 0;
+	size_t version = code.find("#version");
+	if (version != std::string::npos) {
+		insertAt = code.find('\n', version);
+		insertAt = insertAt == std::string::npos ? code.size() : insertAt + 1;
+	}
+	std::string prefix = code.substr(0, insertAt);
+	if (!prefix.empty() && prefix.back() != '\n') {
+		prefix += '\n';
 	}
+	unsigned int nextLine = static_cast<unsigned int>(std::count(prefix.begin(), prefix.end(), '\n')) + 1;
+	return prefix + header + "#line " + std::to_string(nextLine) + "\n" + code.substr(insertAt);
 }
 
 /*
@@ -107,101 +198,114 @@ void Shader::checkCompileErrors(GLuint shader, std::string type) {
 *
 */
 void Shader::use() {
-	glUseProgram(ID);
+	finish();
+	GLState::useProgram(ID);
 }
 
 /*
 *	Utility function to set bool uniform variables.
 *
 */
-void Shader::setBool(const std::string &name, bool value) const {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+void Shader::setBool(const char *name, bool value) const {
+	glUniform1i(glGetUniformLocation(ID, name), (int)value);
+	RenderStats::countUniform();
 }
 
 /*
 *	Utility function to set int uniform variables.
 *
 */
-void Shader::setInt(const std::string &name, int value) const {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+void Shader::setInt(const char *name, int value) const {
+	glUniform1i(glGetUniformLocation(ID, name), value);
+	RenderStats::countUniform();
 }
 
 /*
 *	Utility function to set float uniform variables.
 *
 */
-void Shader::setFloat(const std::string &name, float value) const {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+void Shader::setFloat(const char *name, float value) const {
+	glUniform1f(glGetUniformLocation(ID, name), value);
+	RenderStats::countUniform();
 }
 
 /*
 *	Utility function to set vec2 uniform variables.
 *
 */
-void Shader::setVec2(const std::string &name, const glm::vec2 &value) const {
-	glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+void Shader::setVec2(const char *name, const glm::vec2 &value) const {
+	glUniform2fv(glGetUniformLocation(ID, name), 1, &value[0]);
+	RenderStats::countUniform();
 }
 
 /*
 *	Utility function to vec2 bool uniform variables.
 *
 */
-void Shader::setVec2(const std::string &name, float x, float y) const {
-	glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+void Shader::setVec2(const char *name, float x, float y) const {
+	glUniform2f(glGetUniformLocation(ID, name), x, y);
+	RenderStats::countUniform();
 }
 
 /*
 *	Utility function to set vec3 uniform variables.
 *
 */
-void Shader::setVec3(const std::string &name, const glm::vec3 &value) const {
-	glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+void Shader::setVec3(const char *name, const glm::vec3 &value) const {
+	glUniform3fv(glGetUniformLocation(ID, name), 1, &value[0]);
+	RenderStats::countUniform();
 }
 
 /*
 *	Utility function to set vec3 uniform variables.
 *
 */
-void Shader::setVec3(const std::string &name, float x, float y, float z) const {
-	glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+void Shader::setVec3(const char *name, float x, float y, float z) const {
+	glUniform3f(glGetUniformLocation(ID, name), x, y, z);
+	RenderStats::countUniform();
 }
 
 /*
 *	Utility function to set vec4 uniform variables.
 *
 */
-void Shader::setVec4(const std::string &name, const glm::vec4 &value) const {
-	glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+void Shader::setVec4(const char *name, const glm::vec4 &value) const {
+	glUniform4fv(glGetUniformLocation(ID, name), 1, &value[0]);
+	RenderStats::countUniform();
 }
 
 /*
 *	Utility function to set vec4 uniform variables.
 *
 */
-void Shader::setVec4(const std::string &name, float x, float y, float z, float w) const {
-	glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+void Shader::setVec4(const char *name, float x, float y, float z, float w) const {
+	glUniform4f(glGetUniformLocation(ID, name), x, y, z, w);
+	RenderStats::countUniform();
 }
 
 /*
 *	Utility function to set mat2 uniform variables.
 *
 */
-void Shader::setMat2(const std::string &name, const glm::mat2 &mat) const {
-	glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+void Shader::setMat2(const char *name, const glm::mat2 &mat) const {
+	glUniformMatrix2fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
+	RenderStats::countUniform();
 }
 
 /*
 *	Utility function to set mat3 uniform variables.
 *
 */
-void Shader::setMat3(const std::string &name, const glm::mat3 &mat) const {
-	glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+void Shader::setMat3(const char *name, const glm::mat3 &mat) const {
+	glUniformMatrix3fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
+	RenderStats::countUniform();
 }
 
 /*
 *	Utility function to set mat4 uniform variables.
 *
 */
-void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const {
-	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+void Shader::setMat4(const char *name, const glm::mat4 &mat) const {
+	glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
+	RenderStats::countUniform();
 }
\ No newline at end of file
@@ -6,24 +6,55 @@
 #include <iostream>
 #include <fstream>
 #include "Prototypes.hpp"
+#include "ShaderCache.hpp"
+#include "GLState.hpp"
+#include "GLHandle.hpp"
 
+/*
+*	Feature flags of a shader permutation, every set flag is compiled in as a #define of the same
+*	name without the SHADER_ prefix. Without a shadow flag the variant does no shadow lookup at all.
+*/
+enum ShaderFeature : unsigned int {
+	SHADER_FEATURES_NONE	= 0,
+	SHADER_SHADOWS_HARD		= 1 << 0,	// single shadow map tap
+	SHADER_SHADOWS_PCF		= 1 << 1,	// 3x3 percentage closer filtering
+	SHADER_DIFFUSE_MAP		= 1 << 2,	// sample diffuseTexture instead of the diffuseColor uniform
+	SHADER_NORMAL_MAP		= 1 << 3,	// perturb the normal with normalMap, needs tangents
+	SHADER_INSTANCING		= 1 << 4,	// model matrix comes from a per-instance attribute
+	SHADER_ALPHA_TEST		= 1 << 5,	// discard fragments below alphaCutoff
+	SHADER_SKINNING			= 1 << 6	// blend vertices by bone weights from the bonePalette texture buffer
+};
+
+/*
+*	A linked shader program. Shaders own their program and are move-only, pass them by reference.
+*	
+*/
 class Shader {
 public:
 	unsigned int ID;
-	Shader(const char *vertexPath, const char *fragmentPath, const char *geometryPath = nullptr);
+	Shader(const char *vertexPath, const char *fragmentPath, const char *geometryPath = nullptr, unsigned int features = SHADER_FEATURES_NONE);
 	void use();
-	void setBool(const std::string &name, bool value) const;
-	void setInt(const std::string &name, int value) const;
-	void setFloat(const std::string &name, float value) const;
-	void setVec2(const std::string &name, const glm::vec2 &value) const;
-	void setVec2(const std::string &name, float x, float y) const;
-	void setVec3(const std::string &name, const glm::vec3 &value) const;
-	void setVec3(const std::string &name, float x, float y, float z) const;
-	void setVec4(const std::string &name, const glm::vec4 &value) const;
-	void setVec4(const std::string &name, float x, float y, float z, float w) const;
-	void setMat2(const std::string &name, const glm::mat2 &mat) const;
-	void setMat3(const std::string &name, const glm::mat3 &mat) const;
-	void setMat4(const std::string &name, const glm::mat4 &mat) const;
+	bool isReady() const;
+	void finish();
+	unsigned int getFeatures(void) const;
+	void setBool(const char *name, bool value) const;
+	void setInt(const char *name, int value) const;
+	void setFloat(const char *name, float value) const;
+	void setVec2(const char *name, const glm::vec2 &value) const;
+	void setVec2(const char *name, float x, float y) const;
+	void setVec3(const char *name, const glm::vec3 &value) const;
+	void setVec3(const char *name, float x, float y, float z) const;
+	void setVec4(const char *name, const glm::vec4 &value) const;
+	void setVec4(const char *name, float x, float y, float z, float w) const;
+	void setMat2(const char *name, const glm::mat2 &mat) const;
+	void setMat3(const char *name, const glm::mat3 &mat) const;
+	void setMat4(const char *name, const glm::mat4 &mat) const;
 private:
+	ProgramHandle program;
+	unsigned int vertex, fragment, geometry;
+	bool pending;
+	unsigned int features;
+	std::string cacheKey;
 	void checkCompileErrors(GLuint shader, std::string type);
+	static std::string injectDefines(const std::string &code, unsigned int features);
 };
\ No newline at end of file
@@ -0,0 +1,187 @@
+#include "ShaderCache.hpp"
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// The entry points are loaded by hand, a GL 3.3 glad doesn't necessarily include these extensions.
+typedef void (APIENTRYP GETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP MAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+
+static const char *CACHE_DIRECTORY				= "cache/shaders";
+static bool cacheInitialized					= false;
+static bool binarySupported						= false;
+static bool parallelCompileSupported			= false;
+static std::string driverString;
+static GETPROGRAMBINARYPROC getProgramBinary	= nullptr;
+static PROGRAMBINARYPROC programBinary			= nullptr;
+static PROGRAMPARAMETERIPROC programParameteri	= nullptr;
+
+namespace dev {
+	void eventLog(const std::string eventMsg);
+}
+
+/*
+*	Loads the extension entry points and reads the driver string, needs a current context.
+*	
+*/
+void ShaderCache::init() {
+	if (cacheInitialized) {
+		return;
+	}
+	cacheInitialized = true;
+	driverString = std::string(reinterpret_cast<const char*>(glGetString(GL_VENDOR))) + "|"
+		+ reinterpret_cast<const char*>(glGetString(GL_RENDERER)) + "|"
+		+ reinterpret_cast<const char*>(glGetString(GL_VERSION));
+	if (glfwExtensionSupported("GL_ARB_get_program_binary")) {
+		getProgramBinary = (GETPROGRAMBINARYPROC)glfwGetProcAddress("glGetProgramBinary");
+		programBinary = (PROGRAMBINARYPROC)glfwGetProcAddress("glProgramBinary");
+		programParameteri = (PROGRAMPARAMETERIPROC)glfwGetProcAddress("glProgramParameteri");
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		binarySupported = getProgramBinary && programBinary && programParameteri && formats > 0;
+	}
+	MAXSHADERCOMPILERTHREADSPROC maxShaderCompilerThreads = nullptr;
+	if (glfwExtensionSupported("GL_KHR_parallel_shader_compile")) {
+		maxShaderCompilerThreads = (MAXSHADERCOMPILERTHREADSPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+	}
+	else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile")) {
+		maxShaderCompilerThreads = (MAXSHADERCOMPILERTHREADSPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+	}
+	if (maxShaderCompilerThreads) {
+		maxShaderCompilerThreads(0xFFFFFFFF);
+		parallelCompileSupported = true;
+	}
+	if (binarySupported) {
+		CreateDirectoryA("cache", NULL);
+		CreateDirectoryA(CACHE_DIRECTORY, NULL);
+	}
+	dev::eventLog(std::string("Shader binary cache ") + (binarySupported ? "enabled" : "not supported")
+		+ ", parallel shader compilation " + (parallelCompileSupported ? "enabled" : "not supported"));
+}
+
+/*
+*	Builds the cache key from the shader sources and the driver string.
+*	
+*/
+std::string ShaderCache::makeKey(const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode) {
+	init();
+	unsigned long long h = hash(driverString, 14695981039346656037ULL);
+	h = hash(vertexCode, h ^ 'v');
+	h = hash(fragmentCode, h ^ 'f');
+	h = hash(geometryCode, h ^ 'g');
+	char key[17];
+	snprintf(key, sizeof(key), "%016llx", h);
+	return key;
+}
+
+/*
+*	Tries to load the program from the cache. Returns false on a miss or if the driver rejects 
+*	the binary, the program can then be compiled and linked as usual.
+*/
+bool ShaderCache::load(GLuint program, const std::string &key) {
+	init();
+	if (!binarySupported) {
+		return false;
+	}
+	std::ifstream file(getPath(key), std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	GLenum format = 0;
+	GLint length = 0;
+	file.read(reinterpret_cast<char*>(&format), sizeof(format));
+	file.read(reinterpret_cast<char*>(&length), sizeof(length));
+	if (!file || length <= 0) {
+		return false;
+	}
+	std::vector<char> binary(length);
+	file.read(&binary[0], length);
+	if (!file) {
+		return false;
+	}
+	programBinary(program, format, &binary[0], length);
+	GLint success = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	return success != 0;
+}
+
+/*
+*	Must be called before linking, asks the driver to keep the binary retrievable.
+*	
+*/
+void ShaderCache::prepare(GLuint program) {
+	init();
+	if (binarySupported) {
+		programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+}
+
+/*
+*	Writes the binary of a successfully linked program to the cache.
+*	
+*/
+void ShaderCache::store(GLuint program, const std::string &key) {
+	init();
+	if (!binarySupported) {
+		return;
+	}
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) {
+		return;
+	}
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	getProgramBinary(program, length, NULL, &format, &binary[0]);
+	std::ofstream file(getPath(key), std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+	file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+	file.write(&binary[0], length);
+}
+
+/*
+*	Returns true if linking has finished, so querying the link status won't block. Without 
+*	parallel compilation there is no way to ask, so it always returns true.
+*/
+bool ShaderCache::isLinkDone(GLuint program) {
+	init();
+	if (!parallelCompileSupported) {
+		return true;
+	}
+	GLint done = GL_TRUE;
+	glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &done);
+	return done != GL_FALSE;
+}
+
+/*
+*	Returns the file a cache entry is stored in.
+*	
+*/
+std::string ShaderCache::getPath(const std::string &key) {
+	return std::string(CACHE_DIRECTORY) + "/" + key + ".bin";
+}
+
+/*
+*	64-bit FNV-1a hash.
+*	
+*/
+unsigned long long ShaderCache::hash(const std::string &data, unsigned long long seed) {
+	unsigned long long h = seed;
+	for (unsigned int i = 0; i < data.size(); i++) {
+		h ^= static_cast<unsigned char>(data[i]);
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <string>
+#include <fstream>
+#include <vector>
+#include <Windows.h>
+
+/*
+*	On-disk cache of linked shader programs (glGetProgramBinary / glProgramBinary). Entries are keyed
+*	by a hash of the shader sources and the driver string, so a driver update simply misses the cache.
+*	Also enables parallel shader compilation (KHR/ARB_parallel_shader_compile) where the driver offers it.
+*/
+class ShaderCache
+{
+public:
+	static std::string makeKey(const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode);
+	static bool load(GLuint program, const std::string &key);
+	static void prepare(GLuint program);
+	static void store(GLuint program, const std::string &key);
+	static bool isLinkDone(GLuint program);
+private:
+	static void init(void);
+	static std::string getPath(const std::string &key);
+	static unsigned long long hash(const std::string &data, unsigned long long seed);
+};
+
@@ -0,0 +1,81 @@
+#include "ShaderVariants.hpp"
+
+/*
+*	Constructor, only remembers the source files. onCreate is called once for every variant the
+*	first time it is used (with the program bound), e.g. to set its sampler units.
+*/
+ShaderVariants::ShaderVariants(const char *vertexPath, const char *fragmentPath, const char *geometryPath, void (*onCreate)(Shader&))
+	: vertexPath(vertexPath), fragmentPath(fragmentPath), geometryPath(geometryPath != nullptr ? geometryPath : ""), onCreate(onCreate) {
+
+}
+
+/*
+*	Starts compiling a variant without waiting for it, so several variants can be built in parallel
+*	by the driver. Useful at startup for every variant a preset might switch to.
+*/
+void ShaderVariants::prepare(unsigned int features) {
+	find(features);
+}
+
+/*
+*	Returns the variant with the given features, compiling it on first use. The returned shader is bound.
+*
+*/
+Shader &ShaderVariants::get(unsigned int features) {
+	Variant &variant = find(features);
+	variant.shader->use();
+	if (!variant.configured) {
+		variant.configured = true;
+		if (onCreate != nullptr) {
+			onCreate(*variant.shader);
+		}
+	}
+	return *variant.shader;
+}
+
+/*
+*	Returns true if the variant has finished compiling, so get() won't wait for the driver. Starts 
+*	compiling it if it wasn't requested before.
+*/
+bool ShaderVariants::isReady(unsigned int features) {
+	return find(features).shader->isReady();
+}
+
+/*
+*	Returns the number of variants compiled so far.
+*
+*/
+unsigned int ShaderVariants::getVariantCount() const {
+	return static_cast<unsigned int>(variants.size());
+}
+
+/*
+*	Looks up a variant and creates it if it doesn't exist yet.
+*
+*/
+ShaderVariants::Variant &ShaderVariants::find(unsigned int features) {
+	std::map<unsigned int, Variant>::iterator it = variants.find(features);
+	if (it != variants.end()) {
+		return it->second;
+	}
+	Variant variant;
+	variant.shader = new Shader(
+		vertexPath.c_str(),
+		fragmentPath.c_str(),
+		geometryPath.empty() ? nullptr : geometryPath.c_str(),
+		features
+	);
+	variant.configured = false;
+	dev::eventLog("Shader variant " + std::to_string(features) + " of " + fragmentPath + " created");
+	return variants.insert(std::make_pair(features, variant)).first->second;
+}
+
+/*
+*	Destructor, the programs themselves are released together with the context.
+*
+*/
+ShaderVariants::~ShaderVariants() {
+	for (std::map<unsigned int, Variant>::iterator it = variants.begin(); it != variants.end(); it++) {
+		delete it->second.shader;
+	}
+}
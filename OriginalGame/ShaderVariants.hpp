@@ -0,0 +1,28 @@
+#pragma once
+#include <map>
+#include "Shader.hpp"
+
+/*
+*	All permutations of one vertex / fragment (/ geometry) shader combination. Variants are
+*	compiled the first time they are requested and kept, keyed by their feature flags.
+*/
+class ShaderVariants
+{
+public:
+	ShaderVariants(const char *vertexPath, const char *fragmentPath, const char *geometryPath = nullptr, void (*onCreate)(Shader&) = nullptr);
+	void prepare(unsigned int features);
+	Shader &get(unsigned int features);
+	bool isReady(unsigned int features);
+	unsigned int getVariantCount(void) const;
+	~ShaderVariants();
+private:
+	struct Variant {
+		Shader *shader;
+		bool configured;
+	};
+	std::string vertexPath, fragmentPath, geometryPath;
+	void (*onCreate)(Shader&);
+	std::map<unsigned int, Variant> variants;
+	Variant &find(unsigned int features);
+};
+
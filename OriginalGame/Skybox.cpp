@@ -49,8 +49,8 @@ float skyboxVertices[] = {
 *	Constructor.
 *	
 */
-Skybox::Skybox(const std::string &path) {
-	skyboxShader = new Shader("src/shaders/skyboxShader.vert", "src/shaders/skyboxShader.frag");
+Skybox::Skybox(const std::string &path) 
+	: skyboxShader("src/shaders/skyboxShader.vert", "src/shaders/skyboxShader.frag") {
 	setUp();
 	setBuffers();
 	directory = getDirectory(path);
@@ -62,7 +62,7 @@ Skybox::Skybox(const std::string &path) {
 		directory + "/front.jpg",
 		directory + "/back.jpg",
 	};
-	skyboxTexture = dev::loadCubemap(faces);
+	skyboxTexture = TextureHandle(dev::loadCubemap(faces));
 }
 
 /*
@@ -70,7 +70,7 @@ Skybox::Skybox(const std::string &path) {
 *	
 */
 void Skybox::useShader() {
-	skyboxShader->use();
+	skyboxShader.use();
 }
 
 /*
@@ -79,7 +79,7 @@ void Skybox::useShader() {
 */
 void Skybox::setUp() {
 	useShader();
-	skyboxShader->setInt("skybox", 0);
+	skyboxShader.setInt("skybox", 0);
 }
 
 void Skybox::setUniforms(Camera *camera, const int SCR_WIDTH, const int SCR_HEIGHT) {
@@ -92,8 +92,8 @@ void Skybox::setUniforms(Camera *camera, const int SCR_WIDTH, const int SCR_HEIG
 							0.1f,
 							100.0f
 						);
-	skyboxShader->setMat4("view", view);
-	skyboxShader->setMat4("projection", projection);
+	skyboxShader.setMat4("view", view);
+	skyboxShader.setMat4("projection", projection);
 }
 
 /*
@@ -109,11 +109,13 @@ std::string Skybox::getDirectory(const std::string &path) {
 *	
 */
 void Skybox::setBuffers() {
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
+	VAO = VertexArrayHandle::create();
+	VBO = BufferHandle::create();
 	bindVAO();
 	bindVBO();
 	glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
+	RenderStats::countUpload(sizeof(skyboxVertices));
+	GPUMemory::trackBuffer(VBO.get(), sizeof(skyboxVertices), GPU_MEMORY_GEOMETRY, "Skybox");
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 }
@@ -123,7 +125,7 @@ void Skybox::setBuffers() {
 *	
 */
 void Skybox::bindVAO() {
-	glBindVertexArray(VAO);
+	GLState::bindVertexArray(VAO.get());
 }
 
 /*
@@ -131,7 +133,7 @@ void Skybox::bindVAO() {
 *	
 */
 void Skybox::bindVBO() {
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, VBO.get());
 }
 
 /*
@@ -139,8 +141,7 @@ void Skybox::bindVBO() {
 *	
 */
 void Skybox::bindTexture() {
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
+	GLState::bindTexture(0, GL_TEXTURE_CUBE_MAP, skyboxTexture.get());
 }
 
 /*
@@ -149,12 +150,5 @@ void Skybox::bindTexture() {
 */
 void Skybox::draw() {
 	glDrawArrays(GL_TRIANGLES, 0, 36);
-}
-
-/*
-*	Destructor.
-*	
-*/
-Skybox::~Skybox() {
-	delete skyboxShader;
+	RenderStats::countDraw(GL_TRIANGLES, 36);
 }
@@ -3,6 +3,7 @@
 #include <vector>
 #include <string>
 #include "Shader.hpp"
+#include "GLHandle.hpp"
 
 namespace dev {
 	unsigned int loadCubemap(std::vector<std::string> faces);
@@ -18,12 +19,12 @@ public:
 	void bindVBO(void);
 	void bindTexture(void);
 	void draw(void);
-	~Skybox();
 private:
-	unsigned int VAO, VBO;
-	unsigned int skyboxTexture;
+	VertexArrayHandle VAO;
+	BufferHandle VBO;
+	TextureHandle skyboxTexture;
 	std::string directory;
-	Shader *skyboxShader;
+	Shader skyboxShader;
 	std::vector<std::string> faces;
 	void setUp(void);
 	void setBuffers(void);
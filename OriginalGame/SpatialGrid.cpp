@@ -0,0 +1,342 @@
+#include "SpatialGrid.hpp"
+#include <algorithm>
+#include <cmath>
+
+static const int MAX_RAY_HISTORY = 17;	// cells a ray remembers to skip neighbourhoods it already tested
+
+/*
+*	Constructor, the finest level has cells of cellSize, every level above doubles it.
+*	
+*/
+SpatialGrid::SpatialGrid(const glm::vec3 &areaMin, const glm::vec3 &areaMax, float cellSize) 
+	: areaMin(areaMin), areaMax(areaMax), minY(areaMin.y), maxY(areaMax.y) {
+	for (unsigned int i = 0; i < LEVELS; i++) {
+		Level &level = levels[i];
+		level.cellSize = cellSize * static_cast<float>(1 << i);
+		level.width = std::max(1, static_cast<int>(std::ceil((areaMax.x - areaMin.x) / level.cellSize)));
+		level.depth = std::max(1, static_cast<int>(std::ceil((areaMax.z - areaMin.z) / level.cellSize)));
+		level.maxRadius = 0.0f;
+		level.heads.assign(level.width * level.depth, -1);
+	}
+}
+
+/*
+*	Inserts an entity right away and returns its id, ids are handed out in order from 0.
+*	
+*/
+unsigned int SpatialGrid::add(const glm::vec3 &center, float radius) {
+	Entity entity;
+	entity.center = center;
+	entity.radius = radius;
+	entity.level = LEVELS - 1;
+	for (unsigned int i = 0; i < LEVELS; i++) {
+		if (radius <= levels[i].cellSize) {
+			entity.level = i;
+			break;
+		}
+	}
+	entity.cell = -1;
+	entity.next = -1;
+	entity.previous = -1;
+	Level &level = levels[entity.level];
+	level.maxRadius = std::max(level.maxRadius, radius);
+	entities.push_back(entity);
+	unsigned int id = static_cast<unsigned int>(entities.size() - 1);
+	link(id);
+	return id;
+}
+
+/*
+*	Queues a new center for an entity, it takes effect at the next commit().
+*	
+*/
+void SpatialGrid::move(unsigned int id, const glm::vec3 &center) {
+	Move entry = { id, center };
+	moves.push_back(entry);
+}
+
+/*
+*	Applies all queued moves, entities that stay within their cell only have their center updated.
+*	Queries see the state of the last commit until the next one.
+*/
+void SpatialGrid::commit() {
+	for (unsigned int i = 0; i < moves.size(); i++) {
+		Entity &entity = entities[moves[i].id];
+		entity.center = moves[i].center;
+		if (cellOf(levels[entity.level], entity.center) != entity.cell) {
+			unlink(moves[i].id);
+			link(moves[i].id);
+		}
+		else {
+			minY = std::min(minY, entity.center.y - entity.radius);
+			maxY = std::max(maxY, entity.center.y + entity.radius);
+		}
+	}
+	moves.clear();
+}
+
+/*
+*	Returns the number of entities.
+*	
+*/
+unsigned int SpatialGrid::getCount() const {
+	return static_cast<unsigned int>(entities.size());
+}
+
+/*
+*	Returns an entity's center as of the last commit().
+*	
+*/
+const glm::vec3 &SpatialGrid::getCenter(unsigned int id) const {
+	return entities[id].center;
+}
+
+/*
+*	Appends the ids of all entities whose sphere overlaps the given sphere.
+*	
+*/
+void SpatialGrid::queryRadius(const glm::vec3 &center, float radius, std::vector<unsigned int> &result) const {
+	for (unsigned int l = 0; l < LEVELS; l++) {
+		const Level &level = levels[l];
+		float reach = radius + level.maxRadius;
+		int range[4];
+		cellRange(level, center.x - reach, center.z - reach, center.x + reach, center.z + reach, range);
+		for (int z = range[1]; z <= range[3]; z++) {
+			for (int x = range[0]; x <= range[2]; x++) {
+				for (int i = level.heads[z * level.width + x]; i >= 0; i = entities[i].next) {
+					glm::vec3 offset = entities[i].center - center;
+					float sum = radius + entities[i].radius;
+					if (glm::dot(offset, offset) <= sum * sum) {
+						result.push_back(static_cast<unsigned int>(i));
+					}
+				}
+			}
+		}
+	}
+}
+
+/*
+*	Appends the ids of all entities whose sphere is at least partly inside the frustum. Cells are
+*	tested as boxes first, only the entities of cells that pass are tested one by one.
+*/
+void SpatialGrid::queryFrustum(const glm::mat4 &viewProjection, std::vector<unsigned int> &result) const {
+	// planes of the frustum from the rows of the matrix, normals point inwards
+	glm::vec4 planes[6];
+	for (int i = 0; i < 3; i++) {
+		glm::vec4 row(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+		glm::vec4 w(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+		planes[i * 2] = w + row;
+		planes[i * 2 + 1] = w - row;
+	}
+	for (int p = 0; p < 6; p++) {
+		planes[p] = planes[p] / glm::length(glm::vec3(planes[p]));
+	}
+
+	for (unsigned int l = 0; l < LEVELS; l++) {
+		const Level &level = levels[l];
+		float grow = level.maxRadius;
+		for (int z = 0; z < level.depth; z++) {
+			for (int x = 0; x < level.width; x++) {
+				int cell = z * level.width + x;
+				if (level.heads[cell] < 0) {
+					continue;
+				}
+				glm::vec3 boxMin(areaMin.x + x * level.cellSize - grow, minY, areaMin.z + z * level.cellSize - grow);
+				glm::vec3 boxMax(boxMin.x + level.cellSize + 2.0f * grow, maxY, boxMin.z + level.cellSize + 2.0f * grow);
+				bool outside = false;
+				for (int p = 0; p < 6 && !outside; p++) {
+					// the box corner farthest along the plane's normal
+					glm::vec3 corner(
+						planes[p].x > 0.0f ? boxMax.x : boxMin.x,
+						planes[p].y > 0.0f ? boxMax.y : boxMin.y,
+						planes[p].z > 0.0f ? boxMax.z : boxMin.z
+					);
+					outside = glm::dot(glm::vec3(planes[p]), corner) + planes[p].w < 0.0f;
+				}
+				if (outside) {
+					continue;
+				}
+				for (int i = level.heads[cell]; i >= 0; i = entities[i].next) {
+					const Entity &entity = entities[i];
+					bool inside = true;
+					for (int p = 0; p < 6 && inside; p++) {
+						inside = glm::dot(glm::vec3(planes[p]), entity.center) + planes[p].w >= -entity.radius;
+					}
+					if (inside) {
+						result.push_back(static_cast<unsigned int>(i));
+					}
+				}
+			}
+		}
+	}
+}
+
+/*
+*	Returns the id of the first entity the ray (of the given thickness, i.e. a swept sphere) hits 
+*	within maxDistance and its distance, or -1. Every level is walked cell by cell along the ray, 
+*	testing the neighbourhood its loose cells can reach into. direction has to be normalized. With 
+*	a test, spheres are only the broad phase and test decides whether and where an entity is hit.
+*/
+int SpatialGrid::queryRay(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, float thickness, float &distance, RayTest test, void *context) const {
+	int nearest = -1;
+	distance = maxDistance;
+
+	// clip the ray to the area on the XZ plane
+	float enter = 0.0f, exit = maxDistance;
+	for (int a = 0; a < 3; a += 2) {
+		if (direction[a] == 0.0f) {
+			if (origin[a] < areaMin[a] || origin[a] > areaMax[a]) {
+				return -1;
+			}
+			continue;
+		}
+		float t0 = (areaMin[a] - origin[a]) / direction[a];
+		float t1 = (areaMax[a] - origin[a]) / direction[a];
+		enter = std::max(enter, std::min(t0, t1));
+		exit = std::min(exit, std::max(t0, t1));
+	}
+	if (enter > exit) {
+		return -1;
+	}
+
+	for (unsigned int l = 0; l < LEVELS; l++) {
+		const Level &level = levels[l];
+		if (level.maxRadius == 0.0f) {
+			continue;
+		}
+		int ring = static_cast<int>(std::ceil(level.maxRadius / level.cellSize));
+		// how far back along the ray an entity tested from a later cell can still be hit
+		float horizontal = std::sqrt(direction.x * direction.x + direction.z * direction.z);
+		float slack = horizontal > 0.0f ? ((4 * ring + 1) * level.cellSize * 1.415f + thickness) / horizontal : 1e30f;
+		glm::vec3 start = origin + direction * enter;
+		int x = std::min(level.width - 1, std::max(0, static_cast<int>((start.x - areaMin.x) / level.cellSize)));
+		int z = std::min(level.depth - 1, std::max(0, static_cast<int>((start.z - areaMin.z) / level.cellSize)));
+		int stepX = direction.x > 0.0f ? 1 : -1, stepZ = direction.z > 0.0f ? 1 : -1;
+		float boundaryX = areaMin.x + (x + (stepX > 0 ? 1 : 0)) * level.cellSize;
+		float boundaryZ = areaMin.z + (z + (stepZ > 0 ? 1 : 0)) * level.cellSize;
+		float nextX = direction.x != 0.0f ? (boundaryX - origin.x) / direction.x : 1e30f;
+		float nextZ = direction.z != 0.0f ? (boundaryZ - origin.z) / direction.z : 1e30f;
+		float deltaX = direction.x != 0.0f ? level.cellSize / std::fabs(direction.x) : 1e30f;
+		float deltaZ = direction.z != 0.0f ? level.cellSize / std::fabs(direction.z) : 1e30f;
+		int historyX[MAX_RAY_HISTORY], historyZ[MAX_RAY_HISTORY];
+		int historyCount = 0;
+		float cellEnter = enter;
+		while (true) {
+			if (cellEnter - slack > distance) {
+				break;
+			}
+			for (int nz = std::max(0, z - ring); nz <= std::min(level.depth - 1, z + ring); nz++) {
+				for (int nx = std::max(0, x - ring); nx <= std::min(level.width - 1, x + ring); nx++) {
+					// neighbourhoods of consecutive cells overlap, skip cells a recent step already tested
+					bool tested = false;
+					for (int h = 0; h < historyCount && !tested; h++) {
+						tested = std::abs(nx - historyX[h]) <= ring && std::abs(nz - historyZ[h]) <= ring;
+					}
+					if (tested) {
+						continue;
+					}
+					for (int i = level.heads[nz * level.width + nx]; i >= 0; i = entities[i].next) {
+						glm::vec3 offset = origin - entities[i].center;
+						float reach = entities[i].radius + thickness;
+						float b = glm::dot(offset, direction);
+						float c = glm::dot(offset, offset) - reach * reach;
+						float discriminant = b * b - c;
+						if (discriminant < 0.0f || (c > 0.0f && b > 0.0f)) {
+							continue;
+						}
+						float hit = std::max(0.0f, -b - std::sqrt(discriminant));
+						if (hit >= distance) {
+							continue;
+						}
+						if (test == nullptr) {
+							distance = hit;
+							nearest = i;
+						}
+						else if (test(context, static_cast<unsigned int>(i), distance)) {
+							nearest = i;
+						}
+					}
+				}
+			}
+			if (historyCount < MAX_RAY_HISTORY) {
+				historyCount++;
+			}
+			for (int h = historyCount - 1; h > 0; h--) {
+				historyX[h] = historyX[h - 1];
+				historyZ[h] = historyZ[h - 1];
+			}
+			historyX[0] = x;
+			historyZ[0] = z;
+			if (nextX < nextZ) {
+				cellEnter = nextX;
+				nextX += deltaX;
+				x += stepX;
+			}
+			else {
+				cellEnter = nextZ;
+				nextZ += deltaZ;
+				z += stepZ;
+			}
+			if (cellEnter > exit || x < 0 || z < 0 || x >= level.width || z >= level.depth) {
+				break;
+			}
+		}
+	}
+	return nearest;
+}
+
+/*
+*	Returns the cell containing a position, positions outside the area fall into the border cells.
+*	
+*/
+int SpatialGrid::cellOf(const Level &level, const glm::vec3 &position) const {
+	int x = std::min(level.width - 1, std::max(0, static_cast<int>(std::floor((position.x - areaMin.x) / level.cellSize))));
+	int z = std::min(level.depth - 1, std::max(0, static_cast<int>(std::floor((position.z - areaMin.z) / level.cellSize))));
+	return z * level.width + x;
+}
+
+/*
+*	Puts an entity at the front of the list of the cell containing its center.
+*	
+*/
+void SpatialGrid::link(unsigned int id) {
+	Entity &entity = entities[id];
+	Level &level = levels[entity.level];
+	entity.cell = cellOf(level, entity.center);
+	entity.previous = -1;
+	entity.next = level.heads[entity.cell];
+	if (entity.next >= 0) {
+		entities[entity.next].previous = static_cast<int>(id);
+	}
+	level.heads[entity.cell] = static_cast<int>(id);
+	minY = std::min(minY, entity.center.y - entity.radius);
+	maxY = std::max(maxY, entity.center.y + entity.radius);
+}
+
+/*
+*	Takes an entity out of its cell's list.
+*	
+*/
+void SpatialGrid::unlink(unsigned int id) {
+	Entity &entity = entities[id];
+	if (entity.previous >= 0) {
+		entities[entity.previous].next = entity.next;
+	}
+	else {
+		levels[entity.level].heads[entity.cell] = entity.next;
+	}
+	if (entity.next >= 0) {
+		entities[entity.next].previous = entity.previous;
+	}
+}
+
+/*
+*	Returns the cells (first x, first z, last x, last z) overlapping a rectangle, clamped to the grid.
+*	
+*/
+void SpatialGrid::cellRange(const Level &level, float minX, float minZ, float maxX, float maxZ, int range[4]) const {
+	range[0] = std::min(level.width - 1, std::max(0, static_cast<int>(std::floor((minX - areaMin.x) / level.cellSize))));
+	range[1] = std::min(level.depth - 1, std::max(0, static_cast<int>(std::floor((minZ - areaMin.z) / level.cellSize))));
+	range[2] = std::min(level.width - 1, std::max(0, static_cast<int>(std::floor((maxX - areaMin.x) / level.cellSize))));
+	range[3] = std::min(level.depth - 1, std::max(0, static_cast<int>(std::floor((maxZ - areaMin.z) / level.cellSize))));
+}
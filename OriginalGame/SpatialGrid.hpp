@@ -0,0 +1,57 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+/*
+*	Spatial index over bounding spheres as a stack of loose grids on the XZ plane, a flattened loose 
+*	quadtree. Each entity lives in one cell of the finest level whose cells are at least as large as 
+*	its radius, found by its center, so moving an entity only relinks it between two cell lists. 
+*	Queries visit the cells of every level grown by that level's largest radius. Entities are 
+*	expected to stay inside the area, ones outside are kept in the border cells.
+*/
+class SpatialGrid
+{
+public:
+	// narrow phase of a ray query: returns true and lowers distance if the entity itself is hit closer
+	typedef bool (*RayTest)(void *context, unsigned int id, float &distance);
+	static const unsigned int LEVELS = 4;
+	SpatialGrid(const glm::vec3 &areaMin, const glm::vec3 &areaMax, float cellSize);
+	unsigned int add(const glm::vec3 &center, float radius);
+	void move(unsigned int id, const glm::vec3 &center);
+	void commit(void);
+	unsigned int getCount(void) const;
+	const glm::vec3 &getCenter(unsigned int id) const;
+	void queryRadius(const glm::vec3 &center, float radius, std::vector<unsigned int> &result) const;
+	void queryFrustum(const glm::mat4 &viewProjection, std::vector<unsigned int> &result) const;
+	int queryRay(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, float thickness, float &distance, RayTest test = nullptr, void *context = nullptr) const;
+private:
+	struct Entity {
+		glm::vec3 center;
+		float radius;
+		int level;
+		int cell;
+		int next;			// in the cell's list, -1 at the end
+		int previous;
+	};
+	struct Level {
+		float cellSize;
+		int width;
+		int depth;
+		float maxRadius;	// largest entity in this level, grows only
+		std::vector<int> heads;
+	};
+	struct Move {
+		unsigned int id;
+		glm::vec3 center;
+	};
+	glm::vec3 areaMin, areaMax;
+	float minY, maxY;		// vertical extent of all entities, grows only
+	Level levels[LEVELS];
+	std::vector<Entity> entities;
+	std::vector<Move> moves;
+	int cellOf(const Level &level, const glm::vec3 &position) const;
+	void link(unsigned int id);
+	void unlink(unsigned int id);
+	void cellRange(const Level &level, float minX, float minZ, float maxX, float maxZ, int range[4]) const;
+};
+
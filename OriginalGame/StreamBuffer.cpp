@@ -0,0 +1,178 @@
+#include "StreamBuffer.hpp"
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+// loaded by hand like the shader cache's entry points, a GL 3.3 glad doesn't include ARB_buffer_storage
+typedef void (APIENTRYP BUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+namespace dev {
+	void eventLog(const std::string eventMsg);
+}
+
+/*
+*	Returns the stream buffer shared by all per-frame uploads, it is created on first use (which requires a current GL context).
+*	
+*/
+StreamBuffer &StreamBuffer::get() {
+	static StreamBuffer *stream = new StreamBuffer(1 << 20);
+	return *stream;
+}
+
+/*
+*	Constructor, allocates FRAME_COUNT regions of frameSize bytes each.
+*	
+*/
+StreamBuffer::StreamBuffer(GLsizeiptr frameSize) 
+	: frameSize(frameSize), persistent(false), persistentData(nullptr), frame(0), frameOffset(0), mappedSize(0), overflowReported(false) {
+	for (unsigned int i = 0; i < FRAME_COUNT; i++) {
+		fences[i] = 0;
+	}
+	BUFFERSTORAGEPROC bufferStorage = nullptr;
+	if (glfwExtensionSupported("GL_ARB_buffer_storage")) {
+		bufferStorage = (BUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+	}
+	glGenBuffers(1, &buffer);
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (bufferStorage) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		bufferStorage(GL_COPY_WRITE_BUFFER, frameSize * FRAME_COUNT, NULL, flags);
+		persistentData = static_cast<char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, frameSize * FRAME_COUNT, flags));
+		persistent = persistentData != nullptr;
+	}
+	if (!persistent) {
+		glBufferData(GL_COPY_WRITE_BUFFER, frameSize * FRAME_COUNT, NULL, GL_STREAM_DRAW);
+	}
+	GPUMemory::trackBuffer(buffer, frameSize * FRAME_COUNT, GPU_MEMORY_STREAMING, "Stream buffer");
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	dev::eventLog(std::string("Stream buffer created, ") + (persistent ? "persistently mapped" : "using orphaning"));
+}
+
+/*
+*	Moves on to the next frame's region, waiting until the GPU is done with what was written into it
+*	FRAME_COUNT frames ago. Call once per frame before anything is written.
+*/
+void StreamBuffer::beginFrame() {
+	frame = (frame + 1) % FRAME_COUNT;
+	frameOffset = 0;
+	waitForRegion(frame);
+}
+
+/*
+*	Fences the current frame's region, call once per frame after the last draw that reads from it.
+*	
+*/
+void StreamBuffer::endFrame() {
+	if (fences[frame] != 0) {
+		glDeleteSync(fences[frame]);
+	}
+	fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/*
+*	Reserves size bytes in the current frame's region and returns a pointer to write them to, offset
+*	receives their position in the buffer (a multiple of alignment, e.g. the vertex size so the offset
+*	can be used as first vertex). Returns nullptr if the frame's region is full. Must be followed by unmap().
+*/
+void *StreamBuffer::map(GLsizeiptr size, GLsizeiptr alignment, GLintptr &offset) {
+	GLsizeiptr start = (frameOffset + alignment - 1) / alignment * alignment;
+	if (start + size > frameSize) {
+		if (!overflowReported) {
+			overflowReported = true;
+			dev::eventLog("Stream buffer region full, per-frame data dropped");
+		}
+		return nullptr;
+	}
+	frameOffset = start + size;
+	offset = frame * frameSize + start;
+	mappedSize = size;
+	if (persistent) {
+		return persistentData + offset;
+	}
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	// the region is fenced, so the driver doesn't need to synchronize this mapping
+	return glMapBufferRange(
+		GL_COPY_WRITE_BUFFER,
+		offset,
+		size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+	);
+}
+
+/*
+*	Finishes writing the range returned by map(), after this it can be drawn from.
+*	
+*/
+void StreamBuffer::unmap() {
+	if (!persistent) {
+		GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	}
+	RenderStats::countUpload(mappedSize);
+	mappedSize = 0;
+}
+
+/*
+*	Returns the buffer object, e.g. to point vertex attributes at it.
+*	
+*/
+GLuint StreamBuffer::getBuffer() const {
+	return buffer;
+}
+
+/*
+*	Returns the number of bytes that can be written per frame.
+*	
+*/
+GLsizeiptr StreamBuffer::getFrameSize() const {
+	return frameSize;
+}
+
+/*
+*	Returns true if the buffer is persistently mapped.
+*	
+*/
+bool StreamBuffer::isPersistent() const {
+	return persistent;
+}
+
+/*
+*	Makes sure the GPU no longer reads the given region. A persistent buffer has to wait for the fence,
+*	the fallback instead orphans the whole buffer if the fence isn't signaled yet, so it never stalls.
+*/
+void StreamBuffer::waitForRegion(unsigned int region) {
+	if (fences[region] == 0) {
+		return;
+	}
+	if (persistent) {
+		GLenum result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		while (result == GL_TIMEOUT_EXPIRED) {
+			result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		}
+	}
+	else if (glClientWaitSync(fences[region], 0, 0) == GL_TIMEOUT_EXPIRED) {
+		orphan();
+		return;
+	}
+	glDeleteSync(fences[region]);
+	fences[region] = 0;
+}
+
+/*
+*	Gives the buffer's storage to the driver and starts over with fresh memory, which drops all fences.
+*	
+*/
+void StreamBuffer::orphan() {
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, frameSize * FRAME_COUNT, NULL, GL_STREAM_DRAW);
+	for (unsigned int i = 0; i < FRAME_COUNT; i++) {
+		if (fences[i] != 0) {
+			glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <string>
+#include "GLState.hpp"
+
+/*
+*	Ring buffer for data that is rewritten every frame (glyph quads, instance data, ...). The buffer
+*	is split into FRAME_COUNT regions, each fenced after its frame, so the CPU never writes memory
+*	the GPU may still read. Uses a persistent mapping (ARB_buffer_storage) where available and falls
+*	back to unsynchronized mapping with orphaning on plain GL 3.3.
+*/
+class StreamBuffer
+{
+public:
+	static const unsigned int FRAME_COUNT = 3;
+	static StreamBuffer &get(void);
+	void beginFrame(void);
+	void endFrame(void);
+	void *map(GLsizeiptr size, GLsizeiptr alignment, GLintptr &offset);
+	void unmap(void);
+	GLuint getBuffer(void) const;
+	GLsizeiptr getFrameSize(void) const;
+	bool isPersistent(void) const;
+private:
+	GLuint buffer;
+	GLsizeiptr frameSize;
+	bool persistent;
+	char *persistentData;
+	GLsync fences[FRAME_COUNT];
+	unsigned int frame;
+	GLsizeiptr frameOffset;
+	GLsizeiptr mappedSize;
+	bool overflowReported;
+	StreamBuffer(GLsizeiptr frameSize);
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer &operator=(const StreamBuffer&) = delete;
+	void waitForRegion(unsigned int region);
+	void orphan(void);
+};
+
@@ -0,0 +1,152 @@
+#include "TargetBatch.hpp"
+#include "StreamBuffer.hpp"
+#include "JobSystem.hpp"
+#include "BonePalette.hpp"
+
+static const unsigned int TARGET_GRAIN = 64;	// targets per job
+static const float POSE_STAGGER			= 0.37f;	// seconds between the animations of consecutive targets
+
+/*
+*	Constructor, base places the model at a target's position (scale, orientation, feet offset).
+*	
+*/
+TargetBatch::TargetBatch(Model *model, const glm::mat4 &base) 
+	: model(model), base(base), offset(0), paletteOffset(-1), uploaded(false) {
+}
+
+/*
+*	Reserves a bone palette range per target and evaluates their poses in parallel, after the scene's
+*	objects filled theirs and before BonePalette::upload(). Returns the number of skinned targets.
+*/
+unsigned int TargetBatch::animate(const TargetMotion &motion, float deltaTime) {
+	palettes.clear();
+	if (!model->isSkinned()) {
+		return 0;
+	}
+	unsigned int count = motion.getCount();
+	for (unsigned int i = static_cast<unsigned int>(animators.size()); i < count; i++) {
+		animators.push_back(Animator());
+		animators.back().update(*model, i * POSE_STAGGER);
+	}
+	unsigned int boneCount = static_cast<unsigned int>(model->bones.size());
+	for (unsigned int i = 0; i < count; i++) {
+		palettes.push_back(BonePalette::allocate(boneCount));
+	}
+	JobSystem::parallelFor(count, TARGET_GRAIN, [&](unsigned int i) {
+		animators[i].update(*model, deltaTime);
+		animators[i].evaluate(*model, BonePalette::getMatrices(palettes[i]));
+	});
+	return count;
+}
+
+/*
+*	Interpolates the targets, picks their levels of detail and streams their instance matrices sorted
+*	by level of detail, visible ones first. visible holds a flag per target, null means all are. posed
+*	tells that the palettes of animate() were uploaded, their offsets are then streamed in the same 
+*	order. Has to run between the stream buffer's beginFrame and endFrame.
+*/
+void TargetBatch::prepare(const TargetMotion &motion, const glm::vec3 &viewPos, float projectionScale, const char *visible, bool posed) {
+	unsigned int count = motion.getCount();
+	uploaded = false;
+	paletteOffset = -1;
+	x.resize(count);
+	y.resize(count);
+	z.resize(count);
+	lods.resize(count, 0);
+	slots.resize(count);
+	if (count == 0) {
+		return;
+	}
+	motion.interpolate(&x[0], &y[0], &z[0]);
+	JobSystem::parallelFor(count, TARGET_GRAIN, [&](unsigned int i) {
+		lods[i] = model->selectLOD(transform(i), viewPos, projectionScale, lods[i]);
+	});
+
+	for (unsigned int lod = 0; lod < Mesh::MAX_LODS; lod++) {
+		lodCounts[lod] = 0;
+	}
+	for (unsigned int i = 0; i < count; i++) {
+		if (visible == nullptr || visible[i]) {
+			slots[i] = lodCounts[lods[i]]++;
+		}
+	}
+	for (unsigned int lod = 0; lod < Mesh::MAX_LODS; lod++) {
+		lodVisible[lod] = lodCounts[lod];
+	}
+	for (unsigned int i = 0; visible != nullptr && i < count; i++) {
+		if (!visible[i]) {
+			slots[i] = lodCounts[lods[i]]++;
+		}
+	}
+	unsigned int first = 0;
+	for (unsigned int lod = 0; lod < Mesh::MAX_LODS; lod++) {
+		lodFirst[lod] = first;
+		first += lodCounts[lod];
+	}
+
+	glm::mat4 *matrices = static_cast<glm::mat4*>(StreamBuffer::get().map(count * sizeof(glm::mat4), sizeof(glm::vec4), offset));
+	if (matrices == nullptr) {
+		return;
+	}
+	JobSystem::parallelFor(count, TARGET_GRAIN, [&](unsigned int i) {
+		matrices[lodFirst[lods[i]] + slots[i]] = transform(i);
+	});
+	StreamBuffer::get().unmap();
+	uploaded = true;
+
+	if (!posed || palettes.size() != count) {
+		return;
+	}
+	GLint *offsets = static_cast<GLint*>(StreamBuffer::get().map(count * sizeof(GLint), sizeof(GLint), paletteOffset));
+	if (offsets == nullptr) {
+		// without the offsets every target would read the first one's pose
+		paletteOffset = -1;
+		return;
+	}
+	for (unsigned int i = 0; i < count; i++) {
+		offsets[lodFirst[lods[i]] + slots[i]] = BonePalette::getTexelOffset(palettes[i]);
+	}
+	StreamBuffer::get().unmap();
+}
+
+/*
+*	Draws this frame's targets with the INSTANCING variant of a shader, INSTANCING | SKINNING if
+*	isSkinned(), one instanced draw per level of detail and mesh. lodBias coarsens every target's LOD
+*	and skipCulled leaves out the culled targets like in renderScene.
+*/
+void TargetBatch::draw(const Shader &shader, bool textured, unsigned int lodBias, bool skipCulled) {
+	if (!uploaded) {
+		return;
+	}
+	GLState::useProgram(shader.ID);
+	for (unsigned int lod = 0; lod < Mesh::MAX_LODS; lod++) {
+		unsigned int instances = skipCulled ? lodVisible[lod] : lodCounts[lod];
+		if (instances == 0) {
+			continue;
+		}
+		GeometryArena::get().bindInstances(
+			StreamBuffer::get().getBuffer(),
+			offset + lodFirst[lod] * sizeof(glm::mat4),
+			isSkinned() ? paletteOffset + lodFirst[lod] * sizeof(GLint) : -1
+		);
+		model->drawInstanced(shader, static_cast<GLsizei>(instances), textured, lod + lodBias, isSkinned());
+	}
+}
+
+/*
+*	Returns true if this frame's targets are posed by their palettes and need skinning shaders.
+*	
+*/
+bool TargetBatch::isSkinned() const {
+	return uploaded && paletteOffset >= 0;
+}
+
+/*
+*	Returns a target's model matrix, the base transform moved to the target's position.
+*	
+*/
+glm::mat4 TargetBatch::transform(unsigned int i) const {
+	glm::mat4 model = base;
+	model[3] += glm::vec4(x[i], y[i], z[i], 0.0f);
+	return model;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Model.hpp"
+#include "TargetMotion.hpp"
+
+/*
+*	Draws all moving targets of one model with instancing. Every frame the interpolated positions 
+*	become instance matrices in the stream buffer, grouped by level of detail, so each LOD of each 
+*	mesh is a single instanced draw no matter how many targets there are. Within a LOD the visible 
+*	targets come first, so the camera passes draw only them and the shadow pass all of them. Skinned 
+*	models animate every target on its own, the instances then carry offsets into the bone palette.
+*/
+class TargetBatch
+{
+public:
+	TargetBatch(Model *model, const glm::mat4 &base);
+	unsigned int animate(const TargetMotion &motion, float deltaTime);
+	void prepare(const TargetMotion &motion, const glm::vec3 &viewPos, float projectionScale, const char *visible = nullptr, bool posed = false);
+	void draw(const Shader &shader, bool textured, unsigned int lodBias = 0, bool skipCulled = false);
+	bool isSkinned(void) const;
+private:
+	Model *model;
+	glm::mat4 base;
+	std::vector<float> x, y, z;
+	std::vector<unsigned int> lods;			// per target, kept between frames for hysteresis
+	std::vector<unsigned int> slots;		// per target, position within its LOD's matrices
+	std::vector<Animator> animators;
+	std::vector<int> palettes;				// per target, this frame's range in the bone palette
+	unsigned int lodCounts[Mesh::MAX_LODS];
+	unsigned int lodVisible[Mesh::MAX_LODS];	// leading targets of each LOD that passed culling
+	unsigned int lodFirst[Mesh::MAX_LODS];
+	GLintptr offset;						// of this frame's matrices in the stream buffer
+	GLintptr paletteOffset;					// of this frame's palette offsets, -1 if drawn rigid
+	bool uploaded;
+	glm::mat4 transform(unsigned int i) const;
+};
+
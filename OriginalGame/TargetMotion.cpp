@@ -0,0 +1,601 @@
+#include "TargetMotion.hpp"
+#include "JobSystem.hpp"
+#include <emmintrin.h>
+
+const float TargetMotion::TICK				= 1.0f / 120.0f;
+static const unsigned int CHUNK_SIZE		= 256;	// targets per job, a multiple of four
+static const float PI						= 3.14159265f;
+
+enum StrafeParam {
+	STRAFE_CENTER_X,
+	STRAFE_CENTER_Z,
+	STRAFE_DIRECTION_X,
+	STRAFE_DIRECTION_Z,
+	STRAFE_OFFSET,
+	STRAFE_SPEED,
+	STRAFE_RANGE,
+	STRAFE_TIMER,
+	STRAFE_INTERVAL
+};
+
+enum SineParam {
+	SINE_CENTER_X,
+	SINE_CENTER_Y,
+	SINE_CENTER_Z,
+	SINE_A_X,
+	SINE_A_Y,
+	SINE_A_Z,
+	SINE_B_X,
+	SINE_B_Y,
+	SINE_B_Z,
+	SINE_PHASE,
+	SINE_FREQUENCY
+};
+
+enum SplineParam {
+	SPLINE_U,
+	SPLINE_SPEED
+};
+
+enum RandomWalkParam {
+	WALK_VELOCITY_X,
+	WALK_VELOCITY_Z,
+	WALK_MAX_SPEED,
+	WALK_MAX_ACCELERATION
+};
+
+/*
+*	Loads four floats of an array.
+*	
+*/
+static inline __m128 load(const std::vector<float> &values, unsigned int i) {
+	return _mm_loadu_ps(&values[i]);
+}
+
+/*
+*	Stores four floats into an array.
+*	
+*/
+static inline void store(std::vector<float> &values, unsigned int i, __m128 value) {
+	_mm_storeu_ps(&values[i], value);
+}
+
+/*
+*	Picks a where mask is set and b elsewhere.
+*	
+*/
+static inline __m128 select(__m128 mask, __m128 a, __m128 b) {
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+/*
+*	Scales the vectors (x, z) longer than limit down to that length.
+*	
+*/
+static inline void clampLength(__m128 &x, __m128 &z, __m128 limit) {
+	__m128 lengthSquared = _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(z, z));
+	__m128 tooLong = _mm_cmpgt_ps(lengthSquared, _mm_mul_ps(limit, limit));
+	// sqrt and div are exact in IEEE, rsqrt would differ between CPU vendors
+	__m128 scale = _mm_div_ps(limit, _mm_sqrt_ps(_mm_max_ps(lengthSquared, _mm_set1_ps(1e-12f))));
+	x = select(tooLong, _mm_mul_ps(x, scale), x);
+	z = select(tooLong, _mm_mul_ps(z, scale), z);
+}
+
+/*
+*	Absolute value.
+*	
+*/
+static inline __m128 absolute(__m128 value) {
+	return _mm_andnot_ps(_mm_castsi128_ps(_mm_set1_epi32(0x80000000)), value);
+}
+
+/*
+*	Flips the sign.
+*	
+*/
+static inline __m128 negate(__m128 value) {
+	return _mm_xor_ps(_mm_castsi128_ps(_mm_set1_epi32(0x80000000)), value);
+}
+
+/*
+*	Advances four xorshift generators and returns uniform numbers in [-1, 1). Only exact integer
+*	and float operations are used, so the sequence is the same on every CPU.
+*/
+static inline __m128 randomSigned(__m128i &state) {
+	state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+	state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+	state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+	// 23 random mantissa bits below an exponent of 0 give a float in [1, 2)
+	__m128 unit = _mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(state, 9), _mm_set1_epi32(0x3F800000)));
+	return _mm_sub_ps(_mm_add_ps(unit, unit), _mm_set1_ps(3.0f));
+}
+
+/*
+*	Sine of x in [-pi, pi] by a refined parabola, accurate to about 0.001. Unlike the sin() of the 
+*	C library it gives the same bits everywhere.
+*/
+static inline __m128 sine(__m128 x) {
+	__m128 y = _mm_add_ps(
+		_mm_mul_ps(_mm_set1_ps(4.0f / PI), x),
+		_mm_mul_ps(_mm_set1_ps(-4.0f / (PI * PI)), _mm_mul_ps(x, absolute(x)))
+	);
+	return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.225f), _mm_sub_ps(_mm_mul_ps(y, absolute(y)), y)), y);
+}
+
+/*
+*	Wraps angles in [-3pi, 3pi) into [-pi, pi).
+*	
+*/
+static inline __m128 wrapAngle(__m128 x) {
+	__m128 turn = _mm_set1_ps(2.0f * PI);
+	x = select(_mm_cmpge_ps(x, _mm_set1_ps(PI)), _mm_sub_ps(x, turn), x);
+	return select(_mm_cmplt_ps(x, _mm_set1_ps(-PI)), _mm_add_ps(x, turn), x);
+}
+
+/*
+*	Scalar sine of x in [-3pi, 3pi) through the same kernel, for spawn parameters.
+*	
+*/
+static inline float sineOf(float x) {
+	return _mm_cvtss_f32(sine(wrapAngle(_mm_set_ss(x))));
+}
+
+/*
+*	Scalar cosine of x in [-3pi, 2.5pi), see sineOf.
+*	
+*/
+static inline float cosineOf(float x) {
+	return sineOf(x + 0.5f * PI);
+}
+
+/*
+*	Catmull-Rom interpolation between p1 and p2.
+*	
+*/
+static inline __m128 catmullRom(__m128 p0, __m128 p1, __m128 p2, __m128 p3, __m128 t) {
+	__m128 t2 = _mm_mul_ps(t, t);
+	__m128 t3 = _mm_mul_ps(t2, t);
+	__m128 a = _mm_add_ps(p1, p1);
+	__m128 b = _mm_sub_ps(p2, p0);
+	__m128 c = _mm_add_ps(
+		_mm_sub_ps(_mm_add_ps(p0, p0), _mm_mul_ps(_mm_set1_ps(5.0f), p1)),
+		_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(4.0f), p2), p3)
+	);
+	__m128 d = _mm_add_ps(
+		_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.0f), p1), p0),
+		_mm_sub_ps(p3, _mm_mul_ps(_mm_set1_ps(3.0f), p2))
+	);
+	__m128 sum = _mm_add_ps(_mm_add_ps(a, _mm_mul_ps(b, t)), _mm_add_ps(_mm_mul_ps(c, t2), _mm_mul_ps(d, t3)));
+	return _mm_mul_ps(_mm_set1_ps(0.5f), sum);
+}
+
+/*
+*	Constructor, targets move on the floor of the given area.
+*	
+*/
+TargetMotion::TargetMotion(unsigned int seed, const glm::vec3 &areaMin, const glm::vec3 &areaMax) 
+	: areaMin(areaMin), areaMax(areaMax), seedState(seed != 0 ? seed : 1), tick(0), accumulator(0.0f) {
+	for (unsigned int i = 0; i < MOTION_PATTERN_COUNT; i++) {
+		groups[i].count = 0;
+		groups[i].first = 0;
+	}
+}
+
+/*
+*	Adds targets moving in the given pattern, their parameters are drawn from the seeded generator.
+*	
+*/
+void TargetMotion::spawn(MotionPattern pattern, unsigned int count) {
+	Group &group = groups[pattern];
+	unsigned int first = group.count;
+	resizeGroup(group, group.count + count);
+	for (unsigned int i = first; i < group.count; i++) {
+		group.random[i] = nextRandom() | 1;
+		switch (pattern) {
+		case MOTION_STRAFE:			initStrafe(group, i);		break;
+		case MOTION_SINE:			initSine(group, i);			break;
+		case MOTION_SPLINE:			initSpline(group, i);		break;
+		case MOTION_RANDOM_WALK:	initRandomWalk(group, i);	break;
+		default:												break;
+		}
+		group.previousX[i] = group.x[i];
+		group.previousY[i] = group.y[i];
+		group.previousZ[i] = group.z[i];
+	}
+	rebuildChunks();
+}
+
+/*
+*	Removes all targets, the generator keeps going so later spawns differ from the first ones.
+*	
+*/
+void TargetMotion::clear() {
+	for (unsigned int i = 0; i < MOTION_PATTERN_COUNT; i++) {
+		resizeGroup(groups[i], 0);
+	}
+	rebuildChunks();
+}
+
+/*
+*	Adds deltaTime and returns how many ticks it covers, at most MAX_TICKS_PER_UPDATE (the rest of a
+*	long stall is dropped). The caller runs them with stepTick() before the next interpolate().
+*/
+unsigned int TargetMotion::advance(float deltaTime) {
+	accumulator += deltaTime;
+	unsigned int ticks = static_cast<unsigned int>(accumulator / TICK);
+	if (ticks > MAX_TICKS_PER_UPDATE) {
+		ticks = MAX_TICKS_PER_UPDATE;
+		accumulator = ticks * TICK;
+	}
+	accumulator -= ticks * TICK;
+	return ticks;
+}
+
+/*
+*	Moves all targets by one tick, every job a chunk of a group.
+*	
+*/
+void TargetMotion::stepTick() {
+	JobSystem::parallelFor(static_cast<unsigned int>(chunks.size()), 1, [this](unsigned int i) {
+		step(chunks[i], 1);
+	});
+	tick++;
+}
+
+/*
+*	Returns the number of targets.
+*	
+*/
+unsigned int TargetMotion::getCount() const {
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < MOTION_PATTERN_COUNT; i++) {
+		count += groups[i].count;
+	}
+	return count;
+}
+
+/*
+*	Returns the number of ticks simulated so far.
+*	
+*/
+unsigned long long TargetMotion::getTick() const {
+	return tick;
+}
+
+/*
+*	Returns how far the time since the last tick is into the next one, from 0 to 1.
+*	
+*/
+float TargetMotion::getAlpha() const {
+	return accumulator / TICK;
+}
+
+/*
+*	Writes every target's position between the last two ticks for rendering. Targets are ordered by 
+*	pattern, then by spawn order. The arrays need room for getCount() targets.
+*/
+void TargetMotion::interpolate(float *x, float *y, float *z) const {
+	__m128 alpha = _mm_set1_ps(getAlpha());
+	float a = getAlpha();
+	JobSystem::parallelFor(static_cast<unsigned int>(chunks.size()), 1, [&](unsigned int c) {
+		const Group &group = groups[chunks[c].group];
+		unsigned int end = chunks[c].end < group.count ? chunks[c].end : group.count;
+		unsigned int i = chunks[c].begin;
+		for (; i + 4 <= end; i += 4) {
+			unsigned int out = group.first + i;
+			__m128 from = load(group.previousX, i);
+			_mm_storeu_ps(x + out, _mm_add_ps(from, _mm_mul_ps(_mm_sub_ps(load(group.x, i), from), alpha)));
+			from = load(group.previousY, i);
+			_mm_storeu_ps(y + out, _mm_add_ps(from, _mm_mul_ps(_mm_sub_ps(load(group.y, i), from), alpha)));
+			from = load(group.previousZ, i);
+			_mm_storeu_ps(z + out, _mm_add_ps(from, _mm_mul_ps(_mm_sub_ps(load(group.z, i), from), alpha)));
+		}
+		// the padding lanes would run into the next group
+		for (; i < end; i++) {
+			unsigned int out = group.first + i;
+			x[out] = group.previousX[i] + (group.x[i] - group.previousX[i]) * a;
+			y[out] = group.previousY[i] + (group.y[i] - group.previousY[i]) * a;
+			z[out] = group.previousZ[i] + (group.z[i] - group.previousZ[i]) * a;
+		}
+	});
+}
+
+/*
+*	Writes every target's position after the last tick, in the order of interpolate().
+*	
+*/
+void TargetMotion::getPositions(float *x, float *y, float *z) const {
+	for (unsigned int g = 0; g < MOTION_PATTERN_COUNT; g++) {
+		const Group &group = groups[g];
+		for (unsigned int i = 0; i < group.count; i++) {
+			x[group.first + i] = group.x[i];
+			y[group.first + i] = group.y[i];
+			z[group.first + i] = group.z[i];
+		}
+	}
+}
+
+/*
+*	Splits the groups into jobs and numbers their targets in the output.
+*	
+*/
+void TargetMotion::rebuildChunks() {
+	chunks.clear();
+	unsigned int first = 0;
+	for (unsigned int g = 0; g < MOTION_PATTERN_COUNT; g++) {
+		groups[g].first = first;
+		first += groups[g].count;
+		unsigned int padded = static_cast<unsigned int>(groups[g].x.size());
+		for (unsigned int begin = 0; begin < padded; begin += CHUNK_SIZE) {
+			Chunk chunk = { g, begin, begin + CHUNK_SIZE < padded ? begin + CHUNK_SIZE : padded };
+			chunks.push_back(chunk);
+		}
+	}
+}
+
+/*
+*	Runs ticks for the targets of a chunk, keeping the positions before the last tick.
+*	
+*/
+void TargetMotion::step(const Chunk &chunk, unsigned int ticks) {
+	Group &group = groups[chunk.group];
+	for (unsigned int t = 0; t < ticks; t++) {
+		if (t + 1 == ticks) {
+			for (unsigned int i = chunk.begin; i < chunk.end; i += 4) {
+				store(group.previousX, i, load(group.x, i));
+				store(group.previousY, i, load(group.y, i));
+				store(group.previousZ, i, load(group.z, i));
+			}
+		}
+		switch (chunk.group) {
+		case MOTION_STRAFE:			stepStrafe(group, chunk.begin, chunk.end);		break;
+		case MOTION_SINE:			stepSine(group, chunk.begin, chunk.end);		break;
+		case MOTION_SPLINE:			stepSpline(group, chunk.begin, chunk.end);		break;
+		case MOTION_RANDOM_WALK:	stepRandomWalk(group, chunk.begin, chunk.end);	break;
+		default:																	break;
+		}
+	}
+}
+
+/*
+*	Scalar xorshift for spawning.
+*	
+*/
+unsigned int TargetMotion::nextRandom() {
+	seedState ^= seedState << 13;
+	seedState ^= seedState >> 17;
+	seedState ^= seedState << 5;
+	return seedState;
+}
+
+/*
+*	Uniform number in [minimum, maximum).
+*	
+*/
+float TargetMotion::randomRange(float minimum, float maximum) {
+	return minimum + (maximum - minimum) * static_cast<float>(nextRandom() >> 8) / static_cast<float>(1 << 24);
+}
+
+/*
+*	Resizes all arrays of a group to count targets rounded up to a multiple of four. Padding lanes
+*	are zero, which every kernel moves without producing NaNs.
+*/
+void TargetMotion::resizeGroup(Group &group, unsigned int count) {
+	unsigned int padded = (count + 3) & ~3u;
+	group.count = count;
+	group.x.resize(padded, 0.0f);
+	group.y.resize(padded, 0.0f);
+	group.z.resize(padded, 0.0f);
+	group.previousX.resize(padded, 0.0f);
+	group.previousY.resize(padded, 0.0f);
+	group.previousZ.resize(padded, 0.0f);
+	for (unsigned int i = 0; i < MAX_PARAMS; i++) {
+		group.params[i].resize(padded, 0.0f);
+	}
+	group.random.resize(padded, 0);
+	if (&group == &groups[MOTION_SPLINE]) {
+		group.points.resize(padded * 3 * SPLINE_POINTS, 0.0f);
+	}
+}
+
+/*
+*	Picks a line and a strafing rhythm.
+*	
+*/
+void TargetMotion::initStrafe(Group &group, unsigned int i) {
+	float range = randomRange(1.5f, 4.0f);
+	float angle = randomRange(-PI, PI);
+	float speed = randomRange(2.5f, 5.0f);
+	float interval = randomRange(0.3f, 1.2f);
+	group.params[STRAFE_CENTER_X][i] = randomRange(areaMin.x + range, areaMax.x - range);
+	group.params[STRAFE_CENTER_Z][i] = randomRange(areaMin.z + range, areaMax.z - range);
+	group.params[STRAFE_DIRECTION_X][i] = cosineOf(angle);
+	group.params[STRAFE_DIRECTION_Z][i] = sineOf(angle);
+	group.params[STRAFE_OFFSET][i] = randomRange(-range, range);
+	group.params[STRAFE_SPEED][i] = nextRandom() & 1 ? speed : -speed;
+	group.params[STRAFE_RANGE][i] = range;
+	group.params[STRAFE_TIMER][i] = randomRange(0.0f, interval);
+	group.params[STRAFE_INTERVAL][i] = interval;
+	group.x[i] = group.params[STRAFE_CENTER_X][i] + group.params[STRAFE_DIRECTION_X][i] * group.params[STRAFE_OFFSET][i];
+	group.y[i] = areaMin.y;
+	group.z[i] = group.params[STRAFE_CENTER_Z][i] + group.params[STRAFE_DIRECTION_Z][i] * group.params[STRAFE_OFFSET][i];
+}
+
+/*
+*	Picks the two axes, amplitudes and the frequency of a sine path.
+*	
+*/
+void TargetMotion::initSine(Group &group, unsigned int i) {
+	float angle = randomRange(-PI, PI);
+	float a = randomRange(1.0f, 3.0f);
+	float b = randomRange(0.5f, 1.5f);
+	float margin = a + b;
+	group.params[SINE_CENTER_X][i] = randomRange(areaMin.x + margin, areaMax.x - margin);
+	group.params[SINE_CENTER_Y][i] = areaMin.y;
+	group.params[SINE_CENTER_Z][i] = randomRange(areaMin.z + margin, areaMax.z - margin);
+	group.params[SINE_A_X][i] = cosineOf(angle) * a;
+	group.params[SINE_A_Y][i] = 0.0f;
+	group.params[SINE_A_Z][i] = sineOf(angle) * a;
+	group.params[SINE_B_X][i] = -sineOf(angle) * b;
+	group.params[SINE_B_Y][i] = 0.0f;
+	group.params[SINE_B_Z][i] = cosineOf(angle) * b;
+	group.params[SINE_PHASE][i] = randomRange(-PI, PI);
+	group.params[SINE_FREQUENCY][i] = randomRange(1.0f, 3.0f);
+	float phase = group.params[SINE_PHASE][i];
+	group.x[i] = group.params[SINE_CENTER_X][i] + group.params[SINE_A_X][i] * sineOf(phase) + group.params[SINE_B_X][i] * sineOf(phase + phase);
+	group.y[i] = group.params[SINE_CENTER_Y][i];
+	group.z[i] = group.params[SINE_CENTER_Z][i] + group.params[SINE_A_Z][i] * sineOf(phase) + group.params[SINE_B_Z][i] * sineOf(phase + phase);
+}
+
+/*
+*	Scatters the control points of a spline loop over the area.
+*	
+*/
+void TargetMotion::initSpline(Group &group, unsigned int i) {
+	// Catmull-Rom overshoots its control points, keep them away from the edges
+	glm::vec3 margin = (areaMax - areaMin) * 0.15f;
+	float *points = &group.points[i * 3 * SPLINE_POINTS];
+	for (unsigned int k = 0; k < SPLINE_POINTS; k++) {
+		points[k] = randomRange(areaMin.x + margin.x, areaMax.x - margin.x);
+		points[SPLINE_POINTS + k] = areaMin.y;
+		points[2 * SPLINE_POINTS + k] = randomRange(areaMin.z + margin.z, areaMax.z - margin.z);
+	}
+	unsigned int start = nextRandom() % SPLINE_POINTS;
+	group.params[SPLINE_U][i] = static_cast<float>(start);
+	group.params[SPLINE_SPEED][i] = randomRange(0.2f, 0.5f);
+	group.x[i] = points[start];
+	group.y[i] = points[SPLINE_POINTS + start];
+	group.z[i] = points[2 * SPLINE_POINTS + start];
+}
+
+/*
+*	Places a random walker at rest with its limits.
+*	
+*/
+void TargetMotion::initRandomWalk(Group &group, unsigned int i) {
+	group.params[WALK_VELOCITY_X][i] = 0.0f;
+	group.params[WALK_VELOCITY_Z][i] = 0.0f;
+	group.params[WALK_MAX_SPEED][i] = randomRange(2.0f, 5.0f);
+	group.params[WALK_MAX_ACCELERATION][i] = randomRange(4.0f, 10.0f);
+	group.x[i] = randomRange(areaMin.x, areaMax.x);
+	group.y[i] = areaMin.y;
+	group.z[i] = randomRange(areaMin.z, areaMax.z);
+}
+
+/*
+*	Strafing tick: move along the line, reverse when leaving the range or when the timer runs out.
+*	
+*/
+void TargetMotion::stepStrafe(Group &group, unsigned int begin, unsigned int end) {
+	__m128 dt = _mm_set1_ps(TICK);
+	__m128 zero = _mm_setzero_ps();
+	for (unsigned int i = begin; i < end; i += 4) {
+		__m128 speed = load(group.params[STRAFE_SPEED], i);
+		__m128 range = load(group.params[STRAFE_RANGE], i);
+		__m128 offset = _mm_add_ps(load(group.params[STRAFE_OFFSET], i), _mm_mul_ps(speed, dt));
+		__m128 timer = _mm_sub_ps(load(group.params[STRAFE_TIMER], i), dt);
+		__m128i state = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&group.random[i]));
+		__m128 random = randomSigned(state);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&group.random[i]), state);
+
+		__m128 outward = _mm_and_ps(_mm_cmpgt_ps(absolute(offset), range), _mm_cmpgt_ps(_mm_mul_ps(offset, speed), zero));
+		__m128 expired = _mm_cmple_ps(timer, zero);
+		speed = select(_mm_or_ps(outward, expired), negate(speed), speed);
+		__m128 interval = load(group.params[STRAFE_INTERVAL], i);
+		timer = select(expired, _mm_mul_ps(interval, _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), random))), timer);
+		offset = _mm_min_ps(_mm_max_ps(offset, negate(range)), range);
+
+		store(group.params[STRAFE_SPEED], i, speed);
+		store(group.params[STRAFE_OFFSET], i, offset);
+		store(group.params[STRAFE_TIMER], i, timer);
+		store(group.x, i, _mm_add_ps(load(group.params[STRAFE_CENTER_X], i), _mm_mul_ps(load(group.params[STRAFE_DIRECTION_X], i), offset)));
+		store(group.z, i, _mm_add_ps(load(group.params[STRAFE_CENTER_Z], i), _mm_mul_ps(load(group.params[STRAFE_DIRECTION_Z], i), offset)));
+	}
+}
+
+/*
+*	Sine tick: advance the phase, place the target at center + a * sin(phase) + b * sin(2 * phase).
+*	
+*/
+void TargetMotion::stepSine(Group &group, unsigned int begin, unsigned int end) {
+	__m128 dt = _mm_set1_ps(TICK);
+	for (unsigned int i = begin; i < end; i += 4) {
+		__m128 phase = wrapAngle(_mm_add_ps(load(group.params[SINE_PHASE], i), _mm_mul_ps(load(group.params[SINE_FREQUENCY], i), dt)));
+		store(group.params[SINE_PHASE], i, phase);
+		__m128 first = sine(phase);
+		__m128 second = sine(wrapAngle(_mm_add_ps(phase, phase)));
+		store(group.x, i, _mm_add_ps(load(group.params[SINE_CENTER_X], i), _mm_add_ps(
+			_mm_mul_ps(load(group.params[SINE_A_X], i), first), _mm_mul_ps(load(group.params[SINE_B_X], i), second))));
+		store(group.y, i, _mm_add_ps(load(group.params[SINE_CENTER_Y], i), _mm_add_ps(
+			_mm_mul_ps(load(group.params[SINE_A_Y], i), first), _mm_mul_ps(load(group.params[SINE_B_Y], i), second))));
+		store(group.z, i, _mm_add_ps(load(group.params[SINE_CENTER_Z], i), _mm_add_ps(
+			_mm_mul_ps(load(group.params[SINE_A_Z], i), first), _mm_mul_ps(load(group.params[SINE_B_Z], i), second))));
+	}
+}
+
+/*
+*	Spline tick: advance along the loop and interpolate the segment's four control points, 
+*	which are gathered per lane since every target is on a different segment.
+*/
+void TargetMotion::stepSpline(Group &group, unsigned int begin, unsigned int end) {
+	__m128 dt = _mm_set1_ps(TICK);
+	__m128 length = _mm_set1_ps(static_cast<float>(SPLINE_POINTS));
+	std::vector<float> *output[3] = { &group.x, &group.y, &group.z };
+	for (unsigned int i = begin; i < end; i += 4) {
+		__m128 u = _mm_add_ps(load(group.params[SPLINE_U], i), _mm_mul_ps(load(group.params[SPLINE_SPEED], i), dt));
+		u = select(_mm_cmpge_ps(u, length), _mm_sub_ps(u, length), u);
+		store(group.params[SPLINE_U], i, u);
+		__m128i segment = _mm_cvttps_epi32(u);
+		__m128 t = _mm_sub_ps(u, _mm_cvtepi32_ps(segment));
+		int segments[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(segments), segment);
+		for (unsigned int axis = 0; axis < 3; axis++) {
+			float p[4][4];
+			for (unsigned int lane = 0; lane < 4; lane++) {
+				const float *points = &group.points[((i + lane) * 3 + axis) * SPLINE_POINTS];
+				for (unsigned int k = 0; k < 4; k++) {
+					p[k][lane] = points[(segments[lane] + SPLINE_POINTS - 1 + k) % SPLINE_POINTS];
+				}
+			}
+			store(*output[axis], i, catmullRom(_mm_loadu_ps(p[0]), _mm_loadu_ps(p[1]), _mm_loadu_ps(p[2]), _mm_loadu_ps(p[3]), t));
+		}
+	}
+}
+
+/*
+*	Random walk tick: random acceleration within the limit, speed clamped, bounced off the area's edges.
+*	Both limits apply to the length of the vector, not per axis, so no direction is favoured.
+*/
+void TargetMotion::stepRandomWalk(Group &group, unsigned int begin, unsigned int end) {
+	__m128 dt = _mm_set1_ps(TICK);
+	__m128 minX = _mm_set1_ps(areaMin.x), maxX = _mm_set1_ps(areaMax.x);
+	__m128 minZ = _mm_set1_ps(areaMin.z), maxZ = _mm_set1_ps(areaMax.z);
+	for (unsigned int i = begin; i < end; i += 4) {
+		__m128 maxSpeed = load(group.params[WALK_MAX_SPEED], i);
+		__m128 maxAcceleration = load(group.params[WALK_MAX_ACCELERATION], i);
+		__m128i state = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&group.random[i]));
+		__m128 accelerationX = _mm_mul_ps(randomSigned(state), maxAcceleration);
+		__m128 accelerationZ = _mm_mul_ps(randomSigned(state), maxAcceleration);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&group.random[i]), state);
+		clampLength(accelerationX, accelerationZ, maxAcceleration);
+
+		__m128 velocityX = _mm_add_ps(load(group.params[WALK_VELOCITY_X], i), _mm_mul_ps(accelerationX, dt));
+		__m128 velocityZ = _mm_add_ps(load(group.params[WALK_VELOCITY_Z], i), _mm_mul_ps(accelerationZ, dt));
+		clampLength(velocityX, velocityZ, maxSpeed);
+
+		__m128 x = _mm_add_ps(load(group.x, i), _mm_mul_ps(velocityX, dt));
+		__m128 z = _mm_add_ps(load(group.z, i), _mm_mul_ps(velocityZ, dt));
+		__m128 low = _mm_cmplt_ps(x, minX), high = _mm_cmpgt_ps(x, maxX);
+		velocityX = select(low, absolute(velocityX), select(high, negate(absolute(velocityX)), velocityX));
+		x = _mm_min_ps(_mm_max_ps(x, minX), maxX);
+		low = _mm_cmplt_ps(z, minZ);
+		high = _mm_cmpgt_ps(z, maxZ);
+		velocityZ = select(low, absolute(velocityZ), select(high, negate(absolute(velocityZ)), velocityZ));
+		z = _mm_min_ps(_mm_max_ps(z, minZ), maxZ);
+
+		store(group.params[WALK_VELOCITY_X], i, velocityX);
+		store(group.params[WALK_VELOCITY_Z], i, velocityZ);
+		store(group.x, i, x);
+		store(group.z, i, z);
+	}
+}
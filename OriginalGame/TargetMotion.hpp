@@ -0,0 +1,75 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+/*
+*	Movement patterns of the targets, each simulated by its own SIMD kernel.
+*	
+*/
+enum MotionPattern {
+	MOTION_STRAFE,			// back and forth along a line, reversing at limits and random intervals like a strafing player
+	MOTION_SINE,			// sum of a sine and its first harmonic along two axes, e.g. figure eights
+	MOTION_SPLINE,			// closed Catmull-Rom loop through random control points
+	MOTION_RANDOM_WALK,		// random acceleration with acceleration and speed limits, bounced off the area's edges
+	MOTION_PATTERN_COUNT
+};
+
+/*
+*	Moves all targets with fixed ticks, so the result only depends on the seed and the spawn calls, 
+*	never on the frame rate. The caller runs the ticks advance() asks for, so other fixed tick systems
+*	can step in lockstep with the targets. Targets are grouped by pattern and stored as structure of 
+*	arrays, every kernel moves four targets at once with SSE and the groups are split into jobs.
+*/
+class TargetMotion
+{
+public:
+	static const float TICK;
+	static const unsigned int MAX_TICKS_PER_UPDATE	= 8;
+	static const unsigned int SPLINE_POINTS			= 8;
+	static const unsigned int MAX_PARAMS			= 12;
+	TargetMotion(unsigned int seed, const glm::vec3 &areaMin, const glm::vec3 &areaMax);
+	void spawn(MotionPattern pattern, unsigned int count);
+	void clear(void);
+	unsigned int advance(float deltaTime);
+	void stepTick(void);
+	unsigned int getCount(void) const;
+	unsigned long long getTick(void) const;
+	float getAlpha(void) const;
+	void interpolate(float *x, float *y, float *z) const;
+	void getPositions(float *x, float *y, float *z) const;
+private:
+	struct Group {
+		unsigned int count;						// targets, the arrays are padded to a multiple of four
+		unsigned int first;						// index of the group's first target in the output
+		std::vector<float> x, y, z;				// position after the last tick
+		std::vector<float> previousX, previousY, previousZ;
+		std::vector<float> params[MAX_PARAMS];	// meaning depends on the pattern
+		std::vector<float> points;				// spline control points, [target][axis][point]
+		std::vector<unsigned int> random;		// xorshift state per target
+	};
+	struct Chunk {
+		unsigned int group;
+		unsigned int begin;
+		unsigned int end;
+	};
+	Group groups[MOTION_PATTERN_COUNT];
+	std::vector<Chunk> chunks;
+	glm::vec3 areaMin, areaMax;
+	unsigned int seedState;
+	unsigned long long tick;
+	float accumulator;
+	void rebuildChunks(void);
+	void step(const Chunk &chunk, unsigned int ticks);
+	unsigned int nextRandom(void);
+	float randomRange(float minimum, float maximum);
+	void resizeGroup(Group &group, unsigned int count);
+	void initStrafe(Group &group, unsigned int i);
+	void initSine(Group &group, unsigned int i);
+	void initSpline(Group &group, unsigned int i);
+	void initRandomWalk(Group &group, unsigned int i);
+	void stepStrafe(Group &group, unsigned int begin, unsigned int end);
+	void stepSine(Group &group, unsigned int begin, unsigned int end);
+	void stepSpline(Group &group, unsigned int begin, unsigned int end);
+	void stepRandomWalk(Group &group, unsigned int begin, unsigned int end);
+};
+
@@ -0,0 +1,295 @@
+#include "TriangleBVH.hpp"
+#include <algorithm>
+#include <cmath>
+
+/*
+*	Constructor, the hierarchy is empty until build().
+*	
+*/
+TriangleBVH::TriangleBVH() {
+}
+
+/*
+*	Builds the hierarchy over the given triangles, three corners each, and takes them over. The
+*	triangles are reordered so every leaf's triangles are consecutive.
+*/
+void TriangleBVH::build(std::vector<glm::vec3> &&corners) {
+	this->corners = std::move(corners);
+	nodes.clear();
+	unsigned int count = getTriangleCount();
+	if (count == 0) {
+		return;
+	}
+	std::vector<glm::vec3> centers(count);
+	std::vector<unsigned int> order(count);
+	for (unsigned int i = 0; i < count; i++) {
+		centers[i] = (this->corners[i * 3] + this->corners[i * 3 + 1] + this->corners[i * 3 + 2]) / 3.0f;
+		order[i] = i;
+	}
+	nodes.reserve(2 * (count / LEAF_SIZE + 1));
+	buildNode(order, centers, 0, count, 0);
+	std::vector<glm::vec3> sorted(this->corners.size());
+	for (unsigned int i = 0; i < count; i++) {
+		for (unsigned int k = 0; k < 3; k++) {
+			sorted[i * 3 + k] = this->corners[order[i] * 3 + k];
+		}
+	}
+	this->corners.swap(sorted);
+}
+
+/*
+*	Returns true if there are no triangles to hit.
+*	
+*/
+bool TriangleBVH::isEmpty() const {
+	return nodes.empty();
+}
+
+/*
+*	Returns the number of triangles.
+*	
+*/
+unsigned int TriangleBVH::getTriangleCount() const {
+	return static_cast<unsigned int>(corners.size() / 3);
+}
+
+/*
+*	Returns the three corners of a triangle.
+*	
+*/
+const glm::vec3 *TriangleBVH::getTriangle(unsigned int i) const {
+	return &corners[i * 3];
+}
+
+/*
+*	Appends the triangles whose bounds overlap the box. They are close to it, not necessarily 
+*	intersecting it.
+*/
+void TriangleBVH::queryBox(const glm::vec3 &minimum, const glm::vec3 &maximum, std::vector<unsigned int> &result) const {
+	if (nodes.empty()) {
+		return;
+	}
+	unsigned int stack[MAX_DEPTH];
+	unsigned int depth = 0;
+	unsigned int current = 0;
+	while (true) {
+		const Node &node = nodes[current];
+		bool overlaps = node.minimum.x <= maximum.x && node.maximum.x >= minimum.x
+			&& node.minimum.y <= maximum.y && node.maximum.y >= minimum.y
+			&& node.minimum.z <= maximum.z && node.maximum.z >= minimum.z;
+		if (overlaps) {
+			if (node.count == 0) {
+				stack[depth++] = node.first;
+				current++;
+				continue;
+			}
+			for (unsigned int i = node.first; i < node.first + node.count; i++) {
+				glm::vec3 low = glm::min(corners[i * 3], glm::min(corners[i * 3 + 1], corners[i * 3 + 2]));
+				glm::vec3 high = glm::max(corners[i * 3], glm::max(corners[i * 3 + 1], corners[i * 3 + 2]));
+				if (low.x <= maximum.x && high.x >= minimum.x && low.y <= maximum.y && high.y >= minimum.y && low.z <= maximum.z && high.z >= minimum.z) {
+					result.push_back(i);
+				}
+			}
+		}
+		if (depth == 0) {
+			break;
+		}
+		current = stack[--depth];
+	}
+}
+
+/*
+*	Sweeps a sphere from from along segment. If it touches a triangle before fraction (of the
+*	segment) it returns true and sets fraction and the normal at the contact, which is at the
+*	sphere's center then minus normal * radius. Triangles are two-sided.
+*/
+bool TriangleBVH::sweep(const glm::vec3 &from, const glm::vec3 &segment, float radius, float &fraction, glm::vec3 &normal) const {
+	if (nodes.empty()) {
+		return false;
+	}
+	glm::vec3 inverse(
+		segment.x != 0.0f ? 1.0f / segment.x : 1e30f,
+		segment.y != 0.0f ? 1.0f / segment.y : 1e30f,
+		segment.z != 0.0f ? 1.0f / segment.z : 1e30f
+	);
+	glm::vec3 grow(radius);
+	bool hit = false;
+	unsigned int stack[MAX_DEPTH];
+	unsigned int depth = 0;
+	unsigned int current = 0;
+	while (true) {
+		const Node &node = nodes[current];
+		if (overlapsBox(node.minimum - grow, node.maximum + grow, from, inverse, fraction)) {
+			if (node.count == 0) {
+				stack[depth++] = node.first;
+				current++;
+				continue;
+			}
+			for (unsigned int i = node.first; i < node.first + node.count; i++) {
+				hit |= sweepTriangle(&corners[i * 3], from, segment, radius, fraction, normal);
+			}
+		}
+		if (depth == 0) {
+			break;
+		}
+		current = stack[--depth];
+	}
+	return hit;
+}
+
+/*
+*	Appends the node for the triangles order[begin, end) and its subtree, returns its index. Inner
+*	nodes split their triangles at the median center along the longest axis of the centers' bounds.
+*/
+unsigned int TriangleBVH::buildNode(std::vector<unsigned int> &order, const std::vector<glm::vec3> &centers, unsigned int begin, unsigned int end, unsigned int depth) {
+	unsigned int index = static_cast<unsigned int>(nodes.size());
+	nodes.push_back(Node());
+	glm::vec3 minimum = corners[order[begin] * 3], maximum = minimum;
+	glm::vec3 centerMin = centers[order[begin]], centerMax = centerMin;
+	for (unsigned int i = begin; i < end; i++) {
+		for (unsigned int k = 0; k < 3; k++) {
+			minimum = glm::min(minimum, corners[order[i] * 3 + k]);
+			maximum = glm::max(maximum, corners[order[i] * 3 + k]);
+		}
+		centerMin = glm::min(centerMin, centers[order[i]]);
+		centerMax = glm::max(centerMax, centers[order[i]]);
+	}
+	nodes[index].minimum = minimum;
+	nodes[index].maximum = maximum;
+	if (end - begin <= LEAF_SIZE || depth + 1 >= MAX_DEPTH) {
+		nodes[index].first = begin;
+		nodes[index].count = end - begin;
+		return index;
+	}
+	glm::vec3 extent = centerMax - centerMin;
+	int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+	unsigned int middle = begin + (end - begin) / 2;
+	std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&](unsigned int a, unsigned int b) {
+		return centers[a][axis] < centers[b][axis];
+	});
+	buildNode(order, centers, begin, middle, depth + 1);
+	unsigned int right = buildNode(order, centers, middle, end, depth + 1);
+	nodes[index].first = right;
+	nodes[index].count = 0;
+	return index;
+}
+
+/*
+*	Sweeps a sphere against one triangle: its face first, which is the earliest contact wherever
+*	it lands inside, otherwise its edges and corners. Only moves towards the triangle count.
+*/
+bool TriangleBVH::sweepTriangle(const glm::vec3 *triangle, const glm::vec3 &from, const glm::vec3 &segment, float radius, float &fraction, glm::vec3 &normal) {
+	glm::vec3 face = glm::cross(triangle[1] - triangle[0], triangle[2] - triangle[0]);
+	float area = glm::length(face);
+	if (area == 0.0f) {
+		return false;
+	}
+	glm::vec3 plane = face / area;
+	float distance = glm::dot(from - triangle[0], plane);
+	if (distance < 0.0f) {
+		plane = -plane;
+		distance = -distance;
+	}
+	float approach = -glm::dot(segment, plane);
+	if (approach > 0.0f && distance >= radius) {
+		float t = (distance - radius) / approach;
+		if (t <= fraction) {
+			glm::vec3 contact = from + segment * t - plane * radius;
+			bool inside = true;
+			for (int k = 0; k < 3 && inside; k++) {
+				const glm::vec3 &a = triangle[k];
+				const glm::vec3 &b = triangle[(k + 1) % 3];
+				inside = glm::dot(glm::cross(b - a, contact - a), face) >= 0.0f;
+			}
+			if (inside) {
+				fraction = t;
+				normal = plane;
+				return true;
+			}
+		}
+	}
+	if (radius == 0.0f) {
+		return false;
+	}
+	bool hit = false;
+	for (int k = 0; k < 3; k++) {
+		hit |= sweepEdge(triangle[k], triangle[(k + 1) % 3], from, segment, radius, fraction, normal);
+		hit |= sweepPoint(triangle[k], from, segment, radius, fraction, normal);
+	}
+	return hit;
+}
+
+/*
+*	Sweeps a sphere against a point, i.e. a ray against a sphere around the point.
+*	
+*/
+bool TriangleBVH::sweepPoint(const glm::vec3 &point, const glm::vec3 &from, const glm::vec3 &segment, float radius, float &fraction, glm::vec3 &normal) {
+	glm::vec3 offset = from - point;
+	float a = glm::dot(segment, segment);
+	float b = glm::dot(offset, segment);
+	float c = glm::dot(offset, offset) - radius * radius;
+	// starting in contact or moving away, a previous sweep would have caught the former
+	if (a == 0.0f || c <= 0.0f || b >= 0.0f) {
+		return false;
+	}
+	float discriminant = b * b - a * c;
+	if (discriminant < 0.0f) {
+		return false;
+	}
+	float t = (-b - std::sqrt(discriminant)) / a;
+	if (t > fraction) {
+		return false;
+	}
+	fraction = t;
+	normal = glm::normalize(from + segment * t - point);
+	return true;
+}
+
+/*
+*	Sweeps a sphere against the inside of an edge, i.e. a ray against the side of a cylinder
+*	around it. Contacts past the edge's ends are left to sweepPoint.
+*/
+bool TriangleBVH::sweepEdge(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &from, const glm::vec3 &segment, float radius, float &fraction, glm::vec3 &normal) {
+	glm::vec3 edge = b - a;
+	glm::vec3 offset = from - a;
+	float ee = glm::dot(edge, edge);
+	float es = glm::dot(edge, segment);
+	float eo = glm::dot(edge, offset);
+	float qa = ee * glm::dot(segment, segment) - es * es;
+	float qb = ee * glm::dot(offset, segment) - es * eo;
+	float qc = ee * (glm::dot(offset, offset) - radius * radius) - eo * eo;
+	// parallel to the edge, or starting in contact with its cylinder
+	if (qa <= 0.0f || qc <= 0.0f || qb >= 0.0f) {
+		return false;
+	}
+	float discriminant = qb * qb - qa * qc;
+	if (discriminant < 0.0f) {
+		return false;
+	}
+	float t = (-qb - std::sqrt(discriminant)) / qa;
+	if (t > fraction) {
+		return false;
+	}
+	float s = (eo + es * t) / ee;
+	if (s < 0.0f || s > 1.0f) {
+		return false;
+	}
+	fraction = t;
+	normal = glm::normalize(from + segment * t - (a + edge * s));
+	return true;
+}
+
+/*
+*	Slab test of the segment from from (1 / segment per axis in inverse) up to fraction against a box.
+*	
+*/
+bool TriangleBVH::overlapsBox(const glm::vec3 &minimum, const glm::vec3 &maximum, const glm::vec3 &from, const glm::vec3 &inverse, float fraction) {
+	float enter = 0.0f, exit = fraction;
+	for (int a = 0; a < 3; a++) {
+		float t0 = (minimum[a] - from[a]) * inverse[a];
+		float t1 = (maximum[a] - from[a]) * inverse[a];
+		enter = std::max(enter, std::min(t0, t1));
+		exit = std::min(exit, std::max(t0, t1));
+	}
+	return enter <= exit;
+}
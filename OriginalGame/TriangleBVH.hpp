@@ -0,0 +1,39 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+/*
+*	Bounding volume hierarchy over a static triangle soup for exact hit tests against a model. Nodes
+*	are axis-aligned boxes split at the median of the longest axis, stored depth first so a node's
+*	left child directly follows it. Spheres are swept against the triangles' faces, edges and corners,
+*	a ray is a sphere of radius 0. Boxes collect the triangles near them, e.g. for decals. Built once 
+*	per model and shared by all its instances.
+*/
+class TriangleBVH
+{
+public:
+	static const unsigned int LEAF_SIZE		= 4;	// triangles
+	static const unsigned int MAX_DEPTH		= 64;
+	TriangleBVH();
+	void build(std::vector<glm::vec3> &&corners);
+	bool isEmpty(void) const;
+	unsigned int getTriangleCount(void) const;
+	const glm::vec3 *getTriangle(unsigned int i) const;
+	void queryBox(const glm::vec3 &minimum, const glm::vec3 &maximum, std::vector<unsigned int> &result) const;
+	bool sweep(const glm::vec3 &from, const glm::vec3 &segment, float radius, float &fraction, glm::vec3 &normal) const;
+private:
+	struct Node {
+		glm::vec3 minimum;
+		glm::vec3 maximum;
+		unsigned int first;		// leaves: first triangle, inner nodes: right child
+		unsigned int count;		// triangles, 0 for inner nodes
+	};
+	std::vector<Node> nodes;
+	std::vector<glm::vec3> corners;		// three per triangle
+	unsigned int buildNode(std::vector<unsigned int> &order, const std::vector<glm::vec3> &centers, unsigned int begin, unsigned int end, unsigned int depth);
+	static bool sweepTriangle(const glm::vec3 *triangle, const glm::vec3 &from, const glm::vec3 &segment, float radius, float &fraction, glm::vec3 &normal);
+	static bool sweepPoint(const glm::vec3 &point, const glm::vec3 &from, const glm::vec3 &segment, float radius, float &fraction, glm::vec3 &normal);
+	static bool sweepEdge(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &from, const glm::vec3 &segment, float radius, float &fraction, glm::vec3 &normal);
+	static bool overlapsBox(const glm::vec3 &minimum, const glm::vec3 &maximum, const glm::vec3 &from, const glm::vec3 &inverse, float fraction);
+};
+
@@ -0,0 +1,30 @@
+#version 330 core
+layout (location = 0) in vec4 aPositionSize;
+layout (location = 1) in vec4 aNormalTile;
+layout (location = 2) in vec4 aTangentCount;
+layout (location = 3) in vec4 aOffset;
+
+out vec2 TexCoords;
+
+uniform mat4 viewProjection;
+uniform samplerBuffer vertices;
+uniform int maxVertices;
+uniform float tilesPerRow;
+
+void main() {
+    if (gl_VertexID >= int(aTangentCount.w)) {
+        // past the decal's clipped triangles, all of them collapse into one point
+        TexCoords = vec2(0.0);
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+        return;
+    }
+    // the vertex in the decal's own space: along the tangent, the bitangent and the normal
+    vec3 local = texelFetch(vertices, gl_InstanceID * maxVertices + gl_VertexID).xyz;
+    vec3 normal = aNormalTile.xyz;
+    vec3 tangent = aTangentCount.xyz;
+    vec3 bitangent = cross(normal, tangent);
+    vec3 position = aOffset.xyz + aPositionSize.xyz + tangent * local.x + bitangent * local.y + normal * local.z;
+    vec2 tile = vec2(mod(aNormalTile.w, tilesPerRow), floor(aNormalTile.w / tilesPerRow));
+    TexCoords = (tile + local.xy / aPositionSize.w * 0.5 + 0.5) / tilesPerRow;
+    gl_Position = viewProjection * vec4(position, 1.0);
+}
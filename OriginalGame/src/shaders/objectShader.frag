@@ -1,34 +1,55 @@
 #version 330 core
 out vec4 FragColor;
 
+#if defined(SHADOWS_HARD) || defined(SHADOWS_PCF)
+#define SHADOWS
+#endif
+
 in VS_OUT {
     vec3 FragPos;
     vec3 Normal;
     vec2 TexCoords;
+#ifdef NORMAL_MAP
+    vec3 Tangent;
+#endif
+#ifdef SHADOWS
     vec4 FragPosLightSpace;
+#endif
 } fs_in;
 
+#ifdef DIFFUSE_MAP
 uniform sampler2D diffuseTexture;
+#else
+uniform vec3 diffuseColor;
+#endif
+#ifdef NORMAL_MAP
+uniform sampler2D normalMap;
+#endif
+#ifdef SHADOWS
 uniform sampler2D shadowMap;
+#endif
+#ifdef ALPHA_TEST
+uniform float alphaCutoff;
+#endif
 
 uniform vec3 lightPos;
 uniform vec3 viewPos;
 
-float ShadowCalculation(vec4 fragPosLightSpace) {
+#ifdef SHADOWS
+float ShadowCalculation(vec4 fragPosLightSpace, vec3 normal) {
     // perform perspective divide
     vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
     // transform to [0,1] range
     projCoords = projCoords * 0.5 + 0.5;
-    // get closest depth value from light's perspective (using [0,1] range fragPosLight as coords)
-    float closestDepth = texture(shadowMap, projCoords.xy).r; 
+    // keep the shadow at 0.0 when outside the far_plane region of the light's frustum.
+    if(projCoords.z > 1.0)
+        return 0.0;
     // get depth of current fragment from light's perspective
     float currentDepth = projCoords.z;
     // calculate bias (based on depth map resolution and slope)
-    vec3 normal = normalize(fs_in.Normal);
     vec3 lightDir = normalize(lightPos - fs_in.FragPos);
     float bias = max(0.05 * (1.0 - dot(normal, lightDir)), 0.005);
-    // check whether current frag pos is in shadow
-    // float shadow = currentDepth - bias > closestDepth  ? 1.0 : 0.0;
+#ifdef SHADOWS_PCF
     // PCF
     float shadow = 0.0;
     vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
@@ -40,18 +61,35 @@ float ShadowCalculation(vec4 fragPosLightSpace) {
             shadow += currentDepth - bias > pcfDepth  ? 1.0 : 0.0;        
         }    
     }
-    shadow /= 9.0;
-    
-    // keep the shadow at 0.0 when outside the far_plane region of the light's frustum.
-    if(projCoords.z > 1.0)
-        shadow = 0.0;
-        
-    return shadow;
+    return shadow / 9.0;
+#else
+    // get closest depth value from light's perspective (using [0,1] range fragPosLight as coords)
+    float closestDepth = texture(shadowMap, projCoords.xy).r; 
+    return currentDepth - bias > closestDepth  ? 1.0 : 0.0;
+#endif
 }
+#endif
 
 void main() {           
-    vec3 color = texture(diffuseTexture, fs_in.TexCoords).rgb;
+#ifdef DIFFUSE_MAP
+    vec4 albedo = texture(diffuseTexture, fs_in.TexCoords);
+#else
+    vec4 albedo = vec4(diffuseColor, 1.0);
+#endif
+#ifdef ALPHA_TEST
+    if(albedo.a < alphaCutoff)
+        discard;
+#endif
+    vec3 color = albedo.rgb;
     vec3 normal = normalize(fs_in.Normal);
+#ifdef NORMAL_MAP
+    // meshes without tangents (planes, cubes) keep their geometric normal
+    if(dot(fs_in.Tangent, fs_in.Tangent) > 1e-8) {
+        vec3 T = normalize(fs_in.Tangent - dot(fs_in.Tangent, normal) * normal);
+        mat3 TBN = mat3(T, cross(normal, T), normal);
+        normal = normalize(TBN * (texture(normalMap, fs_in.TexCoords).rgb * 2.0 - 1.0));
+    }
+#endif
     vec3 lightColor = vec3(0.3);
 
     // ambient
@@ -64,14 +102,17 @@ void main() {
 
     // specular
     vec3 viewDir = normalize(viewPos - fs_in.FragPos);
-    vec3 reflectDir = reflect(-lightDir, normal);
     float spec = 0.0;
     vec3 halfwayDir = normalize(lightDir + viewDir);  
     spec = pow(max(dot(normal, halfwayDir), 0.0), 64.0);
     vec3 specular = spec * lightColor;    
 
     // calculate shadow
-    float shadow = ShadowCalculation(fs_in.FragPosLightSpace);                      
+#ifdef SHADOWS
+    float shadow = ShadowCalculation(fs_in.FragPosLightSpace, normal);                      
+#else
+    float shadow = 0.0;
+#endif
     vec3 lighting = (ambient + (1.0 - shadow) * (diffuse + specular)) * color;    
     
     FragColor = vec4(lighting, 1.0);
@@ -2,25 +2,85 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+#ifdef NORMAL_MAP
+layout (location = 3) in vec3 aTangent;
+#endif
+#ifdef INSTANCING
+layout (location = 5) in mat4 aInstanceModel;
+#endif
+#ifdef SKINNING
+layout (location = 9) in uvec4 aBoneIDs;
+layout (location = 10) in vec4 aBoneWeights;
+#endif
 
-out vec2 TexCoords;
+#if defined(SHADOWS_HARD) || defined(SHADOWS_PCF)
+#define SHADOWS
+#endif
 
 out VS_OUT {
     vec3 FragPos;
     vec3 Normal;
     vec2 TexCoords;
+#ifdef NORMAL_MAP
+    vec3 Tangent;
+#endif
+#ifdef SHADOWS
     vec4 FragPosLightSpace;
+#endif
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
+uniform mat4 viewProjection;
 uniform mat4 model;
+#ifdef SHADOWS
 uniform mat4 lightSpaceMatrix;
+#endif
+#ifdef SKINNING
+uniform samplerBuffer bonePalette;
+#ifdef INSTANCING
+// every instance has its own pose
+layout (location = 11) in int aPaletteOffset;
+#define paletteOffset aPaletteOffset
+#else
+uniform int paletteOffset;
+#endif
+
+mat4 boneMatrix(uint bone) {
+    int texel = paletteOffset + int(bone) * 4;
+    return mat4(
+        texelFetch(bonePalette, texel),
+        texelFetch(bonePalette, texel + 1),
+        texelFetch(bonePalette, texel + 2),
+        texelFetch(bonePalette, texel + 3)
+    );
+}
+#endif
+
+// must match simpleDepthShader.vert exactly, the depth pre-pass relies on GL_EQUAL
+invariant gl_Position;
 
 void main() {
-    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
-    vs_out.Normal = transpose(inverse(mat3(model))) * aNormal;
+#ifdef INSTANCING
+    mat4 modelMatrix = aInstanceModel * model;
+#else
+    mat4 modelMatrix = model;
+#endif
+#ifdef SKINNING
+    modelMatrix = modelMatrix * (
+        boneMatrix(aBoneIDs.x) * aBoneWeights.x +
+        boneMatrix(aBoneIDs.y) * aBoneWeights.y +
+        boneMatrix(aBoneIDs.z) * aBoneWeights.z +
+        boneMatrix(aBoneIDs.w) * aBoneWeights.w
+    );
+#endif
+    mat3 normalMatrix = transpose(inverse(mat3(modelMatrix)));
+    vs_out.FragPos = vec3(modelMatrix * vec4(aPos, 1.0));
+    vs_out.Normal = normalMatrix * aNormal;
     vs_out.TexCoords = aTexCoords;
+#ifdef NORMAL_MAP
+    vs_out.Tangent = mat3(modelMatrix) * aTangent;
+#endif
+#ifdef SHADOWS
     vs_out.FragPosLightSpace = lightSpaceMatrix * vec4(vs_out.FragPos, 1.0);
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+#endif
+    gl_Position = viewProjection * (modelMatrix * vec4(aPos, 1.0));
 }
\ No newline at end of file
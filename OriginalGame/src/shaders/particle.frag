@@ -0,0 +1,12 @@
+#version 330 core
+in vec2 Corner;
+in float Fade;
+
+out vec4 FragColor;
+
+uniform vec4 color;
+
+void main() {
+    float falloff = 1.0 - smoothstep(0.5, 1.0, length(Corner));
+    FragColor = vec4(color.rgb, color.a * falloff * (1.0 - Fade));
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner;
+layout (location = 1) in vec4 aPositionSize;
+layout (location = 2) in float aFade;
+
+out vec2 Corner;
+out float Fade;
+
+uniform mat4 viewProjection;
+uniform vec3 cameraRight;
+uniform vec3 cameraUp;
+
+void main() {
+    // particles shrink to half their size over their lifetime
+    float size = aPositionSize.w * (1.0 - 0.5 * aFade);
+    vec3 position = aPositionSize.xyz + (cameraRight * aCorner.x + cameraUp * aCorner.y) * size;
+    Corner = aCorner;
+    Fade = aFade;
+    gl_Position = viewProjection * vec4(position, 1.0);
+}
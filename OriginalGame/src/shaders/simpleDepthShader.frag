@@ -1,5 +1,16 @@
 #version 330 core
 
-void main() {
+#ifdef ALPHA_TEST
+in vec2 TexCoords;
+
+uniform sampler2D diffuseTexture;
+uniform float alphaCutoff;
+#endif
 
+void main() {
+#ifdef ALPHA_TEST
+    // cut-out geometry must leave the same holes in the depth as in the main pass
+    if(texture(diffuseTexture, TexCoords).a < alphaCutoff)
+        discard;
+#endif
 }
\ No newline at end of file
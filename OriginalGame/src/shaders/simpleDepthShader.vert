@@ -1,9 +1,62 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+#ifdef ALPHA_TEST
+layout (location = 2) in vec2 aTexCoords;
+#endif
+#ifdef INSTANCING
+layout (location = 5) in mat4 aInstanceModel;
+#endif
+#ifdef SKINNING
+layout (location = 9) in uvec4 aBoneIDs;
+layout (location = 10) in vec4 aBoneWeights;
+#endif
+
+#ifdef ALPHA_TEST
+out vec2 TexCoords;
+#endif
 
 uniform mat4 lightSpaceMatrix;
 uniform mat4 model;
+#ifdef SKINNING
+uniform samplerBuffer bonePalette;
+#ifdef INSTANCING
+// every instance has its own pose
+layout (location = 11) in int aPaletteOffset;
+#define paletteOffset aPaletteOffset
+#else
+uniform int paletteOffset;
+#endif
+
+mat4 boneMatrix(uint bone) {
+    int texel = paletteOffset + int(bone) * 4;
+    return mat4(
+        texelFetch(bonePalette, texel),
+        texelFetch(bonePalette, texel + 1),
+        texelFetch(bonePalette, texel + 2),
+        texelFetch(bonePalette, texel + 3)
+    );
+}
+#endif
+
+// must match objectShader.vert exactly, the depth pre-pass relies on GL_EQUAL
+invariant gl_Position;
 
 void main() {
-    gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0);
+#ifdef INSTANCING
+    mat4 modelMatrix = aInstanceModel * model;
+#else
+    mat4 modelMatrix = model;
+#endif
+#ifdef SKINNING
+    modelMatrix = modelMatrix * (
+        boneMatrix(aBoneIDs.x) * aBoneWeights.x +
+        boneMatrix(aBoneIDs.y) * aBoneWeights.y +
+        boneMatrix(aBoneIDs.z) * aBoneWeights.z +
+        boneMatrix(aBoneIDs.w) * aBoneWeights.w
+    );
+#endif
+#ifdef ALPHA_TEST
+    TexCoords = aTexCoords;
+#endif
+    gl_Position = lightSpaceMatrix * (modelMatrix * vec4(aPos, 1.0));
 }
\ No newline at end of file